@@ -0,0 +1,36 @@
+#version 450
+//lit.vert for meshes loaded with a packed ew::VertexFormat
+layout(location = 0) in vec3 vPos; //0-1 if positions are quantized
+layout(location = 1) in vec2 vNormal; //Octahedral
+layout(location = 2) in vec2 vTexCoord;
+layout(location = 3) in vec2 vTangent; //Octahedral
+
+uniform mat4 _Model; 
+uniform mat4 _ViewProjection;
+//ew::PositionQuantization of the mesh. Offset 0 and scale 1 for float positions.
+uniform vec3 _PositionOffset;
+uniform vec3 _PositionScale;
+
+out Surface{
+	vec3 WorldPos; //Vertex position in world space
+	vec2 TexCoord;
+	mat3 TBN;
+}vs_out;
+
+//Inverse of ew::octEncode
+vec3 octDecode(vec2 e){
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0.0)));
+	return normalize(n);
+}
+
+void main(){
+	vec3 pos = _PositionOffset + _PositionScale * vPos;
+	vec3 normal = octDecode(vNormal);
+	vec3 tangent = octDecode(vTangent);
+	vs_out.WorldPos = vec3(_Model * vec4(pos,1.0));
+	vs_out.TexCoord = vTexCoord;
+	vs_out.TBN = transpose(inverse(mat3(_Model))) * mat3(tangent,cross(normal,tangent),normal);
+	gl_Position = _ViewProjection * _Model * vec4(pos,1.0);
+}
@@ -0,0 +1,40 @@
+#version 450
+//Linear blend skinning. Same attributes and outputs as lit.vert.
+layout(location = 0) in vec3 vPos;
+layout(location = 1) in vec3 vNormal;
+layout(location = 2) in vec2 vTexCoord;
+layout(location = 3) in vec3 vTangent;
+layout(location = 4) in uvec4 vBoneIDs;
+layout(location = 5) in vec4 vBoneWeights;
+
+//_NumBones matrices per instance, written by ew::SkinningPaletteBuffer
+layout(std430, binding = 0) readonly buffer SkinningPalette{
+	mat4 _Palette[];
+};
+uniform int _NumBones;
+
+uniform mat4 _Model; 
+uniform mat4 _ViewProjection;
+
+out Surface{
+	vec3 WorldPos; //Vertex position in world space
+	vec2 TexCoord;
+	mat3 TBN;
+}vs_out;
+
+void main(){
+	int paletteStart = gl_InstanceID * _NumBones;
+	mat4 skinMatrix = mat4(0.0);
+	for (int i = 0; i < 4; i++){
+		skinMatrix += _Palette[paletteStart + int(vBoneIDs[i])] * vBoneWeights[i];
+	}
+	//Unweighted vertices stay in bind pose
+	if (vBoneWeights.x + vBoneWeights.y + vBoneWeights.z + vBoneWeights.w <= 0.0){
+		skinMatrix = mat4(1.0);
+	}
+	mat4 model = _Model * skinMatrix;
+	vs_out.WorldPos = vec3(model * vec4(vPos,1.0));
+	vs_out.TexCoord = vTexCoord;
+	vs_out.TBN = transpose(inverse(mat3(model))) * mat3(vTangent,cross(vNormal,vTangent),vNormal);
+	gl_Position = _ViewProjection * vec4(vs_out.WorldPos,1.0);
+}
@@ -0,0 +1,63 @@
+#version 450
+//Dual quaternion skinning. Same attributes and outputs as lit.vert.
+layout(location = 0) in vec3 vPos;
+layout(location = 1) in vec3 vNormal;
+layout(location = 2) in vec2 vTexCoord;
+layout(location = 3) in vec3 vTangent;
+layout(location = 4) in uvec4 vBoneIDs;
+layout(location = 5) in vec4 vBoneWeights;
+
+//Real and dual part per bone, _NumBones per instance, written by ew::SkinningPaletteBuffer.
+//Quaternions are stored xyzw.
+struct DualQuat{
+	vec4 real;
+	vec4 dual;
+};
+layout(std430, binding = 0) readonly buffer SkinningPalette{
+	DualQuat _Palette[];
+};
+uniform int _NumBones;
+
+uniform mat4 _Model; 
+uniform mat4 _ViewProjection;
+
+out Surface{
+	vec3 WorldPos; //Vertex position in world space
+	vec2 TexCoord;
+	mat3 TBN;
+}vs_out;
+
+vec3 rotate(vec4 q, vec3 v){
+	return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+void main(){
+	int paletteStart = gl_InstanceID * _NumBones;
+	vec4 pivot = _Palette[paletteStart + int(vBoneIDs.x)].real;
+	vec4 real = vec4(0.0);
+	vec4 dual = vec4(0.0);
+	for (int i = 0; i < 4; i++){
+		DualQuat dq = _Palette[paletteStart + int(vBoneIDs[i])];
+		//q and -q are the same rotation. Blend along the shortest arc.
+		float w = dot(dq.real, pivot) < 0.0 ? -vBoneWeights[i] : vBoneWeights[i];
+		real += dq.real * w;
+		dual += dq.dual * w;
+	}
+	float len = length(real);
+	vec3 localPos = vPos;
+	vec3 normal = vNormal;
+	vec3 tangent = vTangent;
+	//Unweighted vertices stay in bind pose
+	if (len > 0.0){
+		real /= len;
+		dual /= len;
+		vec3 translation = 2.0 * (real.w * dual.xyz - dual.w * real.xyz + cross(real.xyz, dual.xyz));
+		localPos = rotate(real, vPos) + translation;
+		normal = rotate(real, vNormal);
+		tangent = rotate(real, vTangent);
+	}
+	vs_out.WorldPos = vec3(_Model * vec4(localPos,1.0));
+	vs_out.TexCoord = vTexCoord;
+	vs_out.TBN = transpose(inverse(mat3(_Model))) * mat3(tangent,cross(normal,tangent),normal);
+	gl_Position = _ViewProjection * vec4(vs_out.WorldPos,1.0);
+}
@@ -0,0 +1,70 @@
+#version 450
+//Linear blend skinning from a bone matrix vertex animation texture. Same attributes and outputs as skinned.vert.
+//Each instance only carries where it stands and where it is in its clip, so nothing is updated on the CPU per frame.
+layout(location = 0) in vec3 vPos;
+layout(location = 1) in vec3 vNormal;
+layout(location = 2) in vec2 vTexCoord;
+layout(location = 3) in vec3 vTangent;
+layout(location = 4) in uvec4 vBoneIDs;
+layout(location = 5) in vec4 vBoneWeights;
+//ew::VATInstance
+layout(location = 6) in vec4 iTransform; //Position xyz, yaw
+layout(location = 7) in vec4 iPlayback; //First frame, frame count, start phase, loops per second
+
+//Rows of each palette matrix, 3 texels per bone. Written by ew::bakeBoneMatrixClip.
+uniform sampler2D _VAT;
+uniform int _VATWidth;
+uniform int _VATRowsPerFrame;
+uniform float _Time;
+
+uniform mat4 _Model; 
+uniform mat4 _ViewProjection;
+
+out Surface{
+	vec3 WorldPos; //Vertex position in world space
+	vec2 TexCoord;
+	mat3 TBN;
+}vs_out;
+
+mat4 fetchBone(int frame, int bone){
+	vec4 rows[3];
+	for (int r = 0; r < 3; r++){
+		int element = bone * 3 + r;
+		rows[r] = texelFetch(_VAT, ivec2(element % _VATWidth, frame * _VATRowsPerFrame + element / _VATWidth), 0);
+	}
+	return transpose(mat4(rows[0], rows[1], rows[2], vec4(0.0, 0.0, 0.0, 1.0)));
+}
+
+void main(){
+	//Blend the two nearest baked frames
+	int frameCount = int(iPlayback.y);
+	float frame = fract(iPlayback.z + _Time * iPlayback.w) * frameCount;
+	int frame0 = min(int(frame), frameCount - 1);
+	int frame1 = (frame0 + 1) % frameCount;
+	float t = frame - float(frame0);
+	frame0 += int(iPlayback.x);
+	frame1 += int(iPlayback.x);
+
+	mat4 skinMatrix = mat4(0.0);
+	for (int i = 0; i < 4; i++){
+		int bone = int(vBoneIDs[i]);
+		//mix has no matrix overload
+		skinMatrix += (fetchBone(frame0, bone) * (1.0 - t) + fetchBone(frame1, bone) * t) * vBoneWeights[i];
+	}
+	//Unweighted vertices stay in bind pose
+	if (vBoneWeights.x + vBoneWeights.y + vBoneWeights.z + vBoneWeights.w <= 0.0){
+		skinMatrix = mat4(1.0);
+	}
+	float s = sin(iTransform.w);
+	float c = cos(iTransform.w);
+	mat4 instanceMatrix = mat4(
+		vec4(c, 0.0, -s, 0.0),
+		vec4(0.0, 1.0, 0.0, 0.0),
+		vec4(s, 0.0, c, 0.0),
+		vec4(iTransform.xyz, 1.0));
+	mat4 model = instanceMatrix * _Model * skinMatrix;
+	vs_out.WorldPos = vec3(model * vec4(vPos,1.0));
+	vs_out.TexCoord = vTexCoord;
+	vs_out.TBN = transpose(inverse(mat3(model))) * mat3(vTangent,cross(vNormal,vTangent),vNormal);
+	gl_Position = _ViewProjection * vec4(vs_out.WorldPos,1.0);
+}
@@ -0,0 +1,57 @@
+#version 450
+//Plays back skinned positions and normals from a vertex position animation texture. Same outputs as lit.vert.
+//Only valid for the mesh the texture was baked from, as texels are looked up by gl_VertexID.
+layout(location = 0) in vec3 vPos;
+layout(location = 1) in vec3 vNormal;
+layout(location = 2) in vec2 vTexCoord;
+layout(location = 3) in vec3 vTangent;
+//ew::VATInstance
+layout(location = 6) in vec4 iTransform; //Position xyz, yaw
+layout(location = 7) in vec4 iPlayback; //First frame, frame count, start phase, loops per second
+
+//Written by ew::bakeVertexPositionClip
+uniform sampler2D _VAT;
+uniform sampler2D _VATNormals;
+uniform int _VATWidth;
+uniform int _VATRowsPerFrame;
+uniform float _Time;
+
+uniform mat4 _Model; 
+uniform mat4 _ViewProjection;
+
+out Surface{
+	vec3 WorldPos; //Vertex position in world space
+	vec2 TexCoord;
+	mat3 TBN;
+}vs_out;
+
+ivec2 texelCoord(int frame){
+	return ivec2(gl_VertexID % _VATWidth, frame * _VATRowsPerFrame + gl_VertexID / _VATWidth);
+}
+
+void main(){
+	int frameCount = int(iPlayback.y);
+	float frame = fract(iPlayback.z + _Time * iPlayback.w) * frameCount;
+	int frame0 = min(int(frame), frameCount - 1);
+	int frame1 = (frame0 + 1) % frameCount;
+	float t = frame - float(frame0);
+	ivec2 coord0 = texelCoord(frame0 + int(iPlayback.x));
+	ivec2 coord1 = texelCoord(frame1 + int(iPlayback.x));
+	vec3 pos = mix(texelFetch(_VAT, coord0, 0).xyz, texelFetch(_VAT, coord1, 0).xyz, t);
+	vec3 normal = normalize(mix(texelFetch(_VATNormals, coord0, 0).xyz, texelFetch(_VATNormals, coord1, 0).xyz, t));
+
+	float s = sin(iTransform.w);
+	float c = cos(iTransform.w);
+	mat4 instanceMatrix = mat4(
+		vec4(c, 0.0, -s, 0.0),
+		vec4(0.0, 1.0, 0.0, 0.0),
+		vec4(s, 0.0, c, 0.0),
+		vec4(iTransform.xyz, 1.0));
+	mat4 model = instanceMatrix * _Model;
+	vs_out.WorldPos = vec3(model * vec4(pos,1.0));
+	vs_out.TexCoord = vTexCoord;
+	//Tangents are not baked. Rebuild one perpendicular to the animated normal.
+	vec3 tangent = normalize(vTangent - normal * dot(vTangent, normal));
+	vs_out.TBN = transpose(inverse(mat3(model))) * mat3(tangent,cross(normal,tangent),normal);
+	gl_Position = _ViewProjection * vec4(vs_out.WorldPos,1.0);
+}
@@ -15,6 +15,15 @@
 #include <imgui_impl_opengl3.h>
 
 #include <ew/animation.h>
+#include <ew/animationCompression.h>
+#include <ew/animationWorld.h>
+#include <ew/animationCache.h>
+#include <ew/animationLOD.h>
+#include <ew/animationStreaming.h>
+#include <ew/skinning.h>
+#include <ew/bounds.h>
+#include <ew/vertexAnimation.h>
+#include <memory>
 
 void framebufferSizeCallback(GLFWwindow* window, int width, int height);
 GLFWwindow* initWindow(const char* title, int width, int height);
@@ -61,9 +70,38 @@ void debugLogAnimData(const ew::AnimationClip& clip) {
 }
 
 ew::AnimatedSkeletonPackage animPackage;
+ew::AnimationCursor animCursor;
+ew::CompressedAnimationClip compressedClip;
+bool useCompressedClip = false;
+//Same clip played from disk with only a few blocks resident
+ew::StreamingClipSampler streamingSampler;
+ew::AnimationBinding streamingBinding;
+bool useStreamingClip = false;
+bool drawSkeleton = false; //Draw a monkey per bone instead of the skinned character
+bool useDualQuatSkinning = false;
+
+//Synthetic crowd for timing multithreaded updates
+ew::AnimatedSkeletonPackage crowdPackages[2];
+std::unique_ptr<ew::AnimationWorld> crowdWorld;
+int crowdSize = 0;
+int crowdThreads = 1;
+float crowdSpacing = 1.5f;
+bool useCrowdLOD = false;
+bool measureCrowdLODError = false;
+ew::PoseCacheSettings crowdPoseCacheSettings;
+//Frustum culling from skinned bounds
+bool characterVisible = true;
+int crowdVisible = 0;
+float crowdCullMilliseconds = 0;
 float animationTime = 0;
 float animationSpeed = 1.0f;
 
+//GPU only crowd played back from a vertex animation texture
+ew::VertexAnimationTexture vat;
+float vatBakeMilliseconds = 0;
+int vatCrowdSize = 0;
+float vatCrowdSpacing = 1.5f;
+
 int main() {
 
 	
@@ -72,6 +110,8 @@ int main() {
 	GLuint stoneNormalTexture = ew::loadTexture("assets/stones_normal.png");
 
 	ew::Shader shader = ew::Shader("assets/lit.vert", "assets/lit.frag");
+	ew::Shader skinnedShader = ew::Shader("assets/skinned.vert", "assets/lit.frag");
+	ew::Shader skinnedDQShader = ew::Shader("assets/skinnedDQ.vert", "assets/lit.frag");
 	ew::Model monkeyModel = ew::Model("assets/Suzanne.obj");
 	ew::Model characterModel = ew::Model("assets/Walking.dae");
 	glEnable(GL_CULL_FACE);
@@ -86,9 +126,53 @@ int main() {
 
 	animPackage = ew::loadAnimationFromFile("assets/Walking.dae");
 	//debugLogAnimData(walkAnim);
+	ew::AnimationCompressionReport compressionReport;
+	compressedClip = ew::compressAnimationClip(animPackage.animationClip, ew::AnimationCompressionSettings(), &compressionReport);
+	ew::printAnimationCompressionReport(compressionReport);
+	ew::AnimationBakeReport bakeReport;
+	ew::bakeAnimationClip(&animPackage.animationClip, 30.0f, &bakeReport);
+	printf("Baked %d frames (%zu bytes), max error: position %f, rotation %f rad, scale %f\n", bakeReport.numFrames, bakeReport.bakedBytes,
+		bakeReport.maxPositionError, bakeReport.maxRotationError, bakeReport.maxScaleError);
+	//Small blocks so even this short clip streams through several of them. Only rewritten when Walking.dae changes.
+	if (ew::isStreamingClipStale("assets/Walking.dae.ewstream", "assets/Walking.dae")) {
+		ew::writeStreamingClip(animPackage.animationClip, 30.0f, "assets/Walking.dae.ewstream", 8);
+	}
+	if (streamingSampler.open("assets/Walking.dae.ewstream", 2)) {
+		streamingBinding = streamingSampler.bind(animPackage.skeleton);
+	}
+
+	//The first run writes the caches. The benchmarks executable compares this against Assimp.
+	const char* crowdFiles[2] = { "assets/Dancing.dae", "assets/WalkingAnim.fbx" };
+	for (int i = 0; i < 2; i++)
+	{
+		crowdPackages[i] = ew::loadAnimationFromFileCached(crowdFiles[i]);
+		//Fingers and face bones of Mixamo rigs
+		int numOptional = ew::markOptionalBones(&crowdPackages[i].skeleton, { "Thumb", "Index", "Middle", "Ring", "Pinky", "Eye", "Jaw", "HeadTop_End" });
+		printf("%s: %d optional bones\n", crowdFiles[i], numOptional);
+	}
+	crowdWorld = std::make_unique<ew::AnimationWorld>(crowdThreads);
 	std::vector<glm::mat4> boneWorldMatrices;
 
 	ew::solveFK(animPackage.skeleton, boneWorldMatrices);
+	ew::SkinBinding skinBinding = ew::bindSkin(characterModel, animPackage.skeleton);
+	std::vector<glm::mat4> skinningPalette(characterModel.getNumBones());
+	std::vector<ew::DualQuat> dualQuatPalette(characterModel.getNumBones());
+	ew::DualQuatPose dualQuatPose;
+	ew::loadDualQuatPose(animPackage.skeleton, &dualQuatPose);
+	ew::SkinningPaletteBuffer skinningPaletteBuffer;
+	ew::SkinnedBounds characterBounds = ew::makeSkinnedBounds(characterModel, skinBinding);
+	ew::SkinnedBounds crowdBounds[2];
+	for (int i = 0; i < 2; i++)
+	{
+		crowdBounds[i] = ew::makeSkinnedBounds(characterModel, ew::bindSkin(characterModel, crowdPackages[i].skeleton));
+	}
+
+	ew::Shader vatShader = ew::Shader("assets/vat.vert", "assets/lit.frag");
+	//Baked the first time the VAT crowd is shown
+	int vatClip = -1;
+	GLuint vatTexture = 0;
+	int vatInstanceCount = 0;
+	std::vector<ew::VATInstance> vatInstances;
 
 	while (!glfwWindowShouldClose(window)) {
 		glfwPollEvents();
@@ -102,8 +186,45 @@ int main() {
 
 		//Loop normalized time (0-1s)
 	 	animationTime = glm::fract(time * animationSpeed);
-		ew::updateSkeleton(&animPackage.skeleton, &animPackage.animationClip, animationTime);
+		if (useStreamingClip && streamingSampler.isOpen()) {
+			streamingSampler.updateSkeleton(&animPackage.skeleton, streamingBinding, animationTime);
+		}
+		else if (useCompressedClip) {
+			ew::updateSkeleton(&animPackage.skeleton, &compressedClip, animPackage.binding, animationTime, &animCursor);
+		}
+		else {
+			ew::updateSkeleton(&animPackage, animationTime, &animCursor);
+		}
 		ew::solveFK(animPackage.skeleton, boneWorldMatrices);
+
+		//Alternate crowd clips, staggering start times
+		if ((int)crowdWorld->getNumInstances() != crowdSize) {
+			crowdWorld->clearInstances();
+			for (int i = 0; i < crowdSize; i++)
+			{
+				int instance = crowdWorld->addInstance(crowdPackages[i % 2], glm::fract(i * 0.618f));
+				//Square grid in front of the camera
+				int columns = (int)ceilf(sqrtf((float)crowdSize));
+				crowdWorld->getInstance(instance).position = glm::vec3((i % columns) * crowdSpacing, 0.0f, -(i / columns) * crowdSpacing);
+			}
+		}
+		crowdWorld->setViewerPosition(camera.position);
+		crowdWorld->update(deltaTime);
+
+		//Instances outside the view update at the coarsest LOD, or not at all without LOD, from the next update on
+		const ew::Frustum frustum = ew::extractFrustum(camera.projectionMatrix() * camera.viewMatrix());
+		double cullStart = glfwGetTime();
+		crowdVisible = 0;
+		for (int i = 0; i < (int)crowdWorld->getNumInstances(); i++)
+		{
+			ew::AnimationInstance& instance = crowdWorld->getInstance(i);
+			ew::AABB aabb = ew::computeSkinnedAABB(crowdBounds[i % 2], instance.worldMatrices, glm::translate(glm::mat4(1.0f), instance.position));
+			instance.visible = ew::isVisible(frustum, aabb);
+			crowdVisible += instance.visible ? 1 : 0;
+		}
+		crowdCullMilliseconds = (float)((glfwGetTime() - cullStart) * 1000.0);
+		characterVisible = ew::isVisible(frustum, ew::computeSkinnedAABB(characterBounds, boneWorldMatrices));
+
 		//monkeyTransform.rotation = glm::rotate(monkeyTransform.rotation, deltaTime, glm::vec3(0.0, 1.0, 0.0));
 
 		//RENDER
@@ -128,11 +249,87 @@ int main() {
 		shader.setMat4("_Model", monkeyTransform.modelMatrix());
 	//	monkeyModel.draw(); //Draws monkey model using current shader
 
-		//Draw skeleton made of monkeys 
-		for (size_t i = 0; i < boneWorldMatrices.size(); i++)
-		{
-			shader.setMat4("_Model", boneWorldMatrices[i]);
-			monkeyModel.draw();
+		if (drawSkeleton) {
+			//Draw skeleton made of monkeys 
+			for (size_t i = 0; i < boneWorldMatrices.size(); i++)
+			{
+				shader.setMat4("_Model", boneWorldMatrices[i]);
+				monkeyModel.draw();
+			}
+		}
+		else if (characterVisible) {
+			characterModel.setSkinningMode(useDualQuatSkinning ? ew::SkinningMode::DUAL_QUATERNION : ew::SkinningMode::LINEAR_BLEND);
+			ew::Shader& activeSkinnedShader = characterModel.getSkinningMode() == ew::SkinningMode::DUAL_QUATERNION ? skinnedDQShader : skinnedShader;
+			if (characterModel.getSkinningMode() == ew::SkinningMode::DUAL_QUATERNION) {
+				if (useCompressedClip || (useStreamingClip && streamingSampler.isOpen())) {
+					//Compressed and streamed clips only drive mat4 skeletons
+					for (size_t i = 0; i < boneWorldMatrices.size(); i++)
+					{
+						dualQuatPose.worldTransforms[i] = ew::dualQuatFromMat4(boneWorldMatrices[i]);
+					}
+				}
+				else {
+					ew::updateDualQuatPose(&dualQuatPose, &animPackage.animationClip, animPackage.binding, animationTime);
+				}
+				ew::computeDualQuatSkinningPalette(skinBinding, dualQuatPose, dualQuatPalette.data());
+				skinningPaletteBuffer.upload(dualQuatPalette.data(), characterModel.getNumBones());
+			}
+			else {
+				ew::computeSkinningPalette(skinBinding, boneWorldMatrices, skinningPalette.data());
+				skinningPaletteBuffer.upload(skinningPalette.data(), characterModel.getNumBones());
+			}
+			skinningPaletteBuffer.bind();
+			activeSkinnedShader.use();
+			activeSkinnedShader.setInt("_MainTex", 0);
+			activeSkinnedShader.setInt("_NormalMap", 1);
+			activeSkinnedShader.setFloat("_Material.Ka", material.Ka);
+			activeSkinnedShader.setFloat("_Material.Kd", material.Kd);
+			activeSkinnedShader.setFloat("_Material.Ks", material.Ks);
+			activeSkinnedShader.setFloat("_Material.Shininess", material.Shininess);
+			activeSkinnedShader.setVec3("_EyePos", camera.position);
+			activeSkinnedShader.setMat4("_ViewProjection", camera.projectionMatrix() * camera.viewMatrix());
+			activeSkinnedShader.setMat4("_Model", glm::mat4(1.0f));
+			activeSkinnedShader.setInt("_NumBones", characterModel.getNumBones());
+			characterModel.draw();
+		}
+
+		if (vatCrowdSize > 0 && vatTexture == 0) {
+			double bakeStart = glfwGetTime();
+			ew::initVertexAnimationTexture(&vat, ew::VATType::BONE_MATRICES, characterModel.getNumBones() * 3);
+			vatClip = ew::bakeBoneMatrixClip(animPackage, skinBinding, 30.0f, &vat);
+			vatBakeMilliseconds = (float)((glfwGetTime() - bakeStart) * 1000.0);
+			printf("Baked VAT: %d frames, %dx%d texels, %.2f ms\n", vat.numFrames, vat.width, vat.getHeight(), vatBakeMilliseconds);
+			vatTexture = ew::createFloatTexture(vat.width, vat.getHeight(), vat.texels.data());
+		}
+		if (vatCrowdSize > 0 && vatClip >= 0) {
+			//Instances only change when the crowd is resized. Playback is all on the GPU.
+			if (vatInstanceCount != vatCrowdSize) {
+				vatInstanceCount = vatCrowdSize;
+				vatInstances.resize(vatCrowdSize);
+				int columns = (int)ceilf(sqrtf((float)vatCrowdSize));
+				for (int i = 0; i < vatCrowdSize; i++)
+				{
+					glm::vec3 position = glm::vec3((i % columns) * vatCrowdSpacing, 0.0f, (i / columns + 1) * vatCrowdSpacing);
+					vatInstances[i] = ew::makeVATInstance(vat, vatClip, position, glm::fract(i * 0.382f) * 6.2831853f, glm::fract(i * 0.618f));
+				}
+				characterModel.setInstanceAttributes(&vatInstances[0].transform, vatCrowdSize, 2);
+			}
+			glBindTextureUnit(2, vatTexture);
+			vatShader.use();
+			vatShader.setInt("_MainTex", 0);
+			vatShader.setInt("_NormalMap", 1);
+			vatShader.setInt("_VAT", 2);
+			vatShader.setInt("_VATWidth", vat.width);
+			vatShader.setInt("_VATRowsPerFrame", vat.rowsPerFrame);
+			vatShader.setFloat("_Time", time * animationSpeed);
+			vatShader.setFloat("_Material.Ka", material.Ka);
+			vatShader.setFloat("_Material.Kd", material.Kd);
+			vatShader.setFloat("_Material.Ks", material.Ks);
+			vatShader.setFloat("_Material.Shininess", material.Shininess);
+			vatShader.setVec3("_EyePos", camera.position);
+			vatShader.setMat4("_ViewProjection", camera.projectionMatrix() * camera.viewMatrix());
+			vatShader.setMat4("_Model", glm::mat4(1.0f));
+			characterModel.drawInstanced(vatCrowdSize);
 		}
 		
 		drawUI();
@@ -142,6 +339,8 @@ int main() {
 		glfwSwapBuffers(window);
 	}
 	printf("Shutting down...");
+	//Joins the crowd's worker threads
+	crowdWorld.reset();
 }
 void resetCamera(ew::Camera* camera, ew::CameraController* controller) {
 	camera->position = glm::vec3(0, 0, 5.0f);
@@ -170,6 +369,62 @@ void drawUI() {
 	}*/
 	ImGui::SliderFloat("Animation Time", &animationTime, 0.0f, 1.0f);
 	ImGui::DragFloat("Animaiton Speed", &animationSpeed, 0.05f);
+	ImGui::Checkbox("Compressed Clip", &useCompressedClip);
+	ImGui::Checkbox("Baked Clip (30Hz)", &animPackage.animationClip.useBakedTrack);
+	ImGui::Checkbox("Draw Skeleton", &drawSkeleton);
+	ImGui::Checkbox("Dual Quaternion Skinning", &useDualQuatSkinning);
+	ImGui::Text("Character %s", characterVisible ? "visible" : "culled");
+	if (ImGui::CollapsingHeader("Streaming")) {
+		ImGui::Checkbox("Streamed Clip", &useStreamingClip);
+		ew::StreamingClipStats streamingStats = streamingSampler.getStats();
+		ImGui::Text("%d/%d blocks resident", streamingStats.residentBlocks, streamingStats.numBlocks);
+		ImGui::Text("Resident: %.1f KB of %.1f KB", streamingStats.residentBytes / 1024.0f, streamingStats.fileBytes / 1024.0f);
+		ImGui::Text("Blocks loaded: %d, stalls: %d", streamingStats.blocksLoaded, streamingStats.stalls);
+	}
+	if (ImGui::CollapsingHeader("VAT Crowd")) {
+		ImGui::SliderInt("Instances", &vatCrowdSize, 0, 10000);
+		if (vat.numFrames > 0) {
+			ImGui::Text("%d frames, %dx%d texels (%.1f KB)", vat.numFrames, vat.width, vat.getHeight(), vat.texels.size() * sizeof(float) / 1024.0f);
+			ImGui::Text("Bake: %.2f ms", vatBakeMilliseconds);
+		}
+	}
+	if (ImGui::CollapsingHeader("Crowd")) {
+		ImGui::SliderInt("Crowd Size", &crowdSize, 0, 5000);
+		if (ImGui::SliderInt("Threads", &crowdThreads, 1, glm::max((int)std::thread::hardware_concurrency(), 1))) {
+			crowdWorld->setNumThreads(crowdThreads);
+		}
+		ImGui::Text("Update: %.3f ms", crowdWorld->getLastUpdateMilliseconds());
+		if (ImGui::Checkbox("LOD", &useCrowdLOD)) {
+			crowdWorld->setLODSettings(useCrowdLOD ? ew::defaultAnimationLODSettings() : ew::AnimationLODSettings());
+		}
+		if (ImGui::Checkbox("Measure LOD Error", &measureCrowdLODError)) {
+			crowdWorld->setMeasureLODError(measureCrowdLODError);
+		}
+		const ew::AnimationLODStats& lodStats = crowdWorld->getLODStats();
+		for (size_t i = 0; i < lodStats.instancesPerLevel.size(); i++)
+		{
+			ImGui::Text("LOD %d: %d instances", (int)i, lodStats.instancesPerLevel[i]);
+		}
+		ImGui::Text("Sampled: %d instances, %d channels", lodStats.sampledInstances, lodStats.sampledChannels);
+		ImGui::Text("Visible: %d/%d (bounds and culling %.3f ms)", crowdVisible, (int)crowdWorld->getNumInstances(), crowdCullMilliseconds);
+		if (measureCrowdLODError) {
+			ImGui::Text("Max bone error: %f", lodStats.maxPositionError);
+		}
+		bool batchSampling = crowdWorld->getBatchSampling();
+		if (ImGui::Checkbox("Batch Sampling", &batchSampling)) {
+			crowdWorld->setBatchSampling(batchSampling);
+		}
+		bool poseCacheChanged = ImGui::Checkbox("Pose Cache", &crowdPoseCacheSettings.enabled);
+		poseCacheChanged |= ImGui::SliderFloat("Time Step (s)", &crowdPoseCacheSettings.timeStep, 0.0f, 0.1f);
+		if (poseCacheChanged) {
+			crowdWorld->setPoseCacheSettings(crowdPoseCacheSettings);
+		}
+		if (crowdPoseCacheSettings.enabled) {
+			const ew::PoseCacheStats& cacheStats = crowdWorld->getPoseCacheStats();
+			ImGui::Text("Hit rate: %.1f%% (%d poses for %d lookups)", cacheStats.getHitRate() * 100.0f, cacheStats.entries, cacheStats.lookups);
+			ImGui::Text("Saved: %.3f ms", cacheStats.savedMilliseconds);
+		}
+	}
 	ImGui::End();
 
 	ImGui::Render();
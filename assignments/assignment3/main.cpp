@@ -100,7 +100,13 @@ const float MAX_POINT_LIGHT_RADIUS = 10.0f;
 const float PLANE_SIZE = 40.0f;
 bool drawLightOrbs = true;
 
-void drawScene(ew::Camera& camera, ew::Shader& shader) {
+//Levels of detail
+bool useLODs = true;
+float lodThreshold = 0.005f; //Fraction of screen height
+ew::LODStats lodStats; //Totals over every pass of the last frame
+
+//Levels of detail are picked by lodCamera, so every pass draws the same geometry
+void drawScene(ew::Camera& camera, ew::Shader& shader, const ew::Camera& lodCamera) {
 	shader.use();
 	shader.setMat4("_ViewProjection", camera.projectionMatrix() * camera.viewMatrix());
 
@@ -115,8 +121,9 @@ void drawScene(ew::Camera& camera, ew::Shader& shader) {
 	shader.setVec2("_Tiling", glm::vec2(1.0f));
 	for (size_t i = 0; i < MONKEY_COUNT; i++)
 	{
-		shader.setMat4("_Model", monkeyTransforms[i].modelMatrix());
-		monkeyModel.draw();
+		const glm::mat4 modelMatrix = monkeyTransforms[i].modelMatrix();
+		shader.setMat4("_Model", modelMatrix);
+		monkeyModel.draw(modelMatrix, lodCamera);
 	}
 	
 }
@@ -256,6 +263,9 @@ int main() {
 		//Update instanced light data
 		glNamedBufferData(lightInstanceVBO, sizeof(instancedLightData), &instancedLightData[0], GL_DYNAMIC_DRAW);
 
+		monkeyModel.setLODThreshold(useLODs ? lodThreshold : 0.0f);
+		monkeyModel.resetLODStats();
+
 		glDisable(GL_BLEND);
 		//RENDER MAIN LIGHT SHADOW MAP
 		{
@@ -266,7 +276,8 @@ int main() {
 
 			shadowCamera.position = shadowCamera.target - (glm::normalize(mainLight.direction) * shadowSettings.camDistance);
 			glCullFace(GL_FRONT);
-			drawScene(shadowCamera, depthOnlyShader);
+			//Casters at the LOD the main camera sees, so they match the receivers
+			drawScene(shadowCamera, depthOnlyShader, mainCamera);
 			glCullFace(GL_BACK);
 		}
 
@@ -295,7 +306,7 @@ int main() {
 
 			litShader.setInt("_NumPointLights", numPointLights);
 
-			drawScene(mainCamera, litShader);
+			drawScene(mainCamera, litShader, mainCamera);
 			
 			//Instanced render light sources
 			if (drawLightOrbs)
@@ -313,7 +324,7 @@ int main() {
 				glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 				
-				drawScene(mainCamera, gBufferShader);
+				drawScene(mainCamera, gBufferShader, mainCamera);
 			}
 
 			//Render light volumes to light buffer
@@ -447,6 +458,7 @@ int main() {
 			glDrawArrays(GL_TRIANGLES, 0, 3);
 		}
 
+		lodStats = monkeyModel.getLODStats();
 		drawUI();
 
 		glfwSwapBuffers(window);
@@ -495,6 +507,12 @@ void drawUI() {
 		}
 		ImGui::Combo("Render Path", &renderPathIndex, renderPaths, IM_ARRAYSIZE(renderPaths));
 		ImGui::Checkbox("Draw Light Orbs", &drawLightOrbs);
+		if (ImGui::CollapsingHeader("Level of Detail")) {
+			ImGui::Checkbox("Use LODs", &useLODs);
+			ImGui::SliderFloat("Screen Error", &lodThreshold, 0.0001f, 0.05f, "%.4f", ImGuiSliderFlags_Logarithmic);
+			const float saved = lodStats.fullTriangles > 0 ? 100.0f * (1.0f - (float)lodStats.drawnTriangles / lodStats.fullTriangles) : 0.0f;
+			ImGui::Text("Monkey triangles: %zu of %zu (%.1f%% saved)", lodStats.drawnTriangles, lodStats.fullTriangles, saved);
+		}
 	}
 	ImGui::End();
 
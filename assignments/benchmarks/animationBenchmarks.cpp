@@ -0,0 +1,743 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include <string>
+#include <algorithm>
+
+#include <GLFW/glfw3.h>
+#include <ew/animation.h>
+#include <ew/animationBatch.h>
+#include <ew/animationWorld.h>
+#include <ew/animationCache.h>
+#include <ew/animationLibrary.h>
+#include <ew/skinning.h>
+#include <ew/poseBuffer.h>
+#include <ew/ik.h>
+#include <assimp/scene.h>
+
+#include "benchmarks.h"
+
+//Keyframe search before cursors: scan from key 0 for the first key at or after time
+static glm::vec3 lerpVec3KeyFramesLinear(const std::vector<ew::Vec3KeyFrame>& keyFrames, float time) {
+	const size_t numKeyFrames = keyFrames.size();
+	size_t next = 0;
+	while (next < numKeyFrames && keyFrames[next].time < time)
+		next++;
+	if (next == 0)
+		return keyFrames[0].value;
+	if (next == numKeyFrames)
+		return keyFrames[numKeyFrames - 1].value;
+	const ew::Vec3KeyFrame& prevKeyFrame = keyFrames[next - 1];
+	const ew::Vec3KeyFrame& nextKeyFrame = keyFrames[next];
+	float t = (time - prevKeyFrame.time) / (nextKeyFrame.time - prevKeyFrame.time);
+	return prevKeyFrame.value * (1.f - t) + nextKeyFrame.value * t;
+}
+
+//Plays one track forward for a full loop at 2 samples per key, like a 30 key/s clip drawn at 60 fps
+bool runKeyFrameSearchBenchmark() {
+	const int keyCounts[] = { 16, 256, 4096 };
+	const int samplesPerKey = 2;
+	bool matches = true;
+	for (int numKeys : keyCounts)
+	{
+		std::vector<ew::Vec3KeyFrame> keyFrames(numKeys);
+		for (int i = 0; i < numKeys; i++)
+		{
+			keyFrames[i].time = (float)i;
+			keyFrames[i].value = glm::vec3(rand() % 100, rand() % 100, rand() % 100);
+		}
+		const int numSamples = numKeys * samplesPerKey;
+		//At least a million samples so small tracks still time reliably
+		const int loops = glm::max(1000000 / numSamples, 1);
+		const float step = (numKeys - 1) / (float)numSamples;
+		glm::vec3 sumLinear = glm::vec3(0), sumBinary = glm::vec3(0), sumCursor = glm::vec3(0);
+
+		double startTime = glfwGetTime();
+		for (int l = 0; l < loops; l++)
+		{
+			for (int s = 0; s < numSamples; s++)
+				sumLinear += lerpVec3KeyFramesLinear(keyFrames, s * step);
+		}
+		const double linearTime = glfwGetTime() - startTime;
+		startTime = glfwGetTime();
+		for (int l = 0; l < loops; l++)
+		{
+			for (int s = 0; s < numSamples; s++)
+				sumBinary += ew::lerpVec3KeyFrames(keyFrames, s * step);
+		}
+		const double binaryTime = glfwGetTime() - startTime;
+		size_t cursor = 0;
+		startTime = glfwGetTime();
+		for (int l = 0; l < loops; l++)
+		{
+			for (int s = 0; s < numSamples; s++)
+				sumCursor += ew::lerpVec3KeyFrames(keyFrames, s * step, &cursor);
+		}
+		const double cursorTime = glfwGetTime() - startTime;
+
+		//Same keys are found, so the sums are identical
+		matches &= sumLinear == sumBinary && sumBinary == sumCursor;
+		const double nanosecondsPerSample = 1000000000.0 / ((double)loops * numSamples);
+		printf("%5d keys: linear %.1f ns, binary search %.1f ns, cursor %.1f ns per sample\n", numKeys,
+			linearTime * nanosecondsPerSample, binaryTime * nanosecondsPerSample, cursorTime * nanosecondsPerSample);
+	}
+	printf("Results match: %s\n", matches ? "yes" : "NO");
+	return matches;
+}
+
+static float randomRange(float min, float max) {
+	return min + (max - min) * (rand() / (float)RAND_MAX);
+}
+
+//Chain of numBones bones, each channel with numKeys random keys on all 3 tracks
+ew::AnimatedSkeletonPackage makeSyntheticPackage(int numBones, int numKeys) {
+	ew::AnimatedSkeletonPackage package;
+	package.animationClip.duration = (float)(numKeys - 1);
+	package.animationClip.ticksPerSecond = 30;
+	for (int b = 0; b < numBones; b++)
+	{
+		ew::Bone bone;
+		bone.name = "bone" + std::to_string(b);
+		//Branch every 8 bones so the hierarchy is not one long chain
+		bone.parentIndex = b == 0 ? -1 : (b % 8 == 0 ? 0 : b - 1);
+		bone.inverseBindPose = glm::mat4(1);
+		bone.localTransform = glm::mat4(1);
+		package.skeleton.bones.push_back(bone);
+
+		ew::BoneAnimation boneAnim;
+		boneAnim.name = bone.name;
+		for (int k = 0; k < numKeys; k++)
+		{
+			ew::Vec3KeyFrame position, scale;
+			ew::QuatKeyFrame rotation;
+			position.time = rotation.time = scale.time = (float)k;
+			position.value = glm::vec3(randomRange(-1, 1), randomRange(-1, 1), randomRange(-1, 1));
+			rotation.value = glm::normalize(glm::quat(randomRange(0.5f, 1), randomRange(-0.5f, 0.5f), randomRange(-0.5f, 0.5f), randomRange(-0.5f, 0.5f)));
+			scale.value = glm::vec3(randomRange(0.9f, 1.1f));
+			boneAnim.positionKeyFrames.push_back(position);
+			boneAnim.rotationKeyFrames.push_back(rotation);
+			boneAnim.scaleKeyFrames.push_back(scale);
+		}
+		package.animationClip.bones.push_back(boneAnim);
+		package.binding.boneIndices.push_back(b);
+	}
+	return package;
+}
+
+static float maxLocalTransformDifference(const ew::Skeleton& a, const ew::Skeleton& b) {
+	float maxDifference = 0.0f;
+	for (size_t i = 0; i < a.bones.size(); i++)
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			for (int r = 0; r < 4; r++)
+				maxDifference = glm::max(maxDifference, fabsf(a.bones[i].localTransform[c][r] - b.bones[i].localTransform[c][r]));
+		}
+	}
+	return maxDifference;
+}
+
+//A crowd of 64 instances of one clip at scattered times, advanced a frame at a time.
+//Scalar is updateSkeleton per instance with its own cursor, batch is one sampleAnimationClipBatch for all of them.
+//Then the same comparison through AnimationWorld::update with batch sampling off and on.
+bool runBatchSamplingBenchmark() {
+	const int numBones = 60;
+	const int numKeys = 60;
+	const int numSamples = 64;
+	const int numFrames = 2000;
+	const float timeStep = 1.0f / 600.0f;
+	const float tolerance = 1e-4f;
+	bool passed = true;
+	ew::AnimatedSkeletonPackage package = makeSyntheticPackage(numBones, numKeys);
+	ew::bakeAnimationClip(&package.animationClip, 30.0f);
+
+	std::vector<float> startTimes(numSamples);
+	for (int i = 0; i < numSamples; i++)
+	{
+		startTimes[i] = randomRange(0, 1);
+	}
+	std::vector<ew::Skeleton> scalarSkeletons(numSamples, package.skeleton);
+	std::vector<ew::Skeleton> batchSkeletons(numSamples, package.skeleton);
+	std::vector<ew::AnimationCursor> cursors(numSamples);
+	std::vector<float> times(numSamples);
+	ew::PoseBatch poseBatch;
+	for (int baked = 0; baked < 2; baked++)
+	{
+		ew::AnimationClip& animClip = package.animationClip;
+		animClip.useBakedTrack = baked == 1;
+		ew::QuatInterpolation quatInterpolation = animClip.useBakedTrack ? ew::QuatInterpolation::NLERP : ew::QuatInterpolation::SLERP;
+
+		double startTime = glfwGetTime();
+		for (int f = 0; f < numFrames; f++)
+		{
+			for (int i = 0; i < numSamples; i++)
+			{
+				ew::updateSkeleton(&scalarSkeletons[i], &animClip, package.binding, glm::fract(startTimes[i] + f * timeStep), &cursors[i]);
+			}
+		}
+		const double scalarTime = glfwGetTime() - startTime;
+		startTime = glfwGetTime();
+		for (int f = 0; f < numFrames; f++)
+		{
+			for (int i = 0; i < numSamples; i++)
+			{
+				times[i] = glm::fract(startTimes[i] + f * timeStep);
+			}
+			ew::sampleAnimationClipBatch(animClip, times.data(), numSamples, &poseBatch, quatInterpolation);
+			for (int i = 0; i < numSamples; i++)
+			{
+				ew::applyPoseBatch(poseBatch, i, package.binding, &batchSkeletons[i]);
+			}
+		}
+		const double batchTime = glfwGetTime() - startTime;
+
+		float maxDifference = 0.0f;
+		for (int i = 0; i < numSamples; i++)
+		{
+			maxDifference = glm::max(maxDifference, maxLocalTransformDifference(scalarSkeletons[i], batchSkeletons[i]));
+		}
+		passed &= maxDifference < tolerance;
+		const double totalSamples = (double)numFrames * numSamples;
+		printf("%s, %d bones: scalar %.2f M samples/s, batch %.2f M samples/s (%.2fx), max difference %g\n",
+			baked ? "Baked track" : "Keyframes", numBones, totalSamples / scalarTime / 1e6, totalSamples / batchTime / 1e6,
+			scalarTime / batchTime, maxDifference);
+	}
+
+	//Single threaded, no LOD or pose cache, so every instance samples every frame
+	const int numInstances = 1024;
+	const int numWorldFrames = 100;
+	package.animationClip.useBakedTrack = false;
+	ew::AnimationWorld scalarWorld(1), batchWorld(1);
+	scalarWorld.setBatchSampling(false);
+	batchWorld.setBatchSampling(true);
+	for (int i = 0; i < numInstances; i++)
+	{
+		float startTime = randomRange(0, 1);
+		scalarWorld.addInstance(package, startTime);
+		batchWorld.addInstance(package, startTime);
+	}
+	double scalarWorldTime = 0.0, batchWorldTime = 0.0;
+	for (int f = 0; f < numWorldFrames; f++)
+	{
+		double startTime = glfwGetTime();
+		scalarWorld.update(1.0f / 60.0f);
+		scalarWorldTime += glfwGetTime() - startTime;
+		startTime = glfwGetTime();
+		batchWorld.update(1.0f / 60.0f);
+		batchWorldTime += glfwGetTime() - startTime;
+	}
+	float maxWorldDifference = 0.0f;
+	for (int i = 0; i < numInstances; i++)
+	{
+		const std::vector<glm::mat4>& a = scalarWorld.getInstance(i).worldMatrices;
+		const std::vector<glm::mat4>& b = batchWorld.getInstance(i).worldMatrices;
+		for (size_t m = 0; m < a.size(); m++)
+		{
+			maxWorldDifference = glm::max(maxWorldDifference, glm::distance(glm::vec3(a[m][3]), glm::vec3(b[m][3])));
+		}
+	}
+	passed &= maxWorldDifference < tolerance * numBones;
+	printf("AnimationWorld, %d instances: scalar %.3f ms, batch %.3f ms per update (%.2fx), max bone position difference %g\n",
+		numInstances, scalarWorldTime * 1000.0 / numWorldFrames, batchWorldTime * 1000.0 / numWorldFrames,
+		scalarWorldTime / batchWorldTime, maxWorldDifference);
+	return passed;
+}
+
+static bool packagesMatch(const ew::AnimatedSkeletonPackage& a, const ew::AnimatedSkeletonPackage& b) {
+	if (a.skeleton.bones.size() != b.skeleton.bones.size() || a.animationClip.bones.size() != b.animationClip.bones.size()
+		|| a.animationClip.duration != b.animationClip.duration || a.binding.boneIndices != b.binding.boneIndices)
+		return false;
+	for (size_t i = 0; i < a.animationClip.bones.size(); i++)
+	{
+		const ew::BoneAnimation& boneA = a.animationClip.bones[i];
+		const ew::BoneAnimation& boneB = b.animationClip.bones[i];
+		if (boneA.name != boneB.name || boneA.positionKeyFrames.size() != boneB.positionKeyFrames.size()
+			|| boneA.rotationKeyFrames.size() != boneB.rotationKeyFrames.size() || boneA.scaleKeyFrames.size() != boneB.scaleKeyFrames.size())
+			return false;
+	}
+	return true;
+}
+
+//Assimp import against a current .ewanim cache, for the crowd clips of assignment0.
+//The cached time includes hashing the source file, as every cached load does.
+bool runAnimationCacheBenchmark() {
+	const char* files[2] = { "assets/Dancing.dae", "assets/WalkingAnim.fbx" };
+	const int runs = 5;
+	bool passed = true;
+	for (const char* file : files)
+	{
+		//Makes sure the cache exists and is current before timing
+		if (ew::loadAnimationFromFileCached(file).skeleton.bones.empty()) {
+			printf("Failed to import %s\n", file);
+			passed = false;
+			continue;
+		}
+		ew::AnimatedSkeletonPackage imported, cached;
+		double startTime = glfwGetTime();
+		for (int r = 0; r < runs; r++)
+		{
+			imported = ew::loadAnimationFromFile(file);
+		}
+		const double assimpTime = glfwGetTime() - startTime;
+		startTime = glfwGetTime();
+		for (int r = 0; r < runs; r++)
+		{
+			cached = ew::loadAnimationFromFileCached(file);
+		}
+		const double cacheTime = glfwGetTime() - startTime;
+		const bool matches = packagesMatch(imported, cached);
+		passed &= matches;
+		printf("%s: Assimp %.2f ms, cache %.2f ms (%.1fx), %zu bones, %zu channels, match: %s\n", file,
+			assimpTime * 1000.0 / runs, cacheTime * 1000.0 / runs, assimpTime / cacheTime,
+			imported.skeleton.bones.size(), imported.animationClip.bones.size(), matches ? "yes" : "NO");
+	}
+	return passed;
+}
+
+//Palette build time per character, from clip sampling to the finished palette.
+//The synthetic rig has no scale, so both palettes must move each bone to the same place.
+bool runPaletteBenchmark() {
+	const int numBones = 65;
+	const int iterations = 10000;
+	const float tolerance = 1e-4f;
+	ew::AnimatedSkeletonPackage package = makeSyntheticPackage(numBones, 30);
+	for (ew::BoneAnimation& boneAnim : package.animationClip.bones)
+	{
+		boneAnim.scaleKeyFrames.clear();
+	}
+	//Identity bind poses, one palette entry per bone
+	ew::SkinBinding skinBinding;
+	skinBinding.boneIndices.resize(numBones);
+	skinBinding.inverseBindPoses.assign(numBones, glm::mat4(1));
+	skinBinding.inverseBindDualQuats.assign(numBones, ew::DualQuat());
+	for (int i = 0; i < numBones; i++)
+	{
+		skinBinding.boneIndices[i] = i;
+	}
+	std::vector<glm::mat4> worldMatrices;
+	std::vector<glm::mat4> palette(numBones);
+	std::vector<ew::DualQuat> dualQuatPalette(numBones);
+	ew::DualQuatPose dualQuatPose;
+	ew::loadDualQuatPose(package.skeleton, &dualQuatPose);
+
+	double startTime = glfwGetTime();
+	for (int i = 0; i < iterations; i++)
+	{
+		ew::updateSkeleton(&package.skeleton, &package.animationClip, package.binding, (float)i / iterations);
+		ew::solveFK(package.skeleton, worldMatrices);
+		ew::computeSkinningPalette(skinBinding, worldMatrices, palette.data());
+	}
+	const double linearTime = glfwGetTime() - startTime;
+	startTime = glfwGetTime();
+	for (int i = 0; i < iterations; i++)
+	{
+		ew::updateDualQuatPose(&dualQuatPose, &package.animationClip, package.binding, (float)i / iterations);
+		ew::computeDualQuatSkinningPalette(skinBinding, dualQuatPose, dualQuatPalette.data());
+	}
+	const double dualQuatTime = glfwGetTime() - startTime;
+
+	float maxDifference = 0.0f;
+	for (int b = 0; b < numBones; b++)
+	{
+		maxDifference = glm::max(maxDifference, glm::distance(glm::vec3(palette[b][3]), ew::getDualQuatTranslation(dualQuatPalette[b])));
+	}
+	printf("%d bones: mat4 palette %.2f us (64 bytes/bone), dual quat palette %.2f us (32 bytes/bone)\n", numBones,
+		linearTime * 1000000.0 / iterations, dualQuatTime * 1000000.0 / iterations);
+	printf("Max bone position difference: %g\n", maxDifference);
+	return maxDifference < tolerance * numBones;
+}
+
+//Loads the crowd clips of assignment0 into one library and reports what is shared.
+//Each clip, copied back out with makePackage, must match a direct import of its file.
+bool runAnimationLibraryCheck() {
+	const char* files[2] = { "assets/Dancing.dae", "assets/WalkingAnim.fbx" };
+	const char* clipNames[2] = { "Dancing", "WalkingAnim" };
+	ew::AnimationLibrary animationLibrary;
+	bool passed = true;
+	double startTime = glfwGetTime();
+	for (const char* file : files)
+	{
+		passed &= animationLibrary.loadFile(file) > 0;
+	}
+	const double loadTime = glfwGetTime() - startTime;
+	printf("%zu clips, %zu skeletons, %zu channels (%zu shared), loaded in %.2f ms\n", animationLibrary.getNumClips(),
+		animationLibrary.getNumSkeletons(), animationLibrary.getNumChannels(), animationLibrary.getNumSharedChannels(), loadTime * 1000.0);
+	for (int i = 0; i < 2 && passed; i++)
+	{
+		int clipIndex = animationLibrary.findClip(clipNames[i]);
+		if (clipIndex == -1) {
+			printf("No clip named %s\n", clipNames[i]);
+			passed = false;
+			continue;
+		}
+		const bool matches = packagesMatch(ew::loadAnimationFromFile(files[i]), animationLibrary.makePackage(clipIndex));
+		printf("%s: matches direct import: %s\n", clipNames[i], matches ? "yes" : "NO");
+		passed &= matches;
+	}
+	return passed;
+}
+
+//Imports a generated rig of 100 chains of 100 nodes. The first 80 nodes of each chain skin a mesh,
+//the rest are helpers that should be left out of the skeleton.
+bool runSkeletonImportBenchmark() {
+	const int numChains = 100;
+	const int chainLength = 100;
+	const int numSkinnedPerChain = 80;
+	aiScene scene;
+	scene.mRootNode = new aiNode("Root");
+	scene.mRootNode->mNumChildren = numChains;
+	scene.mRootNode->mChildren = new aiNode * [numChains];
+	aiMesh* mesh = new aiMesh();
+	mesh->mNumBones = numChains * numSkinnedPerChain;
+	mesh->mBones = new aiBone * [mesh->mNumBones];
+	scene.mNumMeshes = 1;
+	scene.mMeshes = new aiMesh * [1]{ mesh };
+	for (int c = 0; c < numChains; c++)
+	{
+		aiNode* parent = scene.mRootNode;
+		aiNode** slot = &scene.mRootNode->mChildren[c];
+		for (int i = 0; i < chainLength; i++)
+		{
+			aiNode* node = new aiNode("Chain" + std::to_string(c) + "_" + std::to_string(i));
+			node->mParent = parent;
+			node->mTransformation.b4 = 0.1f;
+			*slot = node;
+			if (i < numSkinnedPerChain) {
+				aiBone* bone = new aiBone();
+				bone->mName = node->mName;
+				mesh->mBones[c * numSkinnedPerChain + i] = bone;
+			}
+			if (i + 1 < chainLength) {
+				node->mNumChildren = 1;
+				node->mChildren = new aiNode * [1];
+				slot = &node->mChildren[0];
+			}
+			parent = node;
+		}
+	}
+	double startTime = glfwGetTime();
+	ew::Skeleton skeleton = ew::loadSkeleton(&scene);
+	const double importTime = glfwGetTime() - startTime;
+	//Skinned nodes plus their only unskinned ancestor, the root
+	const int expectedBones = numChains * numSkinnedPerChain + 1;
+	printf("%d nodes -> %d bones (expected %d), loadSkeleton %.2f ms\n", 1 + numChains * chainLength,
+		(int)skeleton.bones.size(), expectedBones, importTime * 1000.0);
+	return (int)skeleton.bones.size() == expectedBones;
+}
+
+//Walking.dae through the animation cache, the clip assignment0 plays.
+//Falls back to a synthetic rig of the same size when it can't be imported.
+ew::AnimatedSkeletonPackage loadWalkingPackage() {
+	ew::AnimatedSkeletonPackage package = ew::loadAnimationFromFileCached("assets/Walking.dae");
+	if (package.skeleton.bones.empty()) {
+		printf("Using a synthetic 65 bone rig instead of assets/Walking.dae\n");
+		package = makeSyntheticPackage(65, 30);
+	}
+	return package;
+}
+
+//Marks the last bones dirty each solve, like a head-look or aim offset would.
+//Skeletons are in depth-first order, so these are whole subtrees and nothing else needs solving.
+//solveFK as it was before it wrote by index and skipped the affine bottom row
+static void solveFKReference(const ew::Skeleton& skeleton, std::vector<glm::mat4>& worldMatrices) {
+	worldMatrices.clear();
+	for (const ew::Bone& bone : skeleton.bones)
+	{
+		worldMatrices.emplace_back(bone.parentIndex == -1 ? bone.localTransform : worldMatrices[bone.parentIndex] * bone.localTransform);
+	}
+}
+
+//solveFK against the emplace_back + full mat4 multiply version on synthetic rigs with random affine local transforms
+bool runFKBenchmark() {
+	const int NUM_RIGS = 4;
+	const int rigSizes[NUM_RIGS] = { 60, 120, 250, 500 };
+	const int iterations = 20000;
+	const float tolerance = 1e-4f;
+	bool allMatch = true;
+	for (int r = 0; r < NUM_RIGS; r++)
+	{
+		ew::Skeleton skeleton = makeSyntheticPackage(rigSizes[r], 2).skeleton;
+		for (ew::Bone& bone : skeleton.bones)
+		{
+			glm::quat rotation = glm::normalize(glm::quat(randomRange(0.5f, 1), randomRange(-0.5f, 0.5f), randomRange(-0.5f, 0.5f), randomRange(-0.5f, 0.5f)));
+			bone.localTransform = glm::translate(glm::mat4(1), glm::vec3(randomRange(-1, 1), randomRange(-1, 1), randomRange(-1, 1)))
+				* glm::mat4_cast(rotation) * glm::scale(glm::mat4(1), glm::vec3(randomRange(0.9f, 1.1f)));
+		}
+		std::vector<glm::mat4> referenceMatrices, worldMatrices;
+		double startTime = glfwGetTime();
+		for (int i = 0; i < iterations; i++)
+			solveFKReference(skeleton, referenceMatrices);
+		const double referenceTime = glfwGetTime() - startTime;
+		startTime = glfwGetTime();
+		for (int i = 0; i < iterations; i++)
+			ew::solveFK(skeleton, worldMatrices);
+		const double solveTime = glfwGetTime() - startTime;
+
+		float maxDifference = 0;
+		for (int b = 0; b < rigSizes[r]; b++)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				for (int k = 0; k < 4; k++)
+				{
+					maxDifference = std::max(maxDifference, fabsf(worldMatrices[b][c][k] - referenceMatrices[b][c][k]));
+				}
+			}
+		}
+		allMatch &= maxDifference <= tolerance;
+		const double toNsPerBone = 1000000000.0 / ((double)iterations * rigSizes[r]);
+		printf("%3d bones: reference %.1f ns/bone, solveFK %.1f ns/bone, max difference %g\n",
+			rigSizes[r], referenceTime * toNsPerBone, solveTime * toNsPerBone, maxDifference);
+	}
+	printf("Matches reference: %s\n", allMatch ? "yes" : "NO");
+	return allMatch;
+}
+
+bool runIncrementalFKBenchmark() {
+	const int NUM_DIRTY_FRACTIONS = 6;
+	const float dirtyFractions[NUM_DIRTY_FRACTIONS] = { 0.0f, 0.02f, 0.1f, 0.25f, 0.5f, 1.0f };
+	const int iterations = 10000;
+	ew::Skeleton skeleton = loadWalkingPackage().skeleton;
+	const int numBones = (int)skeleton.bones.size();
+	std::vector<glm::mat4> fullWorldMatrices, worldMatrices;
+	double startTime = glfwGetTime();
+	for (int i = 0; i < iterations; i++)
+		ew::solveFK(skeleton, fullWorldMatrices);
+	printf("%d bones, solveFK: %.2f us\n", numBones, (glfwGetTime() - startTime) * 1000000.0 / iterations);
+	bool matchesFull = true;
+	//Every dirty range below includes this bone, so descendants must follow a dirty parent.
+	//Skips the root so small fractions don't dirty the whole rig.
+	int lastParent = 0;
+	for (int b = numBones - 1; b >= 0; b--)
+	{
+		const int parent = skeleton.bones[b].parentIndex;
+		if (parent != -1 && skeleton.bones[parent].parentIndex != -1) {
+			lastParent = parent;
+			break;
+		}
+	}
+	const glm::mat4 wiggle = glm::mat4_cast(glm::angleAxis(0.3f, glm::vec3(0, 0, 1)));
+
+	for (int f = 0; f < NUM_DIRTY_FRACTIONS; f++)
+	{
+		const int numDirty = (int)(dirtyFractions[f] * numBones);
+		const int firstDirty = std::min(numBones - numDirty, lastParent);
+		//Two poses per dirty bone, alternated every iteration so each solve sees new local transforms.
+		//Ends on the wiggled pose, so stale descendants can't match solveFK by landing back on the starting pose.
+		std::vector<glm::mat4> poses[2];
+		for (int b = firstDirty; b < firstDirty + numDirty; b++)
+		{
+			poses[0].push_back(skeleton.bones[b].localTransform);
+			poses[1].push_back(skeleton.bones[b].localTransform * wiggle);
+		}
+		ew::solveFKIncremental(&skeleton, worldMatrices);
+		startTime = glfwGetTime();
+		for (int i = 0; i < iterations; i++)
+		{
+			const std::vector<glm::mat4>& pose = poses[(iterations - i) & 1];
+			for (int d = 0; d < numDirty; d++)
+			{
+				ew::setLocalTransform(&skeleton, firstDirty + d, pose[d]);
+			}
+			ew::solveFKIncremental(&skeleton, worldMatrices);
+		}
+		const double incrementalTime = glfwGetTime() - startTime;
+		ew::solveFK(skeleton, fullWorldMatrices);
+		matchesFull &= memcmp(worldMatrices.data(), fullWorldMatrices.data(), sizeof(glm::mat4) * numBones) == 0;
+
+		//Dirty bones plus their descendants
+		int recomputed = 0;
+		std::vector<bool> dirty(numBones);
+		for (int b = 0; b < numBones; b++)
+		{
+			int parent = skeleton.bones[b].parentIndex;
+			dirty[b] = (b >= firstDirty && b < firstDirty + numDirty) || (parent != -1 && dirty[parent]);
+			recomputed += dirty[b];
+		}
+		printf("%3.0f%% dirty (%d solved): %.2f us\n", dirtyFractions[f] * 100.0f, recomputed, incrementalTime * 1000000.0 / iterations);
+	}
+	printf("Matches solveFK: %s\n", matchesFull ? "yes" : "NO");
+	return matchesFull;
+}
+
+//Crossfades the clip with itself half a cycle later, layers it over the upper body, and adds it as an additive pose.
+//samplePose followed by applyPose must give the local transforms updateSkeleton does.
+bool runPoseBlendBenchmark() {
+	const int iterations = 10000;
+	const float tolerance = 1e-4f;
+	ew::AnimatedSkeletonPackage package = loadWalkingPackage();
+	ew::Skeleton skeleton = package.skeleton;
+	ew::PoseBuffer poseA, poseB, additive, out;
+	ew::loadPoseFromSkeleton(skeleton, &poseA);
+	ew::loadPoseFromSkeleton(skeleton, &poseB);
+	int spine = ew::findBoneIndex(skeleton, "mixamorig:Spine");
+	ew::BoneMask upperBody = ew::makeBoneMask(skeleton, spine == -1 ? 0 : spine);
+	printf("%d bones\n", (int)skeleton.bones.size());
+
+	//mat4 path, for comparison with samplePose + applyPose
+	double startTime = glfwGetTime();
+	for (int i = 0; i < iterations; i++)
+		ew::updateSkeleton(&skeleton, &package.animationClip, package.binding, (float)i / iterations);
+	printf("updateSkeleton: %.2f us\n", (glfwGetTime() - startTime) * 1000000.0 / iterations);
+	startTime = glfwGetTime();
+	for (int i = 0; i < iterations; i++)
+		ew::samplePose(&package.animationClip, package.binding, (float)i / iterations, &poseA);
+	printf("samplePose: %.2f us\n", (glfwGetTime() - startTime) * 1000000.0 / iterations);
+	ew::Skeleton sampledSkeleton = package.skeleton;
+	ew::applyPose(poseA, &sampledSkeleton);
+	const float maxDifference = maxLocalTransformDifference(skeleton, sampledSkeleton);
+	ew::samplePose(&package.animationClip, package.binding, 0.5f, &poseB);
+
+	startTime = glfwGetTime();
+	for (int i = 0; i < iterations; i++)
+		ew::blendPoses(poseA, poseB, (float)i / iterations, &out);
+	printf("blendPoses: %.2f us\n", (glfwGetTime() - startTime) * 1000000.0 / iterations);
+	startTime = glfwGetTime();
+	for (int i = 0; i < iterations; i++)
+		ew::blendPosesMasked(poseA, poseB, upperBody, (float)i / iterations, &out);
+	printf("blendPosesMasked: %.2f us\n", (glfwGetTime() - startTime) * 1000000.0 / iterations);
+	ew::makeAdditivePose(poseB, poseA, &additive);
+	startTime = glfwGetTime();
+	for (int i = 0; i < iterations; i++)
+		ew::addPose(poseA, additive, (float)i / iterations, &out);
+	printf("addPose: %.2f us\n", (glfwGetTime() - startTime) * 1000000.0 / iterations);
+	startTime = glfwGetTime();
+	for (int i = 0; i < iterations; i++)
+		ew::applyPose(out, &skeleton);
+	printf("applyPose: %.2f us\n", (glfwGetTime() - startTime) * 1000000.0 / iterations);
+	printf("samplePose + applyPose against updateSkeleton, max difference: %g\n", maxDifference);
+	return maxDifference < tolerance;
+}
+
+//Both legs of a character. The synthetic rig has no legs, so two of its branches stand in.
+//Bones past the foot are there for the 4 bone FABRIK chains.
+static bool findLegChains(const ew::Skeleton& skeleton, int numBones, ew::IKChain chains[2]) {
+	const char* legs[2][4] = { { "mixamorig:LeftUpLeg", "mixamorig:LeftLeg", "mixamorig:LeftFoot", "mixamorig:LeftToeBase" },
+		{ "mixamorig:RightUpLeg", "mixamorig:RightLeg", "mixamorig:RightFoot", "mixamorig:RightToeBase" } };
+	const char* branches[2][4] = { { "bone8", "bone9", "bone10", "bone11" }, { "bone16", "bone17", "bone18", "bone19" } };
+	const bool mixamo = ew::findBoneIndex(skeleton, legs[0][0]) != -1;
+	for (int l = 0; l < 2; l++)
+	{
+		chains[l].bones.clear();
+		for (int b = 0; b < numBones; b++)
+		{
+			const char* name = mixamo ? legs[l][b] : branches[l][b];
+			int bone = ew::findBoneIndex(skeleton, name);
+			if (bone == -1) {
+				printf("Skeleton has no bone %s\n", name);
+				return false;
+			}
+			chains[l].bones.push_back(bone);
+		}
+	}
+	return true;
+}
+
+//Copies of a posed skeleton, each with a target its chains can reach: where the end effector goes
+//when the second bone of the chain is bent by a different angle.
+static void makeReachableIKTasks(const ew::Skeleton& skeleton, const ew::IKChain* chains, int numChains, int numCharacters,
+	std::vector<ew::Skeleton>* skeletons, std::vector<std::vector<glm::mat4>>* worldMatrices, std::vector<ew::IKTask>* tasks) {
+	skeletons->assign(numCharacters, skeleton);
+	worldMatrices->assign(numCharacters, std::vector<glm::mat4>());
+	tasks->clear();
+	std::vector<glm::mat4> bentMatrices;
+	for (int c = 0; c < numCharacters; c++)
+	{
+		ew::solveFK((*skeletons)[c], (*worldMatrices)[c]);
+		for (int l = 0; l < numChains; l++)
+		{
+			const ew::IKChain& chain = chains[l];
+			ew::Skeleton bent = skeleton;
+			glm::mat4& mid = bent.bones[chain.bones[1]].localTransform;
+			mid = mid * glm::toMat4(glm::angleAxis(0.2f + 0.05f * (c % 16), glm::vec3(1, 0, 0)));
+			ew::solveFK(bent, bentMatrices);
+			ew::IKTask task;
+			task.skeleton = &(*skeletons)[c];
+			task.worldMatrices = &(*worldMatrices)[c];
+			task.chain = &chain;
+			task.target = glm::vec3(bentMatrices[chain.bones.back()][3]);
+			task.pole = glm::vec3(0, 0, 1);
+			tasks->push_back(task);
+		}
+	}
+}
+
+//Largest distance from an end effector to its target, relative to the length of its chain, after solveFK
+static float maxRelativeIKError(const std::vector<ew::IKTask>& tasks) {
+	float maxError = 0.0f;
+	std::vector<glm::mat4> worldMatrices;
+	const ew::Skeleton* solved = nullptr;
+	for (const ew::IKTask& task : tasks)
+	{
+		if (task.skeleton != solved) {
+			ew::solveFK(*task.skeleton, worldMatrices);
+			solved = task.skeleton;
+		}
+		const std::vector<int>& bones = task.chain->bones;
+		float length = 0.0f;
+		for (size_t b = 1; b < bones.size(); b++)
+		{
+			length += glm::distance(glm::vec3(worldMatrices[bones[b]][3]), glm::vec3(worldMatrices[bones[b - 1]][3]));
+		}
+		float error = glm::distance(glm::vec3(worldMatrices[bones.back()][3]), task.target);
+		maxError = glm::max(maxError, error / glm::max(length, 1e-6f));
+	}
+	return maxError;
+}
+
+//Foot placement on both legs of many copies of the character, in chains solved per millisecond.
+//Every target is reachable, so the solved end effectors must land on them. The FABRIK pass mixes
+//3 and 4 bone chains in one call.
+bool runIKBenchmark() {
+	const int numCharacters = 512;
+	const int iterations = 20;
+	const float tolerance = 0.01f;
+	ew::AnimatedSkeletonPackage package = loadWalkingPackage();
+	ew::Skeleton skeleton = package.skeleton;
+	ew::updateSkeleton(&skeleton, &package.animationClip, package.binding, 0.25f);
+	ew::IKChain chains[4];
+	if (!findLegChains(skeleton, 3, &chains[0]) || !findLegChains(skeleton, 4, &chains[2]))
+		return false;
+	std::vector<ew::Skeleton> skeletons;
+	std::vector<std::vector<glm::mat4>> worldMatrices;
+	std::vector<ew::IKTask> tasks;
+	ew::IKBatch batch;
+
+	makeReachableIKTasks(skeleton, chains, 2, numCharacters, &skeletons, &worldMatrices, &tasks);
+	const double numSolved = (double)tasks.size() * iterations;
+	double startTime = glfwGetTime();
+	for (int i = 0; i < iterations; i++)
+	{
+		for (const ew::IKTask& task : tasks)
+			ew::solveTwoBoneIK(task, &batch);
+	}
+	printf("%d leg chains\n", (int)tasks.size());
+	printf("Two-bone: %.0f chains/ms\n", numSolved / ((glfwGetTime() - startTime) * 1000.0));
+	const float singleError = maxRelativeIKError(tasks);
+
+	makeReachableIKTasks(skeleton, chains, 2, numCharacters, &skeletons, &worldMatrices, &tasks);
+	startTime = glfwGetTime();
+	for (int i = 0; i < iterations; i++)
+		ew::solveTwoBoneIKBatch(tasks.data(), tasks.size(), &batch);
+	printf("Two-bone batch: %.0f chains/ms\n", numSolved / ((glfwGetTime() - startTime) * 1000.0));
+	const float batchError = maxRelativeIKError(tasks);
+
+	//Left leg as 3 bones, right leg as 4. Sorted by length so each length is one batch.
+	const ew::IKChain mixedChains[2] = { chains[0], chains[3] };
+	makeReachableIKTasks(skeleton, mixedChains, 2, numCharacters, &skeletons, &worldMatrices, &tasks);
+	std::stable_sort(tasks.begin(), tasks.end(), [](const ew::IKTask& a, const ew::IKTask& b) {
+		return a.chain->bones.size() < b.chain->bones.size();
+	});
+	ew::FABRIKSettings settings;
+	settings.tolerance = 0.0001f * glm::distance(glm::vec3(worldMatrices[0][chains[0].bones[0]][3]), glm::vec3(worldMatrices[0][chains[0].bones[1]][3]));
+	startTime = glfwGetTime();
+	for (int i = 0; i < iterations; i++)
+		ew::solveFABRIKBatch(tasks.data(), tasks.size(), &batch, settings);
+	printf("FABRIK batch, 3 and 4 bone chains: %.0f chains/ms\n", numSolved / ((glfwGetTime() - startTime) * 1000.0));
+	const float fabrikError = maxRelativeIKError(tasks);
+
+	printf("Max end effector distance from target, relative to chain length: two-bone %g, two-bone batch %g, FABRIK %g\n",
+		singleError, batchError, fabrikError);
+	return singleError < tolerance && batchError < tolerance && fabrikError < tolerance;
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <ew/animation.h>
+#include <ew/mesh.h>
+
+//Each benchmark prints its results and returns false if a correctness check made along the way failed.
+//Times are from glfwGetTime. Benchmarks that draw run on the hidden window's context.
+typedef bool (*BenchmarkFunction)();
+struct Benchmark {
+	const char* name;
+	const char* description;
+	BenchmarkFunction run;
+};
+
+//Rigs shared between benchmarks, in animationBenchmarks.cpp
+ew::AnimatedSkeletonPackage makeSyntheticPackage(int numBones, int numKeys);
+ew::AnimatedSkeletonPackage loadWalkingPackage();
+
+//Transform feedback capture of GPU results, in skinningBenchmarks.cpp
+//Links a vertex shader alone, capturing one vec3 output. 0 if it fails to compile or link.
+unsigned int createCaptureProgram(const char* vertexShaderPath, const char* capturedVarying);
+//Draws every vertex of mesh as a point, instanceCount times, and reads back the captured vec3 of each
+std::vector<glm::vec3> capturePoints(const ew::Mesh& mesh, int instanceCount);
+//Uses program, with identity _Model and _ViewProjection
+void setCaptureUniforms(unsigned int program);
+
+//Animation
+bool runKeyFrameSearchBenchmark();
+bool runSkeletonImportBenchmark();
+bool runFKBenchmark();
+bool runIncrementalFKBenchmark();
+bool runPoseBlendBenchmark();
+bool runBatchSamplingBenchmark();
+bool runAnimationCacheBenchmark();
+bool runAnimationLibraryCheck();
+bool runIKBenchmark();
+
+//Skinning
+bool runGPUSkinningCheck();
+bool runCPUSkinningBenchmark();
+bool runPaletteBenchmark();
+bool runVATCheck();
+
+//Mesh
+bool runMorphBenchmark();
+bool runVertexFormatBenchmark();
+bool runMeshOptimizationBenchmark();
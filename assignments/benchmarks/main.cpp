@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <ew/external/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "benchmarks.h"
+
+//Run in this order when none are named on the command line
+const Benchmark benchmarks[] = {
+	{ "keyframes", "Cursor keyframe search against binary search and a linear scan", runKeyFrameSearchBenchmark },
+	{ "skeletonImport", "loadSkeleton on a generated 10k node rig", runSkeletonImportBenchmark },
+	{ "fk", "solveFK on 60, 120, 250 and 500 bone rigs against the previous implementation", runFKBenchmark },
+	{ "incrementalFK", "solveFKIncremental with a growing fraction of dirty bones", runIncrementalFKBenchmark },
+	{ "poseBlend", "Pose buffer sampling, blending and layering on Walking.dae", runPoseBlendBenchmark },
+	{ "batchSampling", "Batch clip sampling against per-instance updateSkeleton, directly and through AnimationWorld", runBatchSamplingBenchmark },
+	{ "animationCache", "Assimp import against the binary animation cache", runAnimationCacheBenchmark },
+	{ "animationLibrary", "Channel and skeleton sharing of the crowd clips in an AnimationLibrary", runAnimationLibraryCheck },
+	{ "ik", "Two-bone and FABRIK foot placement on 512 characters, single and batched", runIKBenchmark },
+	{ "gpuSkinning", "skinned.vert output, captured with transform feedback, against the CPU reference", runGPUSkinningCheck },
+	{ "cpuSkinning", "Scalar, SIMD and threaded CPU skinning", runCPUSkinningBenchmark },
+	{ "palettes", "mat4 against dual quaternion skinning palettes, from clip sampling on", runPaletteBenchmark },
+	{ "vat", "vat.vert output, captured with transform feedback, against skinMesh of the baked frames", runVATCheck },
+	{ "morph", "Sparse morph target evaluation against dense deltas", runMorphBenchmark },
+	{ "vertexFormat", "Draw time and decode error of the packed vertex formats", runVertexFormatBenchmark },
+	{ "meshOptimization", "optimizeMesh on generated meshes, and the reports of the imported models", runMeshOptimizationBenchmark },
+};
+const int NUM_BENCHMARKS = sizeof(benchmarks) / sizeof(benchmarks[0]);
+
+GLFWwindow* initHiddenWindow();
+
+/// <summary>
+/// Runs the named benchmarks, or all of them. "list" prints their names.
+/// Exits with 1 if any correctness check failed.
+/// Needs a GL context for the GPU benchmarks. Headless, run it under xvfb-run with LIBGL_ALWAYS_SOFTWARE=1 for llvmpipe.
+/// </summary>
+int main(int argc, char** argv) {
+	if (argc > 1 && strcmp(argv[1], "list") == 0) {
+		for (int i = 0; i < NUM_BENCHMARKS; i++)
+		{
+			printf("%-20s %s\n", benchmarks[i].name, benchmarks[i].description);
+		}
+		return 0;
+	}
+	GLFWwindow* window = initHiddenWindow();
+	if (window == nullptr)
+		return 1;
+	printf("Renderer: %s\n", (const char*)glGetString(GL_RENDERER));
+
+	bool passed = true;
+	int numRun = 0;
+	for (int i = 0; i < NUM_BENCHMARKS; i++)
+	{
+		bool selected = argc <= 1;
+		for (int a = 1; a < argc; a++)
+		{
+			selected |= strcmp(argv[a], benchmarks[i].name) == 0;
+		}
+		if (!selected)
+			continue;
+		printf("\n== %s ==\n", benchmarks[i].name);
+		if (!benchmarks[i].run()) {
+			printf("FAILED: %s\n", benchmarks[i].name);
+			passed = false;
+		}
+		numRun++;
+	}
+	if (numRun == 0) {
+		printf("No benchmark matches. Run with \"list\" to see them.\n");
+	}
+	glfwDestroyWindow(window);
+	glfwTerminate();
+	return passed ? 0 : 1;
+}
+
+//Benchmarks never present, but GL calls need a current context
+GLFWwindow* initHiddenWindow() {
+	if (!glfwInit()) {
+		printf("GLFW failed to init!\n");
+		return nullptr;
+	}
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	GLFWwindow* window = glfwCreateWindow(256, 256, "Benchmarks", NULL, NULL);
+	if (window == NULL) {
+		printf("GLFW failed to create window\n");
+		return nullptr;
+	}
+	glfwMakeContextCurrent(window);
+	if (!gladLoadGL(glfwGetProcAddress)) {
+		printf("GLAD Failed to load GL headers\n");
+		return nullptr;
+	}
+	return window;
+}
@@ -0,0 +1,278 @@
+#include <stdio.h>
+#include <math.h>
+#include <string>
+#include <array>
+#include <algorithm>
+
+#include <ew/external/glad.h>
+#include <GLFW/glfw3.h>
+#include <ew/procGen.h>
+#include <ew/morphTargets.h>
+#include <ew/model.h>
+#include <ew/shader.h>
+#include <ew/camera.h>
+#include <ew/vertexPacking.h>
+#include <ew/meshOptimizer.h>
+
+#include "benchmarks.h"
+
+//64 blend shapes on a dense sphere, each pushing out a small cap, with 8 active at a time.
+//Sparse evaluation against a full vertex copy plus dense deltas per active target, which it must match,
+//and against itself on a 4 thread pool.
+bool runMorphBenchmark() {
+	const int numTargets = 64;
+	const int numActive = 8;
+	const int iterations = 20;
+	const float tolerance = 1e-4f;
+	ew::MorphTargetSet targetSet;
+	targetSet.baseVertices = ew::createSphere(1.0f, 512).vertices;
+	const size_t numVertices = targetSet.baseVertices.size();
+	std::vector<glm::vec3> targetPositions(numVertices);
+	for (int t = 0; t < numTargets; t++)
+	{
+		const float theta = t * 2.39996f; //Golden angle spreads the caps over the sphere
+		const float y = 1.0f - 2.0f * (t + 0.5f) / numTargets;
+		const glm::vec3 capCenter = glm::vec3(cosf(theta) * sqrtf(1.0f - y * y), y, sinf(theta) * sqrtf(1.0f - y * y));
+		for (size_t i = 0; i < numVertices; i++)
+		{
+			const ew::Vertex& vertex = targetSet.baseVertices[i];
+			const float falloff = glm::max(glm::dot(vertex.normal, capCenter) - 0.95f, 0.0f) / 0.05f;
+			targetPositions[i] = vertex.pos + vertex.normal * (0.1f * falloff);
+		}
+		targetSet.targets.push_back(ew::makeMorphTarget("Cap" + std::to_string(t), targetSet.baseVertices, targetPositions.data(), nullptr));
+	}
+
+	std::vector<float> weights(numTargets, 0.0f);
+	ew::MorphState state;
+	ew::initMorphState(targetSet, &state);
+	double startTime = glfwGetTime();
+	for (int i = 0; i < iterations; i++)
+	{
+		//A different set of targets each iteration, so the previous one has to be undone
+		weights.assign(numTargets, 0.0f);
+		for (int j = 0; j < numActive; j++)
+			weights[(i * 5 + j * 7) % numTargets] = 0.5f + 0.05f * j;
+		ew::evaluateMorphTargets(targetSet, weights.data(), &state);
+	}
+	const double sparseTime = glfwGetTime() - startTime;
+
+	//Same weights on a 4 thread pool. Each thread owns its vertices, so the result must not change.
+	ew::WorkerPool pool(4);
+	ew::MorphState pooledState;
+	startTime = glfwGetTime();
+	for (int i = 0; i < iterations; i++)
+		ew::evaluateMorphTargets(targetSet, weights.data(), &pooledState, &pool);
+	const double pooledTime = glfwGetTime() - startTime;
+	bool pooledMatches = true;
+	for (size_t v = 0; v < numVertices; v++)
+		pooledMatches &= pooledState.vertices[v].pos == state.vertices[v].pos;
+
+	//Dense evaluation of the last iteration's weights
+	std::vector<std::vector<glm::vec3>> denseDeltas;
+	std::vector<float> denseWeights;
+	for (int t = 0; t < numTargets; t++)
+	{
+		if (weights[t] == 0.0f)
+			continue;
+		const ew::MorphTarget& target = targetSet.targets[t];
+		denseDeltas.emplace_back(numVertices, glm::vec3(0));
+		for (size_t i = 0; i < target.indices.size(); i++)
+			denseDeltas.back()[target.indices[i]] = target.positionDeltas[i];
+		denseWeights.push_back(weights[t]);
+	}
+	std::vector<glm::vec3> densePositions(numVertices);
+	startTime = glfwGetTime();
+	for (int i = 0; i < iterations; i++)
+	{
+		for (size_t v = 0; v < numVertices; v++)
+			densePositions[v] = targetSet.baseVertices[v].pos;
+		for (size_t t = 0; t < denseDeltas.size(); t++)
+		{
+			for (size_t v = 0; v < numVertices; v++)
+				densePositions[v] += denseDeltas[t][v] * denseWeights[t];
+		}
+	}
+	const double denseTime = glfwGetTime() - startTime;
+
+	float maxError = 0;
+	for (size_t v = 0; v < numVertices; v++)
+		maxError = glm::max(maxError, glm::length(densePositions[v] - state.vertices[v].pos));
+	printf("%zu vertices, %d targets, %d active, %zu active deltas\n", numVertices, numTargets, numActive, state.activeDeltas);
+	printf("Sparse: %.0f us, on %d threads: %.0f us, dense: %.0f us\n", sparseTime * 1000000.0 / iterations,
+		pool.getNumThreads(), pooledTime * 1000000.0 / iterations, denseTime * 1000000.0 / iterations);
+	printf("Max difference from dense: %g, threaded matches: %s\n", maxError, pooledMatches ? "yes" : "NO");
+	return maxError < tolerance && pooledMatches;
+}
+
+static const char* VERTEX_FORMAT_NAMES[3] = { "Full", "Packed", "Packed + Quantized" };
+
+static size_t getVertexBytes(ew::Model& model) {
+	size_t bytes = 0;
+	for (int i = 0; i < model.getNumMeshes(); i++)
+		bytes += (size_t)model.getMesh(i).getVertexLayout().stride * model.getMesh(i).getNumVertices();
+	return bytes;
+}
+
+//Draws Suzanne and a dense plane in each vertex format, timing vertex fetch with glFinish around the draws.
+//Over a unit sphere, which covers every normal direction, it then measures the encoding error on the CPU
+//and checks litPacked.vert decodes positions to within it of what lit.vert gives for the float mesh.
+bool runVertexFormatBenchmark() {
+	const int draws = 200;
+	ew::Shader shader = ew::Shader("assets/lit.vert", "assets/lit.frag");
+	ew::Shader packedShader = ew::Shader("assets/litPacked.vert", "assets/lit.frag");
+	ew::Model monkeys[3];
+	ew::Mesh planes[3];
+	const ew::MeshData planeData = ew::createPlane(10.0f, 10.0f, 256);
+	for (int i = 0; i < 3; i++)
+	{
+		monkeys[i] = ew::Model("assets/Suzanne.obj", (ew::VertexFormat)i);
+		planes[i].load(planeData, (ew::VertexFormat)i);
+	}
+	ew::Camera camera;
+	camera.position = glm::vec3(0.0f, 6.0f, 10.0f);
+	camera.aspectRatio = 1.0f;
+	const glm::mat4 planeTransform = glm::translate(glm::mat4(1.0f), glm::vec3(-5.0f, -1.5f, -5.0f));
+	glEnable(GL_DEPTH_TEST);
+
+	const char* objectNames[2] = { "Suzanne", "Plane" };
+	for (int object = 0; object < 2; object++)
+	{
+		if (object == 0 && monkeys[0].getNumMeshes() == 0) {
+			printf("Skipping Suzanne, assets/Suzanne.obj did not load\n");
+			continue;
+		}
+		for (int format = 0; format < 3; format++)
+		{
+			ew::Shader& formatShader = format == 0 ? shader : packedShader;
+			formatShader.use();
+			formatShader.setMat4("_ViewProjection", camera.projectionMatrix() * camera.viewMatrix());
+			const ew::PositionQuantization& quantization = object == 0 ? monkeys[format].getPositionQuantization() : planes[format].getPositionQuantization();
+			formatShader.setVec3("_PositionOffset", quantization.offset);
+			formatShader.setVec3("_PositionScale", quantization.scale);
+			formatShader.setMat4("_Model", object == 0 ? glm::mat4(1.0f) : planeTransform);
+			const size_t bytes = object == 0 ? getVertexBytes(monkeys[format]) : (size_t)planes[format].getVertexLayout().stride * planes[format].getNumVertices();
+			const int stride = object == 0 ? monkeys[format].getMesh(0).getVertexLayout().stride : planes[format].getVertexLayout().stride;
+			//Warm up
+			object == 0 ? monkeys[format].draw() : planes[format].draw();
+			glFinish();
+			double startTime = glfwGetTime();
+			for (int i = 0; i < draws; i++)
+			{
+				object == 0 ? monkeys[format].draw() : planes[format].draw();
+			}
+			glFinish();
+			const double drawMilliseconds = (glfwGetTime() - startTime) * 1000.0 / draws;
+			//Vertex fetch bandwidth, ignoring the post transform cache
+			const double megabytes = bytes / (1024.0 * 1024.0);
+			printf("%s %s: %d B/vertex, %.2f MB, %.3f ms/draw, %.1f GB/s\n", objectNames[object], VERTEX_FORMAT_NAMES[format], stride,
+				megabytes, drawMilliseconds, megabytes / 1024.0 / (drawMilliseconds / 1000.0));
+		}
+	}
+	glDisable(GL_DEPTH_TEST);
+
+	//Encoding error on the CPU
+	ew::MeshData sphere = ew::createSphere(1.0f, 128);
+	ew::AABB bounds;
+	bounds.min = glm::vec3(-1.0f);
+	bounds.max = glm::vec3(1.0f);
+	const ew::PositionQuantization quantization = ew::makePositionQuantization(bounds);
+	const ew::VertexLayout layout = ew::getVertexLayout(ew::VertexFormat::PACKED_QUANTIZED, false);
+	std::vector<uint8_t> packed(layout.stride * sphere.vertices.size());
+	ew::packVertices(sphere.vertices.data(), 0, sphere.vertices.size(), layout, quantization, packed.data());
+	float maxPositionError = 0, maxNormalDegrees = 0, maxUVError = 0;
+	for (size_t i = 0; i < sphere.vertices.size(); i++)
+	{
+		const ew::Vertex& vertex = sphere.vertices[i];
+		const ew::Vertex unpacked = ew::unpackVertex(&packed[i * layout.stride], layout, quantization);
+		const float cosAngle = glm::clamp(glm::dot(glm::normalize(vertex.normal), unpacked.normal), -1.0f, 1.0f);
+		maxPositionError = glm::max(maxPositionError, glm::length(vertex.pos - unpacked.pos));
+		maxNormalDegrees = glm::max(maxNormalDegrees, glm::degrees(acosf(cosAngle)));
+		maxUVError = glm::max(maxUVError, glm::length(vertex.uv - unpacked.uv));
+	}
+	printf("Max encoding error: position %g, normal %.3f deg, uv %g\n", maxPositionError, maxNormalDegrees, maxUVError);
+
+	//Decoding on the GPU
+	unsigned int fullProgram = createCaptureProgram("assets/lit.vert", "Surface.WorldPos");
+	unsigned int packedProgram = createCaptureProgram("assets/litPacked.vert", "Surface.WorldPos");
+	if (fullProgram == 0 || packedProgram == 0)
+		return false;
+	ew::Mesh sphereMeshes[3];
+	std::vector<glm::vec3> positions[3];
+	for (int format = 0; format < 3; format++)
+	{
+		sphereMeshes[format].load(sphere, (ew::VertexFormat)format);
+		setCaptureUniforms(format == 0 ? fullProgram : packedProgram);
+		if (format > 0) {
+			const ew::PositionQuantization& meshQuantization = sphereMeshes[format].getPositionQuantization();
+			glUniform3fv(glGetUniformLocation(packedProgram, "_PositionOffset"), 1, &meshQuantization.offset[0]);
+			glUniform3fv(glGetUniformLocation(packedProgram, "_PositionScale"), 1, &meshQuantization.scale[0]);
+		}
+		positions[format] = capturePoints(sphereMeshes[format], 1);
+	}
+	bool passed = glGetError() == GL_NO_ERROR;
+	glDeleteProgram(fullProgram);
+	glDeleteProgram(packedProgram);
+	for (int format = 1; format < 3; format++)
+	{
+		float maxError = 0.0f;
+		for (size_t v = 0; v < positions[0].size(); v++)
+		{
+			maxError = glm::max(maxError, glm::distance(positions[format][v], positions[0][v]));
+		}
+		printf("litPacked.vert %s, max distance from lit.vert: %g\n", VERTEX_FORMAT_NAMES[format], maxError);
+		passed &= maxError <= maxPositionError * 1.5f + 1e-6f;
+	}
+	return passed;
+}
+
+//Every triangle as its corner positions, starting from the smallest corner so winding is kept, in sorted order
+static std::vector<std::array<float, 9>> getSortedTriangles(const ew::MeshData& meshData) {
+	std::vector<std::array<float, 9>> triangles(meshData.indices.size() / 3);
+	for (size_t t = 0; t < triangles.size(); t++)
+	{
+		std::array<float, 9> corners[3];
+		for (int r = 0; r < 3; r++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				const glm::vec3& pos = meshData.vertices[meshData.indices[t * 3 + (r + c) % 3]].pos;
+				corners[r][c * 3] = pos.x;
+				corners[r][c * 3 + 1] = pos.y;
+				corners[r][c * 3 + 2] = pos.z;
+			}
+		}
+		triangles[t] = *std::min_element(corners, corners + 3);
+	}
+	std::sort(triangles.begin(), triangles.end());
+	return triangles;
+}
+
+//Imported models are optimized on load. Generated meshes are not, so optimizeMesh runs on a sphere and a cylinder,
+//which must still draw the same triangles with the same winding afterwards.
+//Welding compares whole vertices including the unused bone fields, so its vertex counts are only
+//meaningful because procGen value-initializes every vertex.
+//Overdraw reordering trades some cache reuse, so ACMR may end up to overdrawThreshold above where it started,
+//as on the cylinder, whose generated order is already close to ideal.
+bool runMeshOptimizationBenchmark() {
+	ew::Model monkeyModel = ew::Model("assets/Suzanne.obj");
+	ew::Model characterModel = ew::Model("assets/Walking.dae");
+	if (monkeyModel.getNumMeshes() > 0)
+		ew::printMeshOptimizationReport("Suzanne", monkeyModel.getOptimizationReport());
+	if (characterModel.getNumMeshes() > 0)
+		ew::printMeshOptimizationReport("Walking", characterModel.getOptimizationReport());
+
+	const char* names[2] = { "Sphere", "Cylinder" };
+	ew::MeshData meshes[2] = { ew::createSphere(1.0f, 128), ew::createCylinder(1.0f, 2.0f, 128) };
+	bool passed = true;
+	for (int i = 0; i < 2; i++)
+	{
+		const std::vector<std::array<float, 9>> trianglesBefore = getSortedTriangles(meshes[i]);
+		const ew::MeshOptimizationSettings settings;
+		const ew::MeshOptimizationReport report = ew::optimizeMesh(&meshes[i], settings);
+		ew::printMeshOptimizationReport(names[i], report);
+		const bool sameTriangles = getSortedTriangles(meshes[i]) == trianglesBefore;
+		printf("%s draws the same triangles: %s\n", names[i], sameTriangles ? "yes" : "NO");
+		passed &= sameTriangles && report.acmrAfter <= report.acmrBefore * settings.overdrawThreshold;
+	}
+	return passed;
+}
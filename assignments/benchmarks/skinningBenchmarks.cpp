@@ -0,0 +1,285 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+
+#include <ew/external/glad.h>
+#include <GLFW/glfw3.h>
+#include <ew/shader.h>
+#include <ew/procGen.h>
+#include <ew/skinning.h>
+#include <ew/cpuSkinning.h>
+#include <ew/vertexAnimation.h>
+#include <ew/texture.h>
+
+#include "benchmarks.h"
+
+static float randomUnit() {
+	return rand() / (float)RAND_MAX;
+}
+
+//Sphere with 1 to 4 random weights per vertex over numBones bones. Every 16th vertex is left unweighted.
+static ew::MeshData makeSkinnedSphere(int numBones) {
+	ew::MeshData meshData = ew::createSphere(1.0f, 64);
+	for (size_t v = 0; v < meshData.vertices.size(); v++)
+	{
+		ew::Vertex& vertex = meshData.vertices[v];
+		const int numWeights = v % 16 == 0 ? 0 : 1 + rand() % MAX_BONE_WEIGHTS;
+		float weightSum = 0.0f;
+		for (int i = 0; i < MAX_BONE_WEIGHTS; i++)
+		{
+			vertex.boneIDs[i] = (unsigned short)(rand() % numBones);
+			vertex.boneWeights[i] = i < numWeights ? 0.1f + randomUnit() : 0.0f;
+			weightSum += vertex.boneWeights[i];
+		}
+		for (int i = 0; i < numWeights; i++)
+		{
+			vertex.boneWeights[i] /= weightSum;
+		}
+	}
+	return meshData;
+}
+
+//Rotation, translation and a little non-uniform scale, like a palette entry of an animated rig
+static glm::mat4 randomBoneMatrix() {
+	glm::quat rotation = glm::normalize(glm::quat(randomUnit() + 0.1f, randomUnit() - 0.5f, randomUnit() - 0.5f, randomUnit() - 0.5f));
+	glm::vec3 translation = glm::vec3(randomUnit(), randomUnit(), randomUnit()) * 4.0f - 2.0f;
+	glm::vec3 scale = glm::vec3(0.8f) + glm::vec3(randomUnit(), randomUnit(), randomUnit()) * 0.4f;
+	return glm::scale(glm::translate(glm::mat4(1), translation) * glm::toMat4(rotation), scale);
+}
+
+//ew::Shader links immediately, and the captured varyings must be set before linking
+unsigned int createCaptureProgram(const char* vertexShaderPath, const char* capturedVarying) {
+	std::string source = ew::loadShaderSourceFromFile(vertexShaderPath);
+	const char* sourceCode = source.c_str();
+	unsigned int shader = glCreateShader(GL_VERTEX_SHADER);
+	glShaderSource(shader, 1, &sourceCode, NULL);
+	glCompileShader(shader);
+	int success;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+	if (!success) {
+		char infoLog[512];
+		glGetShaderInfoLog(shader, 512, NULL, infoLog);
+		printf("Failed to compile %s: %s\n", vertexShaderPath, infoLog);
+		glDeleteShader(shader);
+		return 0;
+	}
+	unsigned int program = glCreateProgram();
+	glAttachShader(program, shader);
+	glTransformFeedbackVaryings(program, 1, &capturedVarying, GL_INTERLEAVED_ATTRIBS);
+	glLinkProgram(program);
+	glDeleteShader(shader);
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	if (!success) {
+		char infoLog[512];
+		glGetProgramInfoLog(program, 512, NULL, infoLog);
+		printf("Failed to link capture program: %s\n", infoLog);
+		glDeleteProgram(program);
+		return 0;
+	}
+	return program;
+}
+
+std::vector<glm::vec3> capturePoints(const ew::Mesh& mesh, int instanceCount) {
+	const size_t numPoints = (size_t)mesh.getNumVertices() * instanceCount;
+	unsigned int buffer;
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, buffer);
+	glBufferData(GL_TRANSFORM_FEEDBACK_BUFFER, numPoints * sizeof(glm::vec3), NULL, GL_STATIC_READ);
+	glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, buffer);
+	glEnable(GL_RASTERIZER_DISCARD);
+	glBeginTransformFeedback(GL_POINTS);
+	mesh.drawInstanced(ew::DrawMode::POINTS, instanceCount);
+	glEndTransformFeedback();
+	glDisable(GL_RASTERIZER_DISCARD);
+	std::vector<glm::vec3> points(numPoints);
+	glGetBufferSubData(GL_TRANSFORM_FEEDBACK_BUFFER, 0, numPoints * sizeof(glm::vec3), points.data());
+	glDeleteBuffers(1, &buffer);
+	return points;
+}
+
+void setCaptureUniforms(unsigned int program) {
+	glm::mat4 identity = glm::mat4(1);
+	glUseProgram(program);
+	glUniformMatrix4fv(glGetUniformLocation(program, "_Model"), 1, GL_FALSE, &identity[0][0]);
+	glUniformMatrix4fv(glGetUniformLocation(program, "_ViewProjection"), 1, GL_FALSE, &identity[0][0]);
+}
+
+//skinned.vert positions, captured with transform feedback, against skinVerticesReference.
+//Each instance reads its own palette, so a second instance checks the gl_InstanceID offset.
+bool runGPUSkinningCheck() {
+	const int numBones = 60;
+	const int numInstances = 2;
+	const float tolerance = 1e-4f;
+	unsigned int program = createCaptureProgram("assets/skinned.vert", "Surface.WorldPos");
+	if (program == 0)
+		return false;
+	ew::MeshData meshData = makeSkinnedSphere(numBones);
+	ew::Mesh mesh(meshData);
+	std::vector<glm::mat4> palettes(numBones * numInstances);
+	for (glm::mat4& m : palettes)
+	{
+		m = randomBoneMatrix();
+	}
+	ew::SkinningPaletteBuffer paletteBuffer;
+	paletteBuffer.upload(palettes.data(), numBones, numInstances);
+	paletteBuffer.bind();
+	setCaptureUniforms(program);
+	glUniform1i(glGetUniformLocation(program, "_NumBones"), numBones);
+	std::vector<glm::vec3> gpuPositions = capturePoints(mesh, numInstances);
+
+	const size_t numVertices = meshData.vertices.size();
+	std::vector<glm::vec3> cpuPositions(numVertices);
+	ew::SkinningOutput output;
+	output.positions = cpuPositions.data();
+	bool passed = glGetError() == GL_NO_ERROR;
+	for (int instance = 0; instance < numInstances; instance++)
+	{
+		ew::skinVerticesReference(meshData, &palettes[instance * numBones], 0, numVertices, output);
+		float maxError = 0.0f, maxUnweightedError = 0.0f;
+		for (size_t v = 0; v < numVertices; v++)
+		{
+			float error = glm::distance(gpuPositions[instance * numVertices + v], cpuPositions[v]);
+			maxError = glm::max(maxError, error);
+			if (v % 16 == 0) {
+				maxUnweightedError = glm::max(maxUnweightedError, error);
+			}
+		}
+		passed &= maxError < tolerance;
+		printf("Instance %d: %zu vertices, %d bones, max distance from skinVerticesReference %g (unweighted vertices %g)\n",
+			instance, numVertices, numBones, maxError, maxUnweightedError);
+	}
+	glDeleteProgram(program);
+	return passed;
+}
+
+//Skins a dense sphere with synthetic weights over a 64 bone palette, in millions of vertices per second.
+//The SIMD kernels must match the scalar reference bit for bit.
+bool runCPUSkinningBenchmark() {
+	const int numBones = 64;
+	const int iterations = 10;
+	ew::MeshData meshData = ew::createSphere(1.0f, 512);
+	for (size_t i = 0; i < meshData.vertices.size(); i++)
+	{
+		ew::Vertex& vertex = meshData.vertices[i];
+		for (int j = 0; j < MAX_BONE_WEIGHTS; j++)
+		{
+			vertex.boneIDs[j] = (unsigned short)((i * 7 + j * 13) % numBones);
+			vertex.boneWeights[j] = 0.25f;
+		}
+	}
+	std::vector<glm::mat4> palette(numBones);
+	for (int i = 0; i < numBones; i++)
+	{
+		palette[i] = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, i * 0.01f, 0.0f)) * glm::toMat4(glm::angleAxis(i * 0.1f, glm::vec3(0, 1, 0)));
+	}
+	const size_t numVertices = meshData.vertices.size();
+	std::vector<glm::vec3> referenceOutput(numVertices * 3), simdOutput(numVertices * 3);
+	ew::SkinningOutput reference = { &referenceOutput[0], &referenceOutput[numVertices], &referenceOutput[numVertices * 2] };
+	ew::SkinningOutput simd = { &simdOutput[0], &simdOutput[numVertices], &simdOutput[numVertices * 2] };
+
+	double startTime = glfwGetTime();
+	for (int i = 0; i < iterations; i++)
+		ew::skinVerticesReference(meshData, palette.data(), 0, numVertices, reference);
+	const double referenceTime = glfwGetTime() - startTime;
+	startTime = glfwGetTime();
+	for (int i = 0; i < iterations; i++)
+		ew::skinVertices(meshData, palette.data(), 0, numVertices, simd);
+	const double simdTime = glfwGetTime() - startTime;
+	const bool bitExact = memcmp(referenceOutput.data(), simdOutput.data(), sizeof(glm::vec3) * simdOutput.size()) == 0;
+	startTime = glfwGetTime();
+	for (int i = 0; i < iterations; i++)
+		ew::skinMesh(meshData, palette.data(), simd);
+	const double threadedTime = glfwGetTime() - startTime;
+	//Also on a 4 thread pool, so the split is exercised on machines with fewer cores
+	ew::WorkerPool pool(4);
+	simdOutput.assign(simdOutput.size(), glm::vec3(0));
+	ew::skinMesh(meshData, palette.data(), simd, &pool);
+	const bool threadedExact = memcmp(referenceOutput.data(), simdOutput.data(), sizeof(glm::vec3) * simdOutput.size()) == 0;
+
+	const double numSkinned = (double)numVertices * iterations / 1000000.0;
+	printf("%zu vertices: reference %.1f, SIMD %.1f, threaded %.1f M verts/s\n", numVertices,
+		numSkinned / referenceTime, numSkinned / simdTime, numSkinned / threadedTime);
+	printf("SIMD matches reference bit for bit: %s, threaded: %s\n", bitExact ? "yes" : "NO", threadedExact ? "yes" : "NO");
+	return bitExact && threadedExact;
+}
+
+//vat.vert positions, captured with transform feedback, against skinMesh on the palettes the clip was baked from.
+//Instance 0 sits on a baked frame. Instance 1 is halfway to the next one, turned and moved, so it checks
+//the frame blend and the instance transform. Skinning is linear in the palette, so halfway between the
+//frames is the average of the two skinned meshes.
+bool runVATCheck() {
+	const float frameRate = 30.0f;
+	const float tolerance = 1e-4f;
+	ew::AnimatedSkeletonPackage package = loadWalkingPackage();
+	const int numBones = (int)package.skeleton.bones.size();
+	ew::SkinBinding skinBinding;
+	for (int b = 0; b < numBones; b++)
+	{
+		skinBinding.boneIndices.push_back(b);
+		skinBinding.inverseBindPoses.push_back(package.skeleton.bones[b].inverseBindPose);
+	}
+	ew::VertexAnimationTexture vat;
+	ew::initVertexAnimationTexture(&vat, ew::VATType::BONE_MATRICES, numBones * 3);
+	const int clipIndex = ew::bakeBoneMatrixClip(package, skinBinding, frameRate, &vat);
+	if (clipIndex < 0)
+		return false;
+	const ew::VATClip& clip = vat.clips[clipIndex];
+	const int frame = clip.numFrames / 3;
+
+	unsigned int program = createCaptureProgram("assets/vat.vert", "Surface.WorldPos");
+	if (program == 0)
+		return false;
+	ew::MeshData meshData = makeSkinnedSphere(numBones);
+	ew::Mesh mesh(meshData);
+	const float yaw = 1.0f;
+	const glm::vec3 offset = glm::vec3(3.0f, 0.0f, -2.0f);
+	ew::VATInstance instances[2] = {
+		ew::makeVATInstance(vat, clipIndex, glm::vec3(0), 0.0f, (float)frame / clip.numFrames),
+		ew::makeVATInstance(vat, clipIndex, offset, yaw, (frame + 0.5f) / clip.numFrames)
+	};
+	mesh.setInstanceAttributes(&instances[0].transform, 2, 2);
+	unsigned int vatTexture = ew::createFloatTexture(vat.width, vat.getHeight(), vat.texels.data());
+	glBindTextureUnit(0, vatTexture);
+	setCaptureUniforms(program);
+	glUniform1i(glGetUniformLocation(program, "_VAT"), 0);
+	glUniform1i(glGetUniformLocation(program, "_VATWidth"), vat.width);
+	glUniform1i(glGetUniformLocation(program, "_VATRowsPerFrame"), vat.rowsPerFrame);
+	glUniform1f(glGetUniformLocation(program, "_Time"), 0.0f);
+	std::vector<glm::vec3> gpuPositions = capturePoints(mesh, 2);
+	bool passed = glGetError() == GL_NO_ERROR;
+	glDeleteTextures(1, &vatTexture);
+	glDeleteProgram(program);
+
+	//The frames bakeBoneMatrixClip sampled
+	const size_t numVertices = meshData.vertices.size();
+	std::vector<glm::vec3> framePositions[2];
+	ew::Skeleton skeleton = package.skeleton;
+	std::vector<glm::mat4> worldMatrices;
+	std::vector<glm::mat4> palette(numBones);
+	for (int i = 0; i < 2; i++)
+	{
+		framePositions[i].resize(numVertices);
+		ew::updateSkeleton(&skeleton, &package.animationClip, package.binding, (float)(frame + i) / clip.numFrames);
+		ew::solveFK(skeleton, worldMatrices);
+		ew::computeSkinningPalette(skinBinding, worldMatrices, palette.data());
+		ew::SkinningOutput output;
+		output.positions = framePositions[i].data();
+		ew::skinMesh(meshData, palette.data(), output);
+	}
+	const glm::mat4 instanceMatrix = glm::translate(glm::mat4(1), offset) * glm::toMat4(glm::angleAxis(yaw, glm::vec3(0, 1, 0)));
+	float maxError[2] = { 0.0f, 0.0f };
+	float extent = 1.0f;
+	for (size_t v = 0; v < numVertices; v++)
+	{
+		const glm::vec3 blended = glm::vec3(instanceMatrix * glm::vec4((framePositions[0][v] + framePositions[1][v]) * 0.5f, 1.0f));
+		maxError[0] = glm::max(maxError[0], glm::distance(gpuPositions[v], framePositions[0][v]));
+		maxError[1] = glm::max(maxError[1], glm::distance(gpuPositions[numVertices + v], blended));
+		extent = glm::max(extent, glm::length(framePositions[0][v]));
+	}
+	printf("%d bones, %d frames, %zu vertices\n", numBones, clip.numFrames, numVertices);
+	printf("Max distance from skinMesh, relative to mesh extent: on frame %d %g, halfway to the next, turned and moved %g\n",
+		frame, maxError[0] / extent, maxError[1] / extent);
+	passed &= maxError[0] / extent < tolerance && maxError[1] / extent < tolerance;
+	return passed;
+}
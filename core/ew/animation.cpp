@@ -3,6 +3,12 @@
 #include <assimp/postprocess.h>
 #include <assimp/scene.h>
 
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+#include <unordered_map>
+#include <unordered_set>
+
 namespace ew {
 	Vec3KeyFrame convertVec3Key(const aiVectorKey& aiKey) {
 		Vec3KeyFrame key;
@@ -59,47 +65,95 @@ namespace ew {
 		return boneAnim;
 	}
 
-	/// <summary>
-	/// Recursively populates boneList in order
-	/// </summary>
-	/// <param name="node"></param>
-	/// <param name="boneList"></param>
-	void loadAssimpSkeletonRecursive(aiNode* node, std::vector<aiNode*>* boneList) {
-		//Skip nodes with meshes
-		//We are only looking for the armature
-		if (node->mNumMeshes == 0)
+	//A node of the scene graph in depth-first order, with its parent's position in that order
+	struct SkeletonNode {
+		const aiNode* node;
+		int parent;
+	};
+
+	Skeleton loadSkeleton(const aiScene* aiScene) {
+		//Offset matrices of every node a mesh is skinned to
+		std::unordered_map<std::string, const aiMatrix4x4*> boneOffsets;
+		for (size_t m = 0; m < aiScene->mNumMeshes; m++)
 		{
-			boneList->push_back(node);
+			const aiMesh* aiMesh = aiScene->mMeshes[m];
+			for (size_t b = 0; b < aiMesh->mNumBones; b++)
+			{
+				boneOffsets.emplace(aiMesh->mBones[b]->mName.C_Str(), &aiMesh->mBones[b]->mOffsetMatrix);
+			}
 		}
-		for (size_t i = 0; i < node->mNumChildren; i++)
+		std::unordered_set<std::string> animatedNodes;
+		for (size_t a = 0; a < aiScene->mNumAnimations; a++)
 		{
-			//if no meshes, assume this is just a bone
-			loadAssimpSkeletonRecursive(node->mChildren[i], boneList);
+			const aiAnimation* aiAnim = aiScene->mAnimations[a];
+			for (size_t c = 0; c < aiAnim->mNumChannels; c++)
+			{
+				animatedNodes.emplace(aiAnim->mChannels[c]->mNodeName.C_Str());
+			}
+		}
+
+		//Flatten the node tree in depth-first order. Parents are recorded as they are visited,
+		//so no lookups are needed. Iterative so very deep hierarchies can't overflow the stack.
+		std::vector<SkeletonNode> nodes;
+		std::vector<SkeletonNode> stack;
+		stack.push_back({ aiScene->mRootNode, -1 });
+		while (!stack.empty()) {
+			SkeletonNode current = stack.back();
+			stack.pop_back();
+			const int index = (int)nodes.size();
+			nodes.push_back(current);
+			//Reverse so children come out in their original order
+			for (size_t c = current.node->mNumChildren; c-- > 0;)
+			{
+				stack.push_back({ current.node->mChildren[c], index });
+			}
+		}
+
+		//Keep nodes that skin a mesh or are animated, plus their ancestors so the hierarchy stays connected.
+		//Files without skinned meshes keep every node without a mesh, as before.
+		const size_t numNodes = nodes.size();
+		std::vector<bool> keep(numNodes);
+		for (size_t i = 0; i < numNodes; i++)
+		{
+			const aiNode* node = nodes[i].node;
+			if (boneOffsets.empty()) {
+				keep[i] = node->mNumMeshes == 0;
+			}
+			else {
+				std::string name = node->mName.C_Str();
+				keep[i] = boneOffsets.count(name) > 0 || animatedNodes.count(name) > 0;
+			}
+		}
+		//Children come after parents, so walking backwards reaches every child before its parent
+		for (size_t i = numNodes; i-- > 0;)
+		{
+			if (keep[i] && nodes[i].parent != -1) {
+				keep[nodes[i].parent] = true;
+			}
 		}
-	}
 
-	Skeleton loadSkeleton(aiNode* rootNode) {
 		Skeleton skeleton;
-		std::vector<aiNode*> nodeList;
-		loadAssimpSkeletonRecursive(rootNode, &nodeList);
-		//Keep sorted list of nodes to find parent indices
-		size_t numBones = nodeList.size();
-		for (size_t i = 0; i < numBones; i++)
+		std::vector<int> boneIndices(numNodes, -1);
+		std::vector<glm::mat4> modelTransforms;
+		skeleton.bones.reserve(numNodes);
+		modelTransforms.reserve(numNodes);
+		for (size_t i = 0; i < numNodes; i++)
 		{
-		//	const aiBone* aiBone = aiMesh->mBones[i];
-			aiNode* node = nodeList[i];
+			if (!keep[i])
+				continue;
+			const aiNode* node = nodes[i].node;
+			boneIndices[i] = (int)skeleton.bones.size();
 			Bone bone;
 			bone.name = node->mName.C_Str();
-			//bone.inverseBindPose = convertMat4(aiBone->mOffsetMatrix);
 			bone.localTransform = convertMat4(node->mTransformation);
-			//parentIndex is index in sorted list
-			bone.parentIndex = std::distance(nodeList.begin(), std::find(nodeList.begin(), nodeList.end(), node->mParent));
-			if (bone.parentIndex == nodeList.size()) {
-				bone.parentIndex = -1;
-			}
-			skeleton.bones.push_back(bone);
+			bone.parentIndex = nodes[i].parent == -1 ? -1 : boneIndices[nodes[i].parent];
+			glm::mat4 modelTransform = bone.parentIndex == -1 ? bone.localTransform : modelTransforms[bone.parentIndex] * bone.localTransform;
+			auto offset = boneOffsets.find(bone.name);
+			//Nodes that skin nothing get the inverse of their bind pose
+			bone.inverseBindPose = offset != boneOffsets.end() ? convertMat4(*offset->second) : glm::inverse(modelTransform);
+			modelTransforms.push_back(modelTransform);
+			skeleton.bones.push_back(std::move(bone));
 		}
-		
 		return skeleton;
 	}
 	//Loads a single animation from file
@@ -133,28 +187,60 @@ namespace ew {
 		animClip.duration = aiAnim->mDuration;
 		animClip.ticksPerSecond = aiAnim->mTicksPerSecond;
 
-		package.skeleton = loadSkeleton(aiScene->mRootNode);
+		package.skeleton = loadSkeleton(aiScene);
 		package.animationClip = animClip;
+		package.binding = bindAnimationClip(package.skeleton, &package.animationClip);
 		return package;
 	}
 
+	//parent * local for matrices whose bottom row is (0,0,0,1). Skips the 16 multiplies by the zero row,
+	//and gives the same result as the full product since those terms only add zeros.
+	static inline glm::mat4 multiplyAffine(const glm::mat4& parent, const glm::mat4& local) {
+		glm::mat4 result;
+		for (int c = 0; c < 3; c++)
+		{
+			result[c] = parent[0] * local[c][0] + parent[1] * local[c][1] + parent[2] * local[c][2];
+		}
+		result[3] = parent[0] * local[3][0] + parent[1] * local[3][1] + parent[2] * local[3][2] + parent[3];
+		return result;
+	}
+
 	void solveFK(const ew::Skeleton& skeleton, std::vector<glm::mat4>& worldMatrices) {
 		const size_t numBones = skeleton.bones.size();
-
-		worldMatrices.reserve(numBones);
-		worldMatrices.clear();
-		
+		//Sized once and written by index, so a reused vector does no per-bone push bookkeeping
+		worldMatrices.resize(numBones);
 		for (size_t i = 0; i < numBones; i++)
 		{
 			const ew::Bone& thisBone = skeleton.bones[i];
-			if (thisBone.parentIndex == -1) {
-				worldMatrices.emplace_back(thisBone.localTransform);
-				continue;
+			worldMatrices[i] = thisBone.parentIndex == -1 ? thisBone.localTransform : multiplyAffine(worldMatrices[thisBone.parentIndex], thisBone.localTransform);
+		}
+	}
+
+	void solveFKIncremental(ew::Skeleton* skeleton, std::vector<glm::mat4>& worldMatrices) {
+		const size_t numBones = skeleton->bones.size();
+		std::vector<uint8_t>& dirty = skeleton->dirtyBones;
+		if (worldMatrices.size() != numBones || dirty.size() != numBones) {
+			solveFK(*skeleton, worldMatrices);
+			dirty.assign(numBones, 0);
+			return;
+		}
+		size_t first = 0;
+		while (first < numBones && !dirty[first])
+			first++;
+		//Parents come before children, so a parent's flag is final by the time its children read it
+		for (size_t i = first; i < numBones; i++)
+		{
+			const ew::Bone& bone = skeleton->bones[i];
+			if (bone.parentIndex != -1 && dirty[bone.parentIndex]) {
+				dirty[i] = 1;
 			}
-			const ew::Bone& parentBone = skeleton.bones[thisBone.parentIndex];
-			worldMatrices.emplace_back(worldMatrices[thisBone.parentIndex] * thisBone.localTransform);
+			if (!dirty[i])
+				continue;
+			worldMatrices[i] = bone.parentIndex == -1 ? bone.localTransform : multiplyAffine(worldMatrices[bone.parentIndex], bone.localTransform);
+		}
+		if (first < numBones) {
+			memset(&dirty[first], 0, numBones - first);
 		}
-		return;
 	}
 
 	inline glm::vec3 lerp(const glm::vec3& x, const glm::vec3& y, float t) {
@@ -166,72 +252,239 @@ namespace ew {
 	inline float inverseLerp(float x, float y, float v) {
 		return  (v - x) / (y - x);
 	}
-	glm::vec3 lerpVec3KeyFrames(const std::vector<ew::Vec3KeyFrame>& keyFrames, float time) {
-		//Interpolate Positions
-		ew::Vec3KeyFrame prevKeyFrame, nextKeyFrame;
+	/// <summary>
+	/// Finds the index of the first keyframe with time >= time.
+	/// Checks the cached interval and the one after it first, so forward playback is O(1) amortized.
+	/// Falls back to a binary search on seeks and loops.
+	/// </summary>
+	/// <param name="keyFrames">Keyframes sorted by time</param>
+	/// <param name="time">Sample time in ticks</param>
+	/// <param name="cursor">Optional cached index. Updated with the result.</param>
+	/// <returns>Keyframe index, or keyFrames.size() if time is past the last keyframe</returns>
+	template<typename KeyFrameT>
+	size_t findNextKeyFrame(const std::vector<KeyFrameT>& keyFrames, float time, size_t* cursor) {
 		const size_t numKeyFrames = keyFrames.size();
-		for (size_t i = 0; i < numKeyFrames; i++)
-		{
-			if (keyFrames[i].time >= time) {
-				nextKeyFrame = keyFrames[i];
-				//Loop if this is first keyframe
-				prevKeyFrame = i > 0 ? keyFrames[i - 1] : keyFrames[numKeyFrames - 1];
-				break;
+		if (cursor != nullptr) {
+			size_t i = *cursor;
+			for (size_t step = 0; step < 2 && i < numKeyFrames; step++, i++)
+			{
+				if (keyFrames[i].time >= time && (i == 0 || keyFrames[i - 1].time < time)) {
+					*cursor = i;
+					return i;
+				}
 			}
 		}
+		size_t i = std::lower_bound(keyFrames.begin(), keyFrames.end(), time,
+			[](const KeyFrameT& keyFrame, float t) { return keyFrame.time < t; }) - keyFrames.begin();
+		if (cursor != nullptr) {
+			*cursor = i;
+		}
+		return i;
+	}
+
+	glm::vec3 lerpVec3KeyFrames(const std::vector<ew::Vec3KeyFrame>& keyFrames, float time, size_t* cursor) {
+		const size_t numKeyFrames = keyFrames.size();
+		if (numKeyFrames == 0)
+			return glm::vec3(0);
+		size_t next = findNextKeyFrame(keyFrames, time, cursor);
+		//Hold first/last value outside of keyed range
+		if (next == 0)
+			return keyFrames[0].value;
+		if (next == numKeyFrames)
+			return keyFrames[numKeyFrames - 1].value;
+		const ew::Vec3KeyFrame& prevKeyFrame = keyFrames[next - 1];
+		const ew::Vec3KeyFrame& nextKeyFrame = keyFrames[next];
 		//Inverse lerp to get t = (0-1)
 		float t = ew::inverseLerp(prevKeyFrame.time, nextKeyFrame.time, time);
 		//Lerp to get value
 		return ew::lerp(prevKeyFrame.value, nextKeyFrame.value, t);
 	}
 
-	glm::quat lerpQuatKeyFrames(const std::vector<ew::QuatKeyFrame>& keyFrames, float time) {
-		//Interpolate Positions
-		ew::QuatKeyFrame prevKeyFrame, nextKeyFrame;
+	glm::quat lerpQuatKeyFrames(const std::vector<ew::QuatKeyFrame>& keyFrames, float time, size_t* cursor) {
 		const size_t numKeyFrames = keyFrames.size();
-		for (size_t i = 0; i < numKeyFrames; i++)
-		{
-			if (keyFrames[i].time >= time) {
-				nextKeyFrame = keyFrames[i];
-				//Loop if this is first keyframe
-				prevKeyFrame = i > 0 ? keyFrames[i - 1] : keyFrames[numKeyFrames - 1];
-				break;
-			}
-		}
+		if (numKeyFrames == 0)
+			return glm::quat(1, 0, 0, 0);
+		size_t next = findNextKeyFrame(keyFrames, time, cursor);
+		//Hold first/last value outside of keyed range
+		if (next == 0)
+			return keyFrames[0].value;
+		if (next == numKeyFrames)
+			return keyFrames[numKeyFrames - 1].value;
+		const ew::QuatKeyFrame& prevKeyFrame = keyFrames[next - 1];
+		const ew::QuatKeyFrame& nextKeyFrame = keyFrames[next];
 		//Inverse lerp to get t = (0-1)
 		float t = ew::inverseLerp(prevKeyFrame.time, nextKeyFrame.time, time);
-		//Lerp to get value
+		//Slerp to get value
 		return glm::slerp(prevKeyFrame.value, nextKeyFrame.value, t);
 	}
+
+	void sampleBoneAnimation(const ew::BoneAnimation& boneAnim, float time, ew::ChannelCursor* cursor, glm::vec3* position, glm::quat* rotation, glm::vec3* scale) {
+		*position = lerpVec3KeyFrames(boneAnim.positionKeyFrames, time, cursor ? &cursor->positionKey : nullptr);
+		*rotation = lerpQuatKeyFrames(boneAnim.rotationKeyFrames, time, cursor ? &cursor->rotationKey : nullptr);
+		*scale = boneAnim.scaleKeyFrames.empty() ? glm::vec3(1) :
+			lerpVec3KeyFrames(boneAnim.scaleKeyFrames, time, cursor ? &cursor->scaleKey : nullptr);
+	}
 	
-	ew::Bone* findBone(ew::Skeleton* skeleton, const std::string& name) {
-		const size_t numBones = skeleton->bones.size();
+	void findBakedFrame(const ew::BakedPoseTrack& bakedTrack, float time, size_t* frame, float* t) {
+		float frameTime = bakedTrack.ticksPerFrame > 0 ? glm::max(time, 0.0f) / bakedTrack.ticksPerFrame : 0.0f;
+		size_t lastFrame = bakedTrack.numFrames > 1 ? bakedTrack.numFrames - 2 : 0;
+		*frame = glm::min((size_t)frameTime, lastFrame);
+		*t = bakedTrack.numFrames > 1 ? glm::clamp(frameTime - *frame, 0.0f, 1.0f) : 0.0f;
+	}
+
+	static void lerpBakedFrames(const ew::BakedPoseTrack& bakedTrack, size_t channel, size_t frame, float t, glm::vec3* position, glm::quat* rotation, glm::vec3* scale) {
+		const size_t a = frame * bakedTrack.numChannels + channel;
+		const size_t b = bakedTrack.numFrames > 1 ? a + bakedTrack.numChannels : a;
+		*position = ew::lerp(bakedTrack.positions[a], bakedTrack.positions[b], t);
+		*scale = ew::lerp(bakedTrack.scales[a], bakedTrack.scales[b], t);
+		//Frames share a hemisphere, so a normalized lerp needs no sign check
+		const glm::quat& qa = bakedTrack.rotations[a];
+		const glm::quat& qb = bakedTrack.rotations[b];
+		*rotation = glm::normalize(glm::quat(
+			qa.w + (qb.w - qa.w) * t, qa.x + (qb.x - qa.x) * t, qa.y + (qb.y - qa.y) * t, qa.z + (qb.z - qa.z) * t));
+	}
+
+	void sampleBakedPoseTrack(const ew::BakedPoseTrack& bakedTrack, size_t channel, float time, glm::vec3* position, glm::quat* rotation, glm::vec3* scale) {
+		size_t frame;
+		float t;
+		findBakedFrame(bakedTrack, time, &frame, &t);
+		lerpBakedFrames(bakedTrack, channel, frame, t, position, rotation, scale);
+	}
+
+	void bakeAnimationClip(ew::AnimationClip* animClip, float sampleRate, ew::AnimationBakeReport* report) {
+		const float durationSeconds = animClip->duration / ew::getTicksPerSecond(*animClip);
+		const int numFrames = glm::max((int)ceilf(durationSeconds * sampleRate), 1) + 1;
+		const size_t numChannels = animClip->bones.size();
+
+		BakedPoseTrack& bakedTrack = animClip->bakedTrack;
+		bakedTrack.ticksPerFrame = animClip->duration / (numFrames - 1);
+		bakedTrack.numFrames = numFrames;
+		bakedTrack.numChannels = (int)numChannels;
+		bakedTrack.positions.resize(numFrames * numChannels);
+		bakedTrack.rotations.resize(numFrames * numChannels);
+		bakedTrack.scales.resize(numFrames * numChannels);
+		std::vector<ChannelCursor> cursors(numChannels);
+		for (int frame = 0; frame < numFrames; frame++)
+		{
+			float time = frame == numFrames - 1 ? animClip->duration : frame * bakedTrack.ticksPerFrame;
+			for (size_t c = 0; c < numChannels; c++)
+			{
+				const size_t i = frame * numChannels + c;
+				sampleBoneAnimation(animClip->bones[c], time, &cursors[c], &bakedTrack.positions[i], &bakedTrack.rotations[i], &bakedTrack.scales[i]);
+				//Keep consecutive frames in the same hemisphere
+				if (frame > 0 && glm::dot(bakedTrack.rotations[i], bakedTrack.rotations[i - numChannels]) < 0) {
+					bakedTrack.rotations[i] = -bakedTrack.rotations[i];
+				}
+			}
+		}
+		if (report == nullptr)
+			return;
+		*report = AnimationBakeReport();
+		report->numFrames = numFrames;
+		report->bakedBytes = bakedTrack.positions.size() * sizeof(glm::vec3) + bakedTrack.rotations.size() * sizeof(glm::quat) + bakedTrack.scales.size() * sizeof(glm::vec3);
+		for (size_t c = 0; c < numChannels; c++)
+		{
+			const BoneAnimation& boneAnim = animClip->bones[c];
+			std::vector<float> sampleTimes;
+			for (const Vec3KeyFrame& key : boneAnim.positionKeyFrames) sampleTimes.push_back(key.time);
+			for (const QuatKeyFrame& key : boneAnim.rotationKeyFrames) sampleTimes.push_back(key.time);
+			for (const Vec3KeyFrame& key : boneAnim.scaleKeyFrames) sampleTimes.push_back(key.time);
+			for (float time : sampleTimes)
+			{
+				glm::vec3 sourcePos, sourceScale, bakedPos, bakedScale;
+				glm::quat sourceRot, bakedRot;
+				sampleBoneAnimation(boneAnim, time, nullptr, &sourcePos, &sourceRot, &sourceScale);
+				sampleBakedPoseTrack(bakedTrack, c, time, &bakedPos, &bakedRot, &bakedScale);
+				float cosAngle = glm::min(fabsf(glm::dot(sourceRot, bakedRot)), 1.0f);
+				report->maxPositionError = glm::max(report->maxPositionError, glm::length(sourcePos - bakedPos));
+				report->maxRotationError = glm::max(report->maxRotationError, 2.0f * acosf(cosAngle));
+				report->maxScaleError = glm::max(report->maxScaleError, glm::length(sourceScale - bakedScale));
+			}
+		}
+	}
+
+	int findBoneIndex(const ew::Skeleton& skeleton, const std::string& name) {
+		const size_t numBones = skeleton.bones.size();
 		for (size_t i = 0; i < numBones; i++)
 		{
-			if (skeleton->bones[i].name == name)
-				return &skeleton->bones.data()[i];
+			if (skeleton.bones[i].name == name)
+				return (int)i;
 		}
+		return -1;
 	}
-	void updateSkeleton(ew::Skeleton* skeleton, ew::AnimationClip* animClip, float normalizedTime) {
-		float time = ew::lerp(0, animClip->duration, glm::clamp<float>(normalizedTime,0,1));
+
+	AnimationBinding bindAnimationClip(const ew::Skeleton& skeleton, ew::AnimationClip* animClip) {
+		AnimationBinding binding;
+		//Hash bone names once instead of a linear search per channel
+		std::unordered_map<std::string, int> boneIndexMap;
+		const size_t numBones = skeleton.bones.size();
+		boneIndexMap.reserve(numBones);
+		for (size_t i = 0; i < numBones; i++)
+		{
+			boneIndexMap.emplace(skeleton.bones[i].name, (int)i);
+		}
+		//Compact matched channels in place, dropping the rest
+		size_t numBound = 0;
 		for (size_t i = 0; i < animClip->bones.size(); i++)
 		{
-			const BoneAnimation& boneAnim = animClip->bones[i];
-
-			//Translation
-			glm::vec3 interpolatedPos = lerpVec3KeyFrames(boneAnim.positionKeyFrames, time);
-			glm::mat4 translation = glm::translate(glm::mat4(1), interpolatedPos);
+			auto it = boneIndexMap.find(animClip->bones[i].name);
+			if (it == boneIndexMap.end()) {
+				printf("Animation channel %s does not match any bone. Skipping.\n", animClip->bones[i].name.c_str());
+				continue;
+			}
+			if (numBound != i) {
+				animClip->bones[numBound] = std::move(animClip->bones[i]);
+			}
+			binding.boneIndices.push_back(it->second);
+			numBound++;
+		}
+		animClip->bones.resize(numBound);
+		return binding;
+	}
 
-			//Rotation
-			glm::quat interpolatedRot = lerpQuatKeyFrames(boneAnim.rotationKeyFrames, time);
-			glm::mat4 rotation = glm::toMat4(interpolatedRot);
-			
-			//TODO: Scale
-			glm::vec3 interpolatedScale = lerpVec3KeyFrames(boneAnim.scaleKeyFrames, time);
-			glm::mat4 scale = glm::scale(glm::mat4(1),interpolatedScale);
+	inline glm::mat4 composeTRS(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale) {
+		glm::mat4 translation = glm::translate(glm::mat4(1), position);
+		glm::mat4 rot = glm::toMat4(rotation);
+		return glm::scale(translation * rot, scale);
+	}
 
-			Bone* bone = findBone(skeleton, boneAnim.name);
-			bone->localTransform = translation * rotation * scale;
+	void updateSkeleton(ew::Skeleton* skeleton, const ew::AnimationClip* animClip, const ew::AnimationBinding& binding, float normalizedTime, ew::AnimationCursor* cursor, bool skipOptionalBones) {
+		float time = ew::lerp(0, animClip->duration, glm::clamp<float>(normalizedTime, 0, 1));
+		if (animClip->useBakedTrack) {
+			//Same frame pair for every channel
+			size_t frame;
+			float t;
+			findBakedFrame(animClip->bakedTrack, time, &frame, &t);
+			for (size_t i = 0; i < animClip->bones.size(); i++)
+			{
+				Bone& bone = skeleton->bones[binding.boneIndices[i]];
+				if (skipOptionalBones && bone.optional)
+					continue;
+				glm::vec3 interpolatedPos, interpolatedScale;
+				glm::quat interpolatedRot;
+				lerpBakedFrames(animClip->bakedTrack, i, frame, t, &interpolatedPos, &interpolatedRot, &interpolatedScale);
+				bone.localTransform = composeTRS(interpolatedPos, interpolatedRot, interpolatedScale);
+				markBoneDirty(skeleton, binding.boneIndices[i]);
+			}
+			return;
+		}
+		if (cursor != nullptr && cursor->channels.size() != animClip->bones.size()) {
+			cursor->channels.assign(animClip->bones.size(), ChannelCursor());
 		}
+		for (size_t i = 0; i < animClip->bones.size(); i++)
+		{
+			Bone& bone = skeleton->bones[binding.boneIndices[i]];
+			if (skipOptionalBones && bone.optional)
+				continue;
+			glm::vec3 interpolatedPos, interpolatedScale;
+			glm::quat interpolatedRot;
+			sampleBoneAnimation(animClip->bones[i], time, cursor ? &cursor->channels[i] : nullptr, &interpolatedPos, &interpolatedRot, &interpolatedScale);
+			bone.localTransform = composeTRS(interpolatedPos, interpolatedRot, interpolatedScale);
+			markBoneDirty(skeleton, binding.boneIndices[i]);
+		}
+	}
+
+	void updateSkeleton(ew::AnimatedSkeletonPackage* package, float normalizedTime, ew::AnimationCursor* cursor) {
+		updateSkeleton(&package->skeleton, &package->animationClip, package->binding, normalizedTime, cursor);
 	}
 }
\ No newline at end of file
@@ -4,6 +4,10 @@
 
 #include <vector>
 #include <string>
+#include <stdint.h>
+
+struct aiScene;
+struct aiNodeAnim;
 
 namespace ew {
 	template <typename T>
@@ -22,28 +26,120 @@ namespace ew {
 		std::vector<QuatKeyFrame> rotationKeyFrames;
 		std::vector<Vec3KeyFrame> scaleKeyFrames;
 	};
+	//A clip resampled at a fixed rate into contiguous per-frame local poses.
+	//Sampling is an index computation plus one lerp per component, with no key search.
+	struct BakedPoseTrack {
+		float ticksPerFrame = 0;
+		int numFrames = 0;
+		int numChannels = 0;
+		//Indexed [frame * numChannels + channel]. Rotations are kept in one hemisphere per channel.
+		std::vector<glm::vec3> positions;
+		std::vector<glm::quat> rotations;
+		std::vector<glm::vec3> scales;
+	};
 	struct AnimationClip {
 		float duration;
 		int ticksPerSecond;
 		std::vector<BoneAnimation> bones;
+		BakedPoseTrack bakedTrack;
+		bool useBakedTrack = false; //Sample bakedTrack instead of the keyframes
+	};
+	//Assimp reports 0 ticks per second when the file does not specify it
+	inline float getTicksPerSecond(const ew::AnimationClip& animClip) {
+		return animClip.ticksPerSecond > 0 ? (float)animClip.ticksPerSecond : 25.0f;
+	}
+	struct AnimationBakeReport {
+		int numFrames = 0;
+		size_t bakedBytes = 0;
+		//Max error against the source, measured at every source key
+		float maxPositionError = 0;
+		float maxRotationError = 0; //Radians
+		float maxScaleError = 0;
 	};
 	struct Bone {
 		std::string name;
 		int parentIndex;
 		glm::mat4 inverseBindPose; //Model space -> bone space in bind pose
 		glm::mat4 localTransform; //Transform relative to parent in bind pose
+		bool optional = false; //Detail bone (fingers, face) that distant LODs may leave unanimated
 	};
 	struct Skeleton {
 		std::vector<Bone> bones;
+		//1 for bones whose localTransform changed since the last solveFKIncremental, indexed like bones.
+		//Empty until the first incremental solve, so skeletons that never use it pay nothing.
+		std::vector<uint8_t> dirtyBones;
+	};
+	//Call after writing a bone's localTransform directly. The update functions already do this.
+	inline void markBoneDirty(ew::Skeleton* skeleton, int boneIndex) {
+		if (!skeleton->dirtyBones.empty()) {
+			skeleton->dirtyBones[boneIndex] = 1;
+		}
+	}
+	inline void setLocalTransform(ew::Skeleton* skeleton, int boneIndex, const glm::mat4& localTransform) {
+		skeleton->bones[boneIndex].localTransform = localTransform;
+		markBoneDirty(skeleton, boneIndex);
+	}
+	//Maps each channel of an AnimationClip to the index of the skeleton bone it drives.
+	//Resolved once at load time so sampling does no string lookups.
+	struct AnimationBinding {
+		std::vector<int> boneIndices;
 	};
 	struct AnimatedSkeletonPackage {
 		Skeleton skeleton;
 		AnimationClip animationClip;
+		AnimationBinding binding; //animationClip.bones[i] drives skeleton.bones[binding.boneIndices[i]]
+	};
+	//Index of the next keyframe found by the last sample of each track in a channel.
+	//Forward playback resumes its search here instead of at keyframe 0.
+	struct ChannelCursor {
+		size_t positionKey = 0;
+		size_t rotationKey = 0;
+		size_t scaleKey = 0;
+	};
+	//Playback cursor for a clip, one ChannelCursor per BoneAnimation.
+	//Keep one per playing instance. Seeks and loops fall back to a binary search.
+	struct AnimationCursor {
+		std::vector<ChannelCursor> channels;
 	};
 	AnimatedSkeletonPackage loadAnimationFromFile(const char* filePath);
+	/// <summary>
+	/// Builds a skeleton from the nodes that skinned meshes and animations refer to, plus their ancestors.
+	/// Bones are in depth-first order, parents before children. Runs in time linear in the number of nodes.
+	/// </summary>
+	Skeleton loadSkeleton(const aiScene* aiScene);
+	//Copies one Assimp channel's keys. Used by loaders that build their own clips.
+	BoneAnimation loadBoneAnimation(const aiNodeAnim* aiNodeAnim);
 
+	//Local transforms are assumed affine (bottom row 0,0,0,1), which holds for anything loadSkeleton or the update functions write.
 	void solveFK(const ew::Skeleton& skeleton, std::vector<glm::mat4>& worldMatrices);
-	void updateSkeleton(ew::Skeleton* skeleton, ew::AnimationClip* animClip, float time);
+	/// <summary>
+	/// Same output as solveFK, but only recomputes dirty bones and their descendants.
+	/// worldMatrices must hold the result of the previous solve of this skeleton. If its size doesn't match,
+	/// or the skeleton has never been solved incrementally, every bone is solved. Clears the dirty flags.
+	/// </summary>
+	void solveFKIncremental(ew::Skeleton* skeleton, std::vector<glm::mat4>& worldMatrices);
+	//binding comes from bindAnimationClip, so no bone is looked up by name here.
+	//skipOptionalBones leaves the local transforms of optional bones untouched
+	void updateSkeleton(ew::Skeleton* skeleton, const ew::AnimationClip* animClip, const ew::AnimationBinding& binding, float time, ew::AnimationCursor* cursor = nullptr, bool skipOptionalBones = false);
+	void updateSkeleton(ew::AnimatedSkeletonPackage* package, float time, ew::AnimationCursor* cursor = nullptr);
+
+	//Returns -1 if no bone has this name
+	int findBoneIndex(const ew::Skeleton& skeleton, const std::string& name);
+	//Resolves every channel of animClip to a bone index.
+	//Channels that match no bone are reported and removed from animClip.
+	AnimationBinding bindAnimationClip(const ew::Skeleton& skeleton, ew::AnimationClip* animClip);
+
+	//Keyframe interpolation. cursor is optional and caches the keyframe index between calls.
+	glm::vec3 lerpVec3KeyFrames(const std::vector<ew::Vec3KeyFrame>& keyFrames, float time, size_t* cursor = nullptr);
+	glm::quat lerpQuatKeyFrames(const std::vector<ew::QuatKeyFrame>& keyFrames, float time, size_t* cursor = nullptr);
+	//Resamples animClip at sampleRate frames per second into animClip->bakedTrack.
+	//Set animClip->useBakedTrack to sample it. The frame step is shortened slightly so the last frame lands exactly on the clip's end.
+	void bakeAnimationClip(ew::AnimationClip* animClip, float sampleRate, ew::AnimationBakeReport* report = nullptr);
+	void sampleBakedPoseTrack(const ew::BakedPoseTrack& bakedTrack, size_t channel, float time, glm::vec3* position, glm::quat* rotation, glm::vec3* scale);
+	//Frame pair (frame, frame + 1) and lerp factor for a time in ticks
+	void findBakedFrame(const ew::BakedPoseTrack& bakedTrack, float time, size_t* frame, float* t);
+	//Samples all 3 tracks of a channel at time (in ticks). Empty tracks return the identity value.
+	void sampleBoneAnimation(const ew::BoneAnimation& boneAnim, float time, ew::ChannelCursor* cursor, glm::vec3* position, glm::quat* rotation, glm::vec3* scale);
 
 	
 }
\ No newline at end of file
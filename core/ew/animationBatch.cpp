@@ -0,0 +1,297 @@
+#include "animationBatch.h"
+#include "simd.h"
+#include <algorithm>
+#include <math.h>
+
+namespace ew {
+	//Pointers to the SoA arrays of a batch of quaternions
+	struct QuatLanes {
+		float* x;
+		float* y;
+		float* z;
+		float* w;
+	};
+
+	//a = a + (b - a) * t, for lanes [i, i + width)
+	template<typename V>
+	static inline void lerpLanes(float* a, const float* b, const float* t, size_t i) {
+		V va = vload(a + i, V()), vb = vload(b + i, V()), vt = vload(t + i, V());
+		vstore(a + i, vadd(va, vmul(vsub(vb, va), vt)));
+	}
+
+	//a = normalize(lerp(a, +-b, t)), taking the shortest path
+	template<typename V>
+	static inline void nlerpLanes(QuatLanes a, QuatLanes b, const float* t, size_t i) {
+		V ax = vload(a.x + i, V()), ay = vload(a.y + i, V()), az = vload(a.z + i, V()), aw = vload(a.w + i, V());
+		V bx = vload(b.x + i, V()), by = vload(b.y + i, V()), bz = vload(b.z + i, V()), bw = vload(b.w + i, V());
+		V vt = vload(t + i, V());
+		V sign = vsign(dot4(ax, ay, az, aw, bx, by, bz, bw));
+		V wa = vsub(vset(1.0f, V()), vt);
+		V wb = vmul(vt, sign);
+		V rx = vadd(vmul(ax, wa), vmul(bx, wb));
+		V ry = vadd(vmul(ay, wa), vmul(by, wb));
+		V rz = vadd(vmul(az, wa), vmul(bz, wb));
+		V rw = vadd(vmul(aw, wa), vmul(bw, wb));
+		V invLength = vdiv(vset(1.0f, V()), vsqrt(dot4(rx, ry, rz, rw, rx, ry, rz, rw)));
+		vstore(a.x + i, vmul(rx, invLength));
+		vstore(a.y + i, vmul(ry, invLength));
+		vstore(a.z + i, vmul(rz, invLength));
+		vstore(a.w + i, vmul(rw, invLength));
+	}
+
+	/// <summary>
+	/// Slerp without trig calls, after Eberly, "A Fast and Accurate Algorithm for Computing SLERP".
+	/// The slerp weights are evaluated as 8-term polynomials in (cos(theta) - 1), max error ~1e-7.
+	/// </summary>
+	template<typename V>
+	static inline void slerpLanes(QuatLanes a, QuatLanes b, const float* t, size_t i) {
+		const float onePlusMu = 1.90110745351730037f;
+		static const float u[8] = { 1.0f / (1 * 3), 1.0f / (2 * 5), 1.0f / (3 * 7), 1.0f / (4 * 9),
+			1.0f / (5 * 11), 1.0f / (6 * 13), 1.0f / (7 * 15), onePlusMu / (8 * 17) };
+		static const float v[8] = { 1.0f / 3, 2.0f / 5, 3.0f / 7, 4.0f / 9,
+			5.0f / 11, 6.0f / 13, 7.0f / 15, onePlusMu * 8 / 17 };
+
+		V ax = vload(a.x + i, V()), ay = vload(a.y + i, V()), az = vload(a.z + i, V()), aw = vload(a.w + i, V());
+		V bx = vload(b.x + i, V()), by = vload(b.y + i, V()), bz = vload(b.z + i, V()), bw = vload(b.w + i, V());
+		V vt = vload(t + i, V());
+		V one = vset(1.0f, V());
+		V cosTheta = dot4(ax, ay, az, aw, bx, by, bz, bw);
+		V sign = vsign(cosTheta);
+		V xm1 = vsub(vmul(cosTheta, sign), one);
+		V d = vsub(one, vt);
+		V sqrT = vmul(vt, vt);
+		V sqrD = vmul(d, d);
+		V weightA = one, weightB = one;
+		for (int k = 7; k >= 0; k--)
+		{
+			V uk = vset(u[k], V()), vk = vset(v[k], V());
+			weightA = vadd(one, vmul(vmul(vsub(vmul(uk, sqrD), vk), xm1), weightA));
+			weightB = vadd(one, vmul(vmul(vsub(vmul(uk, sqrT), vk), xm1), weightB));
+		}
+		weightA = vmul(weightA, d);
+		weightB = vmul(vmul(weightB, vt), sign);
+		vstore(a.x + i, vadd(vmul(ax, weightA), vmul(bx, weightB)));
+		vstore(a.y + i, vadd(vmul(ay, weightA), vmul(by, weightB)));
+		vstore(a.z + i, vadd(vmul(az, weightA), vmul(bz, weightB)));
+		vstore(a.w + i, vadd(vmul(aw, weightA), vmul(bw, weightB)));
+	}
+
+	static void lerpBatch(float* a, const float* b, const float* t, size_t count) {
+		size_t i = 0;
+#ifdef EW_SIMD_AVX
+		for (; i + 8 <= count; i += 8) lerpLanes<__m256>(a, b, t, i);
+#endif
+#ifdef EW_SIMD_SSE
+		for (; i + 4 <= count; i += 4) lerpLanes<__m128>(a, b, t, i);
+#endif
+		for (; i < count; i++) lerpLanes<float>(a, b, t, i);
+	}
+
+	static void quatInterpolateBatch(QuatLanes a, QuatLanes b, const float* t, size_t count, QuatInterpolation quatInterpolation) {
+		size_t i = 0;
+		if (quatInterpolation == QuatInterpolation::NLERP) {
+#ifdef EW_SIMD_AVX
+			for (; i + 8 <= count; i += 8) nlerpLanes<__m256>(a, b, t, i);
+#endif
+#ifdef EW_SIMD_SSE
+			for (; i + 4 <= count; i += 4) nlerpLanes<__m128>(a, b, t, i);
+#endif
+			for (; i < count; i++) nlerpLanes<float>(a, b, t, i);
+		}
+		else {
+#ifdef EW_SIMD_AVX
+			for (; i + 8 <= count; i += 8) slerpLanes<__m256>(a, b, t, i);
+#endif
+#ifdef EW_SIMD_SSE
+			for (; i + 4 <= count; i += 4) slerpLanes<__m128>(a, b, t, i);
+#endif
+			for (; i < count; i++) slerpLanes<float>(a, b, t, i);
+		}
+	}
+
+	/// <summary>
+	/// Finds the keys around time and the lerp factor between them.
+	/// Outside of the keyed range both keys are the edge key.
+	/// </summary>
+	template<typename KeyFrameT>
+	static void findKeyPair(const std::vector<KeyFrameT>& keyFrames, float time, size_t* prev, size_t* next, float* t) {
+		const size_t numKeyFrames = keyFrames.size();
+		size_t i = std::lower_bound(keyFrames.begin(), keyFrames.end(), time,
+			[](const KeyFrameT& keyFrame, float v) { return keyFrame.time < v; }) - keyFrames.begin();
+		if (i == 0 || i == numKeyFrames) {
+			*prev = *next = i == 0 ? 0 : numKeyFrames - 1;
+			*t = 0;
+			return;
+		}
+		*prev = i - 1;
+		*next = i;
+		*t = (time - keyFrames[i - 1].time) / (keyFrames[i].time - keyFrames[i - 1].time);
+	}
+
+	static void sampleVec3Track(const std::vector<ew::Vec3KeyFrame>& keyFrames, const glm::vec3& defaultValue, const float* times, size_t numSamples, size_t stride, float* outX, float* outY, float* outZ, float* scratch) {
+		if (keyFrames.size() <= 1) {
+			glm::vec3 v = keyFrames.empty() ? defaultValue : keyFrames[0].value;
+			std::fill(outX, outX + numSamples, v.x);
+			std::fill(outY, outY + numSamples, v.y);
+			std::fill(outZ, outZ + numSamples, v.z);
+			return;
+		}
+		float* nextX = scratch;
+		float* nextY = scratch + stride;
+		float* nextZ = scratch + stride * 2;
+		float* t = scratch + stride * 4;
+		//Gather key pairs, then interpolate every sample at once
+		for (size_t i = 0; i < numSamples; i++)
+		{
+			size_t prev, next;
+			findKeyPair(keyFrames, times[i], &prev, &next, &t[i]);
+			outX[i] = keyFrames[prev].value.x;
+			outY[i] = keyFrames[prev].value.y;
+			outZ[i] = keyFrames[prev].value.z;
+			nextX[i] = keyFrames[next].value.x;
+			nextY[i] = keyFrames[next].value.y;
+			nextZ[i] = keyFrames[next].value.z;
+		}
+		lerpBatch(outX, nextX, t, numSamples);
+		lerpBatch(outY, nextY, t, numSamples);
+		lerpBatch(outZ, nextZ, t, numSamples);
+	}
+
+	static void sampleQuatTrack(const std::vector<ew::QuatKeyFrame>& keyFrames, const float* times, size_t numSamples, size_t stride, QuatLanes out, float* scratch, QuatInterpolation quatInterpolation) {
+		if (keyFrames.size() <= 1) {
+			glm::quat q = keyFrames.empty() ? glm::quat(1, 0, 0, 0) : keyFrames[0].value;
+			std::fill(out.x, out.x + numSamples, q.x);
+			std::fill(out.y, out.y + numSamples, q.y);
+			std::fill(out.z, out.z + numSamples, q.z);
+			std::fill(out.w, out.w + numSamples, q.w);
+			return;
+		}
+		QuatLanes next = { scratch, scratch + stride, scratch + stride * 2, scratch + stride * 3 };
+		float* t = scratch + stride * 4;
+		for (size_t i = 0; i < numSamples; i++)
+		{
+			size_t prevKey, nextKey;
+			findKeyPair(keyFrames, times[i], &prevKey, &nextKey, &t[i]);
+			const glm::quat& a = keyFrames[prevKey].value;
+			const glm::quat& b = keyFrames[nextKey].value;
+			out.x[i] = a.x; out.y[i] = a.y; out.z[i] = a.z; out.w[i] = a.w;
+			next.x[i] = b.x; next.y[i] = b.y; next.z[i] = b.z; next.w[i] = b.w;
+		}
+		quatInterpolateBatch(out, next, t, numSamples, quatInterpolation);
+	}
+
+	//Gathers the frame pair of every sample for one channel, then interpolates every sample at once
+	static void sampleBakedChannel(const ew::BakedPoseTrack& bakedTrack, size_t channel, const size_t* frames, const float* t, size_t numSamples, size_t stride, ew::PoseBatch* batch, size_t offset, QuatInterpolation quatInterpolation) {
+		float* scratch = batch->scratch.data();
+		const size_t nextFrameOffset = bakedTrack.numFrames > 1 ? bakedTrack.numChannels : 0;
+		float* outX = &batch->px[offset];
+		float* outY = &batch->py[offset];
+		float* outZ = &batch->pz[offset];
+		float* nextX = scratch;
+		float* nextY = scratch + stride;
+		float* nextZ = scratch + stride * 2;
+		for (size_t i = 0; i < numSamples; i++)
+		{
+			const size_t a = frames[i] * bakedTrack.numChannels + channel;
+			const glm::vec3& pa = bakedTrack.positions[a];
+			const glm::vec3& pb = bakedTrack.positions[a + nextFrameOffset];
+			outX[i] = pa.x; outY[i] = pa.y; outZ[i] = pa.z;
+			nextX[i] = pb.x; nextY[i] = pb.y; nextZ[i] = pb.z;
+		}
+		lerpBatch(outX, nextX, t, numSamples);
+		lerpBatch(outY, nextY, t, numSamples);
+		lerpBatch(outZ, nextZ, t, numSamples);
+
+		QuatLanes out = { &batch->rx[offset], &batch->ry[offset], &batch->rz[offset], &batch->rw[offset] };
+		QuatLanes next = { scratch, scratch + stride, scratch + stride * 2, scratch + stride * 3 };
+		for (size_t i = 0; i < numSamples; i++)
+		{
+			const size_t a = frames[i] * bakedTrack.numChannels + channel;
+			const glm::quat& qa = bakedTrack.rotations[a];
+			const glm::quat& qb = bakedTrack.rotations[a + nextFrameOffset];
+			out.x[i] = qa.x; out.y[i] = qa.y; out.z[i] = qa.z; out.w[i] = qa.w;
+			next.x[i] = qb.x; next.y[i] = qb.y; next.z[i] = qb.z; next.w[i] = qb.w;
+		}
+		quatInterpolateBatch(out, next, t, numSamples, quatInterpolation);
+
+		outX = &batch->sx[offset];
+		outY = &batch->sy[offset];
+		outZ = &batch->sz[offset];
+		for (size_t i = 0; i < numSamples; i++)
+		{
+			const size_t a = frames[i] * bakedTrack.numChannels + channel;
+			const glm::vec3& sa = bakedTrack.scales[a];
+			const glm::vec3& sb = bakedTrack.scales[a + nextFrameOffset];
+			outX[i] = sa.x; outY[i] = sa.y; outZ[i] = sa.z;
+			nextX[i] = sb.x; nextY[i] = sb.y; nextZ[i] = sb.z;
+		}
+		lerpBatch(outX, nextX, t, numSamples);
+		lerpBatch(outY, nextY, t, numSamples);
+		lerpBatch(outZ, nextZ, t, numSamples);
+	}
+
+	void sampleAnimationClipBatch(const ew::AnimationClip& animClip, const float* normalizedTimes, size_t numSamples, ew::PoseBatch* batch, ew::QuatInterpolation quatInterpolation) {
+		const size_t numChannels = animClip.bones.size();
+		const size_t stride = simdPaddedSize(numSamples);
+		const size_t arraySize = stride * numChannels;
+		batch->numSamples = numSamples;
+		batch->numChannels = numChannels;
+		batch->stride = stride;
+		std::vector<float>* arrays[10] = { &batch->px, &batch->py, &batch->pz, &batch->rx, &batch->ry, &batch->rz, &batch->rw, &batch->sx, &batch->sy, &batch->sz };
+		for (std::vector<float>* array : arrays)
+		{
+			array->resize(arraySize);
+		}
+		//4 next-key components + lerp factor, then the clip times
+		batch->scratch.resize(stride * 6);
+		float* times = batch->scratch.data() + stride * 5;
+		for (size_t i = 0; i < numSamples; i++)
+		{
+			times[i] = animClip.duration * glm::clamp(normalizedTimes[i], 0.0f, 1.0f);
+		}
+		float* scratch = batch->scratch.data();
+		if (animClip.useBakedTrack) {
+			//Every channel shares the frame pair of a sample, so find it once.
+			//The lerp factors go in the slot the clip times used.
+			const BakedPoseTrack& bakedTrack = animClip.bakedTrack;
+			batch->bakedFrames.resize(numSamples);
+			float* t = times;
+			for (size_t i = 0; i < numSamples; i++)
+			{
+				findBakedFrame(bakedTrack, times[i], &batch->bakedFrames[i], &t[i]);
+			}
+			for (size_t c = 0; c < numChannels; c++)
+			{
+				sampleBakedChannel(bakedTrack, c, batch->bakedFrames.data(), t, numSamples, stride, batch, c * stride, quatInterpolation);
+			}
+			return;
+		}
+		for (size_t c = 0; c < numChannels; c++)
+		{
+			const BoneAnimation& boneAnim = animClip.bones[c];
+			const size_t offset = c * stride;
+			sampleVec3Track(boneAnim.positionKeyFrames, glm::vec3(0), times, numSamples, stride,
+				&batch->px[offset], &batch->py[offset], &batch->pz[offset], scratch);
+			QuatLanes rotation = { &batch->rx[offset], &batch->ry[offset], &batch->rz[offset], &batch->rw[offset] };
+			sampleQuatTrack(boneAnim.rotationKeyFrames, times, numSamples, stride, rotation, scratch, quatInterpolation);
+			sampleVec3Track(boneAnim.scaleKeyFrames, glm::vec3(1), times, numSamples, stride,
+				&batch->sx[offset], &batch->sy[offset], &batch->sz[offset], scratch);
+		}
+	}
+
+	void applyPoseBatch(const ew::PoseBatch& batch, size_t sample, const ew::AnimationBinding& binding, ew::Skeleton* skeleton) {
+		for (size_t c = 0; c < batch.numChannels; c++)
+		{
+			const size_t i = c * batch.stride + sample;
+			//T * R * S written out, instead of multiplying the translation and rotation matrices
+			const float x = batch.rx[i], y = batch.ry[i], z = batch.rz[i], w = batch.rw[i];
+			const float sx = batch.sx[i], sy = batch.sy[i], sz = batch.sz[i];
+			glm::mat4 m;
+			m[0] = glm::vec4(1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + w * z), 2.0f * (x * z - w * y), 0.0f) * sx;
+			m[1] = glm::vec4(2.0f * (x * y - w * z), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + w * x), 0.0f) * sy;
+			m[2] = glm::vec4(2.0f * (x * z + w * y), 2.0f * (y * z - w * x), 1.0f - 2.0f * (x * x + y * y), 0.0f) * sz;
+			m[3] = glm::vec4(batch.px[i], batch.py[i], batch.pz[i], 1.0f);
+			ew::setLocalTransform(skeleton, binding.boneIndices[c], m);
+		}
+	}
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include "animation.h"
+
+namespace ew {
+	enum class QuatInterpolation {
+		NLERP = 0, //Normalized lerp. Fastest, slight speed variation within a key interval.
+		SLERP = 1 //Constant angular velocity. Polynomial approximation, no trig calls.
+	};
+	//Poses of one clip at many sample times, in SoA layout.
+	//Each component array is indexed [channel * stride + sample]. stride is numSamples padded for SIMD.
+	struct PoseBatch {
+		size_t numSamples = 0;
+		size_t numChannels = 0;
+		size_t stride = 0;
+		std::vector<float> px, py, pz; //Position
+		std::vector<float> rx, ry, rz, rw; //Rotation
+		std::vector<float> sx, sy, sz; //Scale
+		std::vector<float> scratch; //Next keys and lerp factors. Reused between calls.
+		std::vector<size_t> bakedFrames; //Frame of each sample when the clip uses its baked track
+	};
+
+	/// <summary>
+	/// Samples animClip at numSamples normalized times (0-1) into batch.
+	/// Samples the baked track instead of the keyframes when animClip.useBakedTrack is set.
+	/// Key lookup is scalar. Interpolation runs 8 samples at a time with AVX, or 4 with SSE, then scalar for the rest.
+	/// batch only reallocates when the sample or channel count grows.
+	/// </summary>
+	void sampleAnimationClipBatch(const ew::AnimationClip& animClip, const float* normalizedTimes, size_t numSamples, ew::PoseBatch* batch, ew::QuatInterpolation quatInterpolation = ew::QuatInterpolation::NLERP);
+	//Writes one sample of batch into the local transforms of skeleton
+	void applyPoseBatch(const ew::PoseBatch& batch, size_t sample, const ew::AnimationBinding& binding, ew::Skeleton* skeleton);
+}
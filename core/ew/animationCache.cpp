@@ -0,0 +1,339 @@
+#include "animationCache.h"
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace ew {
+	//File layout, all in native byte order:
+	//CacheHeader
+	//CacheBone * numBones
+	//CacheChannel * numChannels
+	//Per channel: position keys, rotation keys, scale keys (raw KeyFrame structs)
+	//Bone names, then channel names (not null terminated)
+	//Fixed size records come first so everything before the names stays 4 byte aligned.
+	const char ANIMATION_CACHE_MAGIC[4] = { 'E','W','A','C' };
+
+	struct CacheHeader {
+		char magic[4];
+		uint32_t version;
+		uint64_t sourceHash;
+		uint64_t fileSize;
+		uint32_t numBones;
+		uint32_t numChannels;
+		float duration;
+		int32_t ticksPerSecond;
+		//Catches caches written by a build where these structs have another size
+		uint32_t vec3KeySize;
+		uint32_t quatKeySize;
+	};
+	struct CacheBone {
+		int32_t parentIndex;
+		uint32_t nameLength;
+		glm::mat4 inverseBindPose;
+		glm::mat4 localTransform;
+	};
+	struct CacheChannel {
+		int32_t boneIndex;
+		uint32_t nameLength;
+		uint32_t numPositionKeys;
+		uint32_t numRotationKeys;
+		uint32_t numScaleKeys;
+	};
+
+	//Read-only view of a whole file. Unmapped on destruction.
+	class MappedFile {
+	public:
+		MappedFile(const char* filePath) {
+#ifdef _WIN32
+			m_file = CreateFileA(filePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+			if (m_file == INVALID_HANDLE_VALUE)
+				return;
+			LARGE_INTEGER fileSize;
+			if (!GetFileSizeEx(m_file, &fileSize) || fileSize.QuadPart == 0)
+				return;
+			m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+			if (m_mapping == NULL)
+				return;
+			void* view = MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+			if (view == NULL)
+				return;
+			m_data = (const uint8_t*)view;
+			m_size = (size_t)fileSize.QuadPart;
+#else
+			int fd = open(filePath, O_RDONLY);
+			if (fd < 0)
+				return;
+			struct stat fileStat;
+			if (fstat(fd, &fileStat) == 0 && fileStat.st_size > 0) {
+				void* view = mmap(NULL, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+				if (view != MAP_FAILED) {
+					m_data = (const uint8_t*)view;
+					m_size = (size_t)fileStat.st_size;
+				}
+			}
+			//The mapping stays valid after the descriptor is closed
+			close(fd);
+#endif
+		}
+		~MappedFile() {
+#ifdef _WIN32
+			if (m_data != nullptr)
+				UnmapViewOfFile(m_data);
+			if (m_mapping != NULL)
+				CloseHandle(m_mapping);
+			if (m_file != INVALID_HANDLE_VALUE)
+				CloseHandle(m_file);
+#else
+			if (m_data != nullptr)
+				munmap((void*)m_data, m_size);
+#endif
+		}
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		inline const uint8_t* getData() const { return m_data; }
+		inline size_t getSize() const { return m_size; }
+	private:
+		const uint8_t* m_data = nullptr;
+		size_t m_size = 0;
+#ifdef _WIN32
+		HANDLE m_file = INVALID_HANDLE_VALUE;
+		HANDLE m_mapping = NULL;
+#endif
+	};
+
+	//Bounds checked cursor over a mapped cache
+	class CacheReader {
+	public:
+		CacheReader(const uint8_t* data, size_t size) :m_data(data), m_size(size) {};
+		//Returns nullptr if fewer than numBytes remain
+		const uint8_t* read(size_t numBytes) {
+			if (numBytes > m_size - m_offset)
+				return nullptr;
+			const uint8_t* p = m_data + m_offset;
+			m_offset += numBytes;
+			return p;
+		}
+		//Copies count elements straight into dst
+		template <typename T>
+		bool readArray(std::vector<T>& dst, size_t count) {
+			const uint8_t* p = read(count * sizeof(T));
+			if (p == nullptr)
+				return false;
+			dst.resize(count);
+			if (count > 0) {
+				memcpy(dst.data(), p, count * sizeof(T));
+			}
+			return true;
+		}
+		bool readString(std::string& dst, size_t length) {
+			const uint8_t* p = read(length);
+			if (p == nullptr)
+				return false;
+			dst.assign((const char*)p, length);
+			return true;
+		}
+	private:
+		const uint8_t* m_data;
+		size_t m_size;
+		size_t m_offset = 0;
+	};
+
+	uint64_t hashFile(const char* filePath) {
+		MappedFile file(filePath);
+		const uint8_t* data = file.getData();
+		if (data == nullptr)
+			return 0;
+		uint64_t hash = 14695981039346656037ull;
+		const size_t size = file.getSize();
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= data[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	template <typename T>
+	static void writeArray(FILE* file, const std::vector<T>& src) {
+		if (!src.empty()) {
+			fwrite(src.data(), sizeof(T), src.size(), file);
+		}
+	}
+
+	bool writeAnimationCache(const ew::AnimatedSkeletonPackage& package, uint64_t sourceHash, const char* cachePath) {
+		const Skeleton& skeleton = package.skeleton;
+		const AnimationClip& animClip = package.animationClip;
+		if (package.binding.boneIndices.size() != animClip.bones.size()) {
+			printf("Animation cache %s not written: clip is not bound\n", cachePath);
+			return false;
+		}
+
+		CacheHeader header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, ANIMATION_CACHE_MAGIC, sizeof(header.magic));
+		header.version = ANIMATION_CACHE_VERSION;
+		header.sourceHash = sourceHash;
+		header.numBones = (uint32_t)skeleton.bones.size();
+		header.numChannels = (uint32_t)animClip.bones.size();
+		header.duration = animClip.duration;
+		header.ticksPerSecond = animClip.ticksPerSecond;
+		header.vec3KeySize = sizeof(Vec3KeyFrame);
+		header.quatKeySize = sizeof(QuatKeyFrame);
+		header.fileSize = sizeof(CacheHeader) + sizeof(CacheBone) * header.numBones + sizeof(CacheChannel) * header.numChannels;
+		for (const Bone& bone : skeleton.bones)
+		{
+			header.fileSize += bone.name.size();
+		}
+		for (const BoneAnimation& boneAnim : animClip.bones)
+		{
+			header.fileSize += boneAnim.positionKeyFrames.size() * sizeof(Vec3KeyFrame)
+				+ boneAnim.rotationKeyFrames.size() * sizeof(QuatKeyFrame)
+				+ boneAnim.scaleKeyFrames.size() * sizeof(Vec3KeyFrame)
+				+ boneAnim.name.size();
+		}
+
+		FILE* file = fopen(cachePath, "wb");
+		if (file == NULL) {
+			printf("Failed to write animation cache %s\n", cachePath);
+			return false;
+		}
+		fwrite(&header, sizeof(header), 1, file);
+		for (const Bone& bone : skeleton.bones)
+		{
+			CacheBone cacheBone;
+			cacheBone.parentIndex = bone.parentIndex;
+			cacheBone.nameLength = (uint32_t)bone.name.size();
+			cacheBone.inverseBindPose = bone.inverseBindPose;
+			cacheBone.localTransform = bone.localTransform;
+			fwrite(&cacheBone, sizeof(cacheBone), 1, file);
+		}
+		for (size_t i = 0; i < animClip.bones.size(); i++)
+		{
+			const BoneAnimation& boneAnim = animClip.bones[i];
+			CacheChannel channel;
+			channel.boneIndex = package.binding.boneIndices[i];
+			channel.nameLength = (uint32_t)boneAnim.name.size();
+			channel.numPositionKeys = (uint32_t)boneAnim.positionKeyFrames.size();
+			channel.numRotationKeys = (uint32_t)boneAnim.rotationKeyFrames.size();
+			channel.numScaleKeys = (uint32_t)boneAnim.scaleKeyFrames.size();
+			fwrite(&channel, sizeof(channel), 1, file);
+		}
+		for (const BoneAnimation& boneAnim : animClip.bones)
+		{
+			writeArray(file, boneAnim.positionKeyFrames);
+			writeArray(file, boneAnim.rotationKeyFrames);
+			writeArray(file, boneAnim.scaleKeyFrames);
+		}
+		for (const Bone& bone : skeleton.bones)
+		{
+			fwrite(bone.name.data(), 1, bone.name.size(), file);
+		}
+		for (const BoneAnimation& boneAnim : animClip.bones)
+		{
+			fwrite(boneAnim.name.data(), 1, boneAnim.name.size(), file);
+		}
+		bool ok = ftell(file) == (long)header.fileSize;
+		ok = fclose(file) == 0 && ok;
+		if (!ok) {
+			printf("Failed to write animation cache %s\n", cachePath);
+			remove(cachePath);
+		}
+		return ok;
+	}
+
+	bool readAnimationCache(const char* cachePath, uint64_t sourceHash, ew::AnimatedSkeletonPackage* package) {
+		MappedFile file(cachePath);
+		if (file.getData() == nullptr)
+			return false;
+		CacheReader reader(file.getData(), file.getSize());
+		const CacheHeader* header = (const CacheHeader*)reader.read(sizeof(CacheHeader));
+		if (header == nullptr
+			|| memcmp(header->magic, ANIMATION_CACHE_MAGIC, sizeof(header->magic)) != 0
+			|| header->version != ANIMATION_CACHE_VERSION
+			|| header->sourceHash != sourceHash
+			|| header->fileSize != file.getSize()
+			|| header->vec3KeySize != sizeof(Vec3KeyFrame)
+			|| header->quatKeySize != sizeof(QuatKeyFrame)) {
+			return false;
+		}
+
+		const CacheBone* cacheBones = (const CacheBone*)reader.read(sizeof(CacheBone) * header->numBones);
+		const CacheChannel* channels = (const CacheChannel*)reader.read(sizeof(CacheChannel) * header->numChannels);
+		if (cacheBones == nullptr || channels == nullptr)
+			return false;
+
+		AnimatedSkeletonPackage result;
+		Skeleton& skeleton = result.skeleton;
+		AnimationClip& animClip = result.animationClip;
+		animClip.duration = header->duration;
+		animClip.ticksPerSecond = header->ticksPerSecond;
+		animClip.bones.resize(header->numChannels);
+		result.binding.boneIndices.resize(header->numChannels);
+		for (uint32_t i = 0; i < header->numChannels; i++)
+		{
+			const CacheChannel& channel = channels[i];
+			if (channel.boneIndex < 0 || channel.boneIndex >= (int32_t)header->numBones)
+				return false;
+			result.binding.boneIndices[i] = channel.boneIndex;
+			BoneAnimation& boneAnim = animClip.bones[i];
+			if (!reader.readArray(boneAnim.positionKeyFrames, channel.numPositionKeys)
+				|| !reader.readArray(boneAnim.rotationKeyFrames, channel.numRotationKeys)
+				|| !reader.readArray(boneAnim.scaleKeyFrames, channel.numScaleKeys)) {
+				return false;
+			}
+		}
+		skeleton.bones.resize(header->numBones);
+		for (uint32_t i = 0; i < header->numBones; i++)
+		{
+			Bone& bone = skeleton.bones[i];
+			bone.parentIndex = cacheBones[i].parentIndex;
+			if (bone.parentIndex < -1 || bone.parentIndex >= (int32_t)i)
+				return false;
+			bone.inverseBindPose = cacheBones[i].inverseBindPose;
+			bone.localTransform = cacheBones[i].localTransform;
+			if (!reader.readString(bone.name, cacheBones[i].nameLength))
+				return false;
+		}
+		for (uint32_t i = 0; i < header->numChannels; i++)
+		{
+			if (!reader.readString(animClip.bones[i].name, channels[i].nameLength))
+				return false;
+		}
+		*package = std::move(result);
+		return true;
+	}
+
+	AnimatedSkeletonPackage loadAnimationFromFileCached(const char* filePath, const char* cachePath) {
+		std::string defaultCachePath;
+		if (cachePath == nullptr) {
+			defaultCachePath = std::string(filePath) + ".ewanim";
+			cachePath = defaultCachePath.c_str();
+		}
+		AnimatedSkeletonPackage package;
+		const uint64_t sourceHash = hashFile(filePath);
+		if (sourceHash == 0) {
+			printf("Failed to read file %s\n", filePath);
+			return package;
+		}
+		if (readAnimationCache(cachePath, sourceHash, &package)) {
+			return package;
+		}
+		printf("Rebuilding animation cache %s\n", cachePath);
+		package = loadAnimationFromFile(filePath);
+		if (!package.skeleton.bones.empty()) {
+			writeAnimationCache(package, sourceHash, cachePath);
+		}
+		return package;
+	}
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include "animation.h"
+#include <stdint.h>
+
+namespace ew {
+	//Bump when the layout of the cache or of any cached struct changes
+	const uint32_t ANIMATION_CACHE_VERSION = 1;
+
+	/// <summary>
+	/// Loads an AnimatedSkeletonPackage through a binary cache, skipping Assimp when the cache is current.
+	/// The cache is memory mapped and its arrays are copied out in bulk.
+	/// It is rebuilt from filePath when missing, of another version, or made from a different source file.
+	/// </summary>
+	/// <param name="filePath">Source .dae/.fbx</param>
+	/// <param name="cachePath">Cache file. Defaults to filePath + ".ewanim"</param>
+	AnimatedSkeletonPackage loadAnimationFromFileCached(const char* filePath, const char* cachePath = nullptr);
+
+	//FNV-1a 64 of the file contents. 0 if the file can't be read.
+	uint64_t hashFile(const char* filePath);
+	bool writeAnimationCache(const ew::AnimatedSkeletonPackage& package, uint64_t sourceHash, const char* cachePath);
+	//Returns false if the cache is missing, invalid, or was built from another source
+	bool readAnimationCache(const char* cachePath, uint64_t sourceHash, ew::AnimatedSkeletonPackage* package);
+}
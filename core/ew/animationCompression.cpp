@@ -0,0 +1,333 @@
+#include "animationCompression.h"
+#include <algorithm>
+#include <stdio.h>
+#include <math.h>
+
+namespace ew {
+	//Largest magnitude any of the 3 smallest components of a unit quaternion can have
+	const float SMALLEST_THREE_RANGE = 0.70710678f;
+	const float MAX_UINT16 = 65535.0f;
+	const float MAX_UINT15 = 32767.0f;
+
+	static inline float inverseLerp(float x, float y, float v) {
+		return (v - x) / (y - x);
+	}
+
+	static uint16_t quantizeUnorm16(float v) {
+		return (uint16_t)(glm::clamp(v, 0.0f, 1.0f) * MAX_UINT16 + 0.5f);
+	}
+
+	/// <summary>
+	/// Smallest-three quaternion encoding in 48 bits.
+	/// Each of the 3 smallest components gets 15 bits. The index of the dropped component
+	/// goes in the top bits of out[0] and out[1].
+	/// </summary>
+	static void encodeQuat(const glm::quat& rotation, uint16_t* out) {
+		glm::quat q = glm::normalize(rotation);
+		const float c[4] = { q.x, q.y, q.z, q.w };
+		int largest = 0;
+		for (int i = 1; i < 4; i++)
+		{
+			if (fabsf(c[i]) > fabsf(c[largest]))
+				largest = i;
+		}
+		//q and -q are the same rotation, so make the dropped component positive
+		const float sign = c[largest] < 0 ? -1.0f : 1.0f;
+		uint16_t smallest[3];
+		int j = 0;
+		for (int i = 0; i < 4; i++)
+		{
+			if (i == largest)
+				continue;
+			float v = glm::clamp(c[i] * sign / SMALLEST_THREE_RANGE * 0.5f + 0.5f, 0.0f, 1.0f);
+			smallest[j++] = (uint16_t)(v * MAX_UINT15 + 0.5f);
+		}
+		out[0] = smallest[0] | (uint16_t)((largest >> 1) << 15);
+		out[1] = smallest[1] | (uint16_t)((largest & 1) << 15);
+		out[2] = smallest[2];
+	}
+
+	static glm::quat decodeQuat(const uint16_t* in) {
+		const int largest = ((in[0] >> 15) << 1) | (in[1] >> 15);
+		float smallest[3];
+		for (int i = 0; i < 3; i++)
+		{
+			smallest[i] = ((in[i] & 0x7FFF) / MAX_UINT15 * 2.0f - 1.0f) * SMALLEST_THREE_RANGE;
+		}
+		float c[4];
+		int j = 0;
+		for (int i = 0; i < 4; i++)
+		{
+			c[i] = i == largest ? 0.0f : smallest[j++];
+		}
+		c[largest] = sqrtf(glm::max(0.0f, 1.0f - smallest[0] * smallest[0] - smallest[1] * smallest[1] - smallest[2] * smallest[2]));
+		return glm::quat(c[3], c[0], c[1], c[2]);
+	}
+
+	static glm::vec3 dequantizeVec3(const CompressedTrack& track, size_t key) {
+		const uint16_t* v = &track.keyValues[key * 3];
+		return track.rangeMin + track.rangeExtent * glm::vec3(v[0], v[1], v[2]) / MAX_UINT16;
+	}
+
+	static float positionError(const glm::vec3& a, const glm::vec3& b) {
+		return glm::length(a - b);
+	}
+	static float scaleError(const glm::vec3& a, const glm::vec3& b) {
+		glm::vec3 d = glm::abs(a - b);
+		return glm::max(d.x, glm::max(d.y, d.z));
+	}
+	static float rotationError(const glm::quat& a, const glm::quat& b) {
+		//Angle between the 2 rotations
+		float d = glm::min(fabsf(glm::dot(glm::normalize(a), glm::normalize(b))), 1.0f);
+		return 2.0f * acosf(d);
+	}
+
+	/// <summary>
+	/// Removes keys that can be rebuilt within tolerance by interpolating the keys kept around them.
+	/// A track whose keys all stay within tolerance of the first key collapses to that key.
+	/// </summary>
+	template<typename KeyFrameT, typename LerpFn, typename ErrorFn>
+	static std::vector<KeyFrameT> reduceKeyFrames(const std::vector<KeyFrameT>& keyFrames, float tolerance, LerpFn lerpFn, ErrorFn errorFn) {
+		const size_t numKeyFrames = keyFrames.size();
+		bool isConstant = true;
+		for (size_t i = 1; i < numKeyFrames && isConstant; i++)
+		{
+			isConstant = errorFn(keyFrames[0].value, keyFrames[i].value) <= tolerance;
+		}
+		if (isConstant) {
+			return std::vector<KeyFrameT>(keyFrames.begin(), keyFrames.begin() + glm::min<size_t>(numKeyFrames, 1));
+		}
+		std::vector<KeyFrameT> reduced;
+		reduced.push_back(keyFrames[0]);
+		size_t anchor = 0;
+		for (size_t candidate = 2; candidate < numKeyFrames; candidate++)
+		{
+			//Can every key between anchor and candidate be rebuilt from those 2?
+			bool fits = true;
+			for (size_t i = anchor + 1; i < candidate && fits; i++)
+			{
+				float t = inverseLerp(keyFrames[anchor].time, keyFrames[candidate].time, keyFrames[i].time);
+				fits = errorFn(lerpFn(keyFrames[anchor].value, keyFrames[candidate].value, t), keyFrames[i].value) <= tolerance;
+			}
+			if (!fits) {
+				anchor = candidate - 1;
+				reduced.push_back(keyFrames[anchor]);
+			}
+		}
+		reduced.push_back(keyFrames[numKeyFrames - 1]);
+		return reduced;
+	}
+
+	template<typename KeyFrameT>
+	static void quantizeKeyTimes(const std::vector<KeyFrameT>& keyFrames, float duration, CompressedTrack* track) {
+		if (keyFrames.size() <= 1)
+			return;
+		track->keyTimes.reserve(keyFrames.size());
+		for (size_t i = 0; i < keyFrames.size(); i++)
+		{
+			track->keyTimes.push_back(quantizeUnorm16(duration > 0 ? keyFrames[i].time / duration : 0.0f));
+		}
+	}
+
+	static CompressedTrack compressVec3Track(const std::vector<ew::Vec3KeyFrame>& keyFrames, float duration, float tolerance, float (*errorFn)(const glm::vec3&, const glm::vec3&)) {
+		std::vector<ew::Vec3KeyFrame> reduced = reduceKeyFrames(keyFrames, tolerance,
+			[](const glm::vec3& a, const glm::vec3& b, float t) { return glm::mix(a, b, t); }, errorFn);
+		CompressedTrack track;
+		if (reduced.empty())
+			return track;
+		glm::vec3 rangeMax = reduced[0].value;
+		track.rangeMin = reduced[0].value;
+		for (size_t i = 1; i < reduced.size(); i++)
+		{
+			track.rangeMin = glm::min(track.rangeMin, reduced[i].value);
+			rangeMax = glm::max(rangeMax, reduced[i].value);
+		}
+		track.rangeExtent = rangeMax - track.rangeMin;
+		quantizeKeyTimes(reduced, duration, &track);
+		track.keyValues.reserve(reduced.size() * 3);
+		for (size_t i = 0; i < reduced.size(); i++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				float extent = track.rangeExtent[c];
+				track.keyValues.push_back(extent > 0 ? quantizeUnorm16((reduced[i].value[c] - track.rangeMin[c]) / extent) : 0);
+			}
+		}
+		return track;
+	}
+
+	static CompressedTrack compressQuatTrack(const std::vector<ew::QuatKeyFrame>& keyFrames, float duration, float tolerance) {
+		std::vector<ew::QuatKeyFrame> reduced = reduceKeyFrames(keyFrames, tolerance,
+			[](const glm::quat& a, const glm::quat& b, float t) { return glm::slerp(a, b, t); }, rotationError);
+		CompressedTrack track;
+		quantizeKeyTimes(reduced, duration, &track);
+		track.keyValues.resize(reduced.size() * 3);
+		for (size_t i = 0; i < reduced.size(); i++)
+		{
+			encodeQuat(reduced[i].value, &track.keyValues[i * 3]);
+		}
+		return track;
+	}
+
+	/// <summary>
+	/// Same search as the uncompressed tracks: first key with time >= time,
+	/// trying the cached interval and the next one before a binary search.
+	/// </summary>
+	static size_t findNextKey(const std::vector<uint16_t>& keyTimes, float time, size_t* cursor) {
+		const size_t numKeys = keyTimes.size();
+		if (cursor != nullptr) {
+			size_t i = *cursor;
+			for (size_t step = 0; step < 2 && i < numKeys; step++, i++)
+			{
+				if (keyTimes[i] >= time && (i == 0 || keyTimes[i - 1] < time)) {
+					*cursor = i;
+					return i;
+				}
+			}
+		}
+		size_t i = std::lower_bound(keyTimes.begin(), keyTimes.end(), time,
+			[](uint16_t keyTime, float t) { return keyTime < t; }) - keyTimes.begin();
+		if (cursor != nullptr) {
+			*cursor = i;
+		}
+		return i;
+	}
+
+	static glm::vec3 sampleVec3Track(const CompressedTrack& track, float time, size_t* cursor, const glm::vec3& defaultValue) {
+		const size_t numKeys = track.keyValues.size() / 3;
+		if (numKeys == 0)
+			return defaultValue;
+		if (numKeys == 1)
+			return dequantizeVec3(track, 0);
+		size_t next = findNextKey(track.keyTimes, time, cursor);
+		if (next == 0)
+			return dequantizeVec3(track, 0);
+		if (next == numKeys)
+			return dequantizeVec3(track, numKeys - 1);
+		float t = inverseLerp(track.keyTimes[next - 1], track.keyTimes[next], time);
+		return glm::mix(dequantizeVec3(track, next - 1), dequantizeVec3(track, next), t);
+	}
+
+	static glm::quat sampleQuatTrack(const CompressedTrack& track, float time, size_t* cursor) {
+		const size_t numKeys = track.keyValues.size() / 3;
+		if (numKeys == 0)
+			return glm::quat(1, 0, 0, 0);
+		if (numKeys == 1)
+			return decodeQuat(&track.keyValues[0]);
+		size_t next = findNextKey(track.keyTimes, time, cursor);
+		if (next == 0)
+			return decodeQuat(&track.keyValues[0]);
+		if (next == numKeys)
+			return decodeQuat(&track.keyValues[(numKeys - 1) * 3]);
+		float t = inverseLerp(track.keyTimes[next - 1], track.keyTimes[next], time);
+		return glm::slerp(decodeQuat(&track.keyValues[(next - 1) * 3]), decodeQuat(&track.keyValues[next * 3]), t);
+	}
+
+	void sampleCompressedBoneAnimation(const ew::CompressedBoneAnimation& boneAnim, float time, float duration, ew::ChannelCursor* cursor, glm::vec3* position, glm::quat* rotation, glm::vec3* scale) {
+		//Key times are stored as 0-65535 over the clip duration
+		float quantizedTime = duration > 0 ? time / duration * MAX_UINT16 : 0.0f;
+		*position = sampleVec3Track(boneAnim.positionTrack, quantizedTime, cursor ? &cursor->positionKey : nullptr, glm::vec3(0));
+		*rotation = sampleQuatTrack(boneAnim.rotationTrack, quantizedTime, cursor ? &cursor->rotationKey : nullptr);
+		*scale = sampleVec3Track(boneAnim.scaleTrack, quantizedTime, cursor ? &cursor->scaleKey : nullptr, glm::vec3(1));
+	}
+
+	void updateSkeleton(ew::Skeleton* skeleton, const ew::CompressedAnimationClip* animClip, const ew::AnimationBinding& binding, float normalizedTime, ew::AnimationCursor* cursor) {
+		float time = animClip->duration * glm::clamp(normalizedTime, 0.0f, 1.0f);
+		if (cursor != nullptr && cursor->channels.size() != animClip->bones.size()) {
+			cursor->channels.assign(animClip->bones.size(), ChannelCursor());
+		}
+		for (size_t i = 0; i < animClip->bones.size(); i++)
+		{
+			glm::vec3 position, scale;
+			glm::quat rotation;
+			sampleCompressedBoneAnimation(animClip->bones[i], time, animClip->duration, cursor ? &cursor->channels[i] : nullptr, &position, &rotation, &scale);
+			glm::mat4 m = glm::translate(glm::mat4(1), position) * glm::toMat4(rotation);
+			ew::setLocalTransform(skeleton, binding.boneIndices[i], glm::scale(m, scale));
+		}
+	}
+
+	static size_t getTrackSize(const CompressedTrack& track) {
+		return (track.keyTimes.size() + track.keyValues.size()) * sizeof(uint16_t);
+	}
+
+	size_t getAnimationClipSize(const ew::AnimationClip& animClip) {
+		size_t size = sizeof(AnimationClip) + animClip.bones.size() * sizeof(BoneAnimation);
+		for (const BoneAnimation& boneAnim : animClip.bones)
+		{
+			size += boneAnim.name.size();
+			size += boneAnim.positionKeyFrames.size() * sizeof(Vec3KeyFrame);
+			size += boneAnim.rotationKeyFrames.size() * sizeof(QuatKeyFrame);
+			size += boneAnim.scaleKeyFrames.size() * sizeof(Vec3KeyFrame);
+		}
+		return size;
+	}
+
+	size_t getAnimationClipSize(const ew::CompressedAnimationClip& animClip) {
+		size_t size = sizeof(CompressedAnimationClip) + animClip.bones.size() * sizeof(CompressedBoneAnimation);
+		for (const CompressedBoneAnimation& boneAnim : animClip.bones)
+		{
+			size += boneAnim.name.size();
+			size += getTrackSize(boneAnim.positionTrack) + getTrackSize(boneAnim.rotationTrack) + getTrackSize(boneAnim.scaleTrack);
+		}
+		return size;
+	}
+
+	static void measureChannelError(const BoneAnimation& source, const CompressedBoneAnimation& compressed, float duration, AnimationCompressionReport* report) {
+		std::vector<float> sampleTimes;
+		for (const Vec3KeyFrame& key : source.positionKeyFrames) sampleTimes.push_back(key.time);
+		for (const QuatKeyFrame& key : source.rotationKeyFrames) sampleTimes.push_back(key.time);
+		for (const Vec3KeyFrame& key : source.scaleKeyFrames) sampleTimes.push_back(key.time);
+		for (float time : sampleTimes)
+		{
+			glm::vec3 sourcePos, sourceScale, compressedPos, compressedScale;
+			glm::quat sourceRot, compressedRot;
+			sampleBoneAnimation(source, time, nullptr, &sourcePos, &sourceRot, &sourceScale);
+			sampleCompressedBoneAnimation(compressed, time, duration, nullptr, &compressedPos, &compressedRot, &compressedScale);
+			report->maxPositionError = glm::max(report->maxPositionError, positionError(sourcePos, compressedPos));
+			report->maxRotationError = glm::max(report->maxRotationError, rotationError(sourceRot, compressedRot));
+			report->maxScaleError = glm::max(report->maxScaleError, scaleError(sourceScale, compressedScale));
+		}
+	}
+
+	CompressedAnimationClip compressAnimationClip(const ew::AnimationClip& animClip, const AnimationCompressionSettings& settings, AnimationCompressionReport* report) {
+		CompressedAnimationClip compressed;
+		compressed.duration = animClip.duration;
+		compressed.ticksPerSecond = animClip.ticksPerSecond;
+		compressed.bones.reserve(animClip.bones.size());
+		for (const BoneAnimation& boneAnim : animClip.bones)
+		{
+			CompressedBoneAnimation compressedAnim;
+			compressedAnim.name = boneAnim.name;
+			compressedAnim.positionTrack = compressVec3Track(boneAnim.positionKeyFrames, animClip.duration, settings.positionTolerance, positionError);
+			compressedAnim.rotationTrack = compressQuatTrack(boneAnim.rotationKeyFrames, animClip.duration, settings.rotationTolerance);
+			compressedAnim.scaleTrack = compressVec3Track(boneAnim.scaleKeyFrames, animClip.duration, settings.scaleTolerance, scaleError);
+			compressed.bones.push_back(compressedAnim);
+		}
+		if (report != nullptr) {
+			*report = AnimationCompressionReport();
+			report->sourceBytes = getAnimationClipSize(animClip);
+			report->compressedBytes = getAnimationClipSize(compressed);
+			for (size_t i = 0; i < animClip.bones.size(); i++)
+			{
+				const BoneAnimation& source = animClip.bones[i];
+				const CompressedBoneAnimation& result = compressed.bones[i];
+				report->sourceKeys += source.positionKeyFrames.size() + source.rotationKeyFrames.size() + source.scaleKeyFrames.size();
+				const CompressedTrack* tracks[3] = { &result.positionTrack, &result.rotationTrack, &result.scaleTrack };
+				for (const CompressedTrack* track : tracks)
+				{
+					report->compressedKeys += track->keyValues.size() / 3;
+					report->constantTracks += track->keyValues.size() == 3 ? 1 : 0;
+				}
+				measureChannelError(source, result, animClip.duration, report);
+			}
+		}
+		return compressed;
+	}
+
+	void printAnimationCompressionReport(const AnimationCompressionReport& report) {
+		printf("Animation compression: %zu -> %zu bytes (%.1f%%)\n", report.sourceBytes, report.compressedBytes,
+			report.sourceBytes > 0 ? 100.0f * report.compressedBytes / report.sourceBytes : 0.0f);
+		printf("   Keys: %zu -> %zu, constant tracks: %zu\n", report.sourceKeys, report.compressedKeys, report.constantTracks);
+		printf("   Max error: position %f, rotation %f rad, scale %f\n", report.maxPositionError, report.maxRotationError, report.maxScaleError);
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include "animation.h"
+#include <stdint.h>
+
+namespace ew {
+	//One compressed track. Every key stores 3 x uint16 values.
+	//Positions and scales are quantized to [rangeMin, rangeMin + rangeExtent].
+	//Rotations use smallest-three: the largest component is dropped and rebuilt from the other 3.
+	//A constant track has a single key and no time.
+	struct CompressedTrack {
+		std::vector<uint16_t> keyTimes; //0-65535 over the clip duration
+		std::vector<uint16_t> keyValues; //3 per key
+		glm::vec3 rangeMin = glm::vec3(0);
+		glm::vec3 rangeExtent = glm::vec3(0);
+	};
+	struct CompressedBoneAnimation {
+		std::string name;
+		CompressedTrack positionTrack;
+		CompressedTrack rotationTrack;
+		CompressedTrack scaleTrack;
+	};
+	//Compressed equivalent of AnimationClip. Channels keep the source order, so the source AnimationBinding applies.
+	struct CompressedAnimationClip {
+		float duration;
+		int ticksPerSecond;
+		std::vector<CompressedBoneAnimation> bones;
+	};
+
+	struct AnimationCompressionSettings {
+		//Keys that can be rebuilt by interpolating their neighbors within these errors are removed.
+		//Tracks whose keys all stay within them of the first key become constant.
+		float positionTolerance = 0.0005f; //Bone space units
+		float rotationTolerance = 0.0005f; //Radians
+		float scaleTolerance = 0.0005f;
+	};
+	struct AnimationCompressionReport {
+		size_t sourceBytes = 0;
+		size_t compressedBytes = 0;
+		size_t sourceKeys = 0;
+		size_t compressedKeys = 0;
+		size_t constantTracks = 0;
+		//Max bone space error measured at every source key
+		float maxPositionError = 0;
+		float maxRotationError = 0; //Radians
+		float maxScaleError = 0;
+	};
+
+	//Offline compressor. Optionally fills report with memory saved and max error.
+	CompressedAnimationClip compressAnimationClip(const ew::AnimationClip& animClip, const AnimationCompressionSettings& settings, AnimationCompressionReport* report = nullptr);
+	void printAnimationCompressionReport(const AnimationCompressionReport& report);
+
+	//Approximate heap + inline memory of a clip, including names
+	size_t getAnimationClipSize(const ew::AnimationClip& animClip);
+	size_t getAnimationClipSize(const ew::CompressedAnimationClip& animClip);
+
+	//Samples a compressed channel at time (in ticks). cursor is optional, as in sampleBoneAnimation.
+	void sampleCompressedBoneAnimation(const ew::CompressedBoneAnimation& boneAnim, float time, float duration, ew::ChannelCursor* cursor, glm::vec3* position, glm::quat* rotation, glm::vec3* scale);
+	void updateSkeleton(ew::Skeleton* skeleton, const ew::CompressedAnimationClip* animClip, const ew::AnimationBinding& binding, float time, ew::AnimationCursor* cursor = nullptr);
+}
@@ -0,0 +1,62 @@
+#include "animationLOD.h"
+
+namespace ew {
+	AnimationLODSettings defaultAnimationLODSettings() {
+		AnimationLODSettings settings;
+		settings.levels.resize(4);
+		settings.levels[0] = { 0.0f, 1, false };
+		settings.levels[1] = { 10.0f, 2, false };
+		settings.levels[2] = { 25.0f, 4, false };
+		settings.levels[3] = { 50.0f, 8, true };
+		return settings;
+	}
+
+	int selectAnimationLOD(const ew::AnimationLODSettings& settings, float distance) {
+		int lod = 0;
+		for (size_t i = 1; i < settings.levels.size(); i++)
+		{
+			if (distance < settings.levels[i].minDistance)
+				break;
+			lod = (int)i;
+		}
+		return lod;
+	}
+
+	int markOptionalBones(ew::Skeleton* skeleton, const std::vector<std::string>& namePatterns) {
+		const size_t numBones = skeleton->bones.size();
+		std::vector<bool> hasRequiredChild(numBones, false);
+		int numOptional = 0;
+		//Children come after parents, so walking backwards visits every child before its parent
+		for (size_t i = numBones; i-- > 0;)
+		{
+			Bone& bone = skeleton->bones[i];
+			bool matches = false;
+			for (const std::string& pattern : namePatterns)
+			{
+				if (bone.name.find(pattern) != std::string::npos) {
+					matches = true;
+					break;
+				}
+			}
+			bone.optional = matches && !hasRequiredChild[i];
+			if (bone.optional) {
+				numOptional++;
+			}
+			else if (bone.parentIndex != -1) {
+				hasRequiredChild[bone.parentIndex] = true;
+			}
+		}
+		return numOptional;
+	}
+
+	int countRequiredChannels(const ew::Skeleton& skeleton, const ew::AnimationBinding& binding) {
+		int count = 0;
+		for (int boneIndex : binding.boneIndices)
+		{
+			if (!skeleton.bones[boneIndex].optional) {
+				count++;
+			}
+		}
+		return count;
+	}
+}
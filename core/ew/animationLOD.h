@@ -0,0 +1,37 @@
+#pragma once
+#include "animation.h"
+
+namespace ew {
+	struct AnimationLODLevel {
+		float minDistance = 0.0f; //Used from this distance to the viewer up to the next level's minDistance
+		int updateInterval = 1; //Frames per sample. Frames in between interpolate world matrices.
+		bool skipOptionalBones = false;
+	};
+	//Levels sorted by increasing minDistance. No levels = every instance updates at full detail.
+	struct AnimationLODSettings {
+		std::vector<AnimationLODLevel> levels;
+	};
+	struct AnimationLODStats {
+		std::vector<int> instancesPerLevel;
+		int sampledInstances = 0; //Instances that sampled and solved FK this update
+		int sampledChannels = 0;
+		//Largest bone position error against a full detail update, in model units.
+		//Only measured when error measurement is enabled.
+		float maxPositionError = 0.0f;
+	};
+
+	//Full rate near the viewer, then every 2nd and every 4th frame, then every 8th without detail bones
+	AnimationLODSettings defaultAnimationLODSettings();
+	//Index of the level used at distance. 0 if settings has no levels.
+	int selectAnimationLOD(const ew::AnimationLODSettings& settings, float distance);
+
+	/// <summary>
+	/// Marks bones as optional when their name contains one of namePatterns.
+	/// A bone is only marked if all of its children are too, so optional bones always form
+	/// whole subtrees at the leaves and skipping them never freezes a bone that has animated children.
+	/// Returns the number of optional bones.
+	/// </summary>
+	int markOptionalBones(ew::Skeleton* skeleton, const std::vector<std::string>& namePatterns);
+	//Number of channels that drive a non-optional bone
+	int countRequiredChannels(const ew::Skeleton& skeleton, const ew::AnimationBinding& binding);
+}
@@ -0,0 +1,226 @@
+#include "animationLibrary.h"
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+#include <string.h>
+#include <math.h>
+#include <stdio.h>
+
+namespace ew {
+	//FNV-1a 64
+	static uint64_t hashBytes(const void* data, size_t size, uint64_t hash) {
+		const unsigned char* bytes = (const unsigned char*)data;
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	template <typename T>
+	static uint64_t hashKeyFrames(const std::vector<T>& keyFrames, uint64_t hash) {
+		size_t count = keyFrames.size();
+		hash = hashBytes(&count, sizeof(count), hash);
+		return keyFrames.empty() ? hash : hashBytes(keyFrames.data(), sizeof(T) * count, hash);
+	}
+
+	static uint64_t hashChannel(const ew::BoneAnimation& channel) {
+		uint64_t hash = hashBytes(channel.name.data(), channel.name.size(), 14695981039346656037ull);
+		hash = hashKeyFrames(channel.positionKeyFrames, hash);
+		hash = hashKeyFrames(channel.rotationKeyFrames, hash);
+		return hashKeyFrames(channel.scaleKeyFrames, hash);
+	}
+
+	template <typename T>
+	static bool keyFramesEqual(const std::vector<T>& a, const std::vector<T>& b) {
+		return a.size() == b.size() && (a.empty() || memcmp(a.data(), b.data(), sizeof(T) * a.size()) == 0);
+	}
+
+	static bool channelsEqual(const ew::BoneAnimation& a, const ew::BoneAnimation& b) {
+		return a.name == b.name
+			&& keyFramesEqual(a.positionKeyFrames, b.positionKeyFrames)
+			&& keyFramesEqual(a.rotationKeyFrames, b.rotationKeyFrames)
+			&& keyFramesEqual(a.scaleKeyFrames, b.scaleKeyFrames);
+	}
+
+	//A track whose keys all hold the same value samples the same with only its first key.
+	//Collapsing them lets constant tracks of clips with different lengths share storage.
+	template <typename T>
+	static void collapseConstantTrack(std::vector<T>& keyFrames) {
+		for (size_t i = 1; i < keyFrames.size(); i++)
+		{
+			if (memcmp(&keyFrames[i].value, &keyFrames[0].value, sizeof(keyFrames[0].value)) != 0)
+				return;
+		}
+		if (keyFrames.size() > 1) {
+			keyFrames.resize(1);
+		}
+	}
+
+	static bool matricesNearlyEqual(const glm::mat4& a, const glm::mat4& b, float epsilon) {
+		for (int c = 0; c < 4; c++)
+		{
+			for (int r = 0; r < 4; r++)
+			{
+				if (fabsf(a[c][r] - b[c][r]) > epsilon)
+					return false;
+			}
+		}
+		return true;
+	}
+
+	//Same bones in the same order with the same parents and bind pose.
+	//Rigs that share names but were bound with different proportions would skin each other's meshes wrong.
+	static bool skeletonsCompatible(const ew::Skeleton& a, const ew::Skeleton& b) {
+		const float epsilon = 1e-4f;
+		if (a.bones.size() != b.bones.size())
+			return false;
+		for (size_t i = 0; i < a.bones.size(); i++)
+		{
+			const ew::Bone& boneA = a.bones[i];
+			const ew::Bone& boneB = b.bones[i];
+			if (boneA.parentIndex != boneB.parentIndex || boneA.name != boneB.name)
+				return false;
+			if (!matricesNearlyEqual(boneA.localTransform, boneB.localTransform, epsilon)
+				|| !matricesNearlyEqual(boneA.inverseBindPose, boneB.inverseBindPose, epsilon))
+				return false;
+		}
+		return true;
+	}
+
+	//"assets/Dancing.dae" -> "Dancing"
+	static std::string getFileStem(const char* filePath) {
+		std::string path(filePath);
+		size_t start = path.find_last_of("/\\");
+		start = start == std::string::npos ? 0 : start + 1;
+		size_t end = path.find_last_of('.');
+		if (end == std::string::npos || end < start) {
+			end = path.size();
+		}
+		return path.substr(start, end - start);
+	}
+
+	int AnimationLibrary::loadFile(const char* filePath) {
+		Assimp::Importer importer;
+		const aiScene* aiScene = importer.ReadFile(filePath, aiProcess_PopulateArmatureData);
+		if (aiScene == NULL) {
+			printf("Failed to load file %s\n", filePath);
+			return -1;
+		}
+		if (!aiScene->HasAnimations()) {
+			printf("File does not contain animations %s\n", filePath);
+			return -1;
+		}
+		const int skeletonIndex = addSkeleton(loadSkeleton(aiScene));
+		const Skeleton& skeleton = m_skeletons[skeletonIndex];
+		const std::string fileStem = getFileStem(filePath);
+		std::unordered_map<std::string, int> boneIndexMap;
+		boneIndexMap.reserve(skeleton.bones.size());
+		for (size_t i = 0; i < skeleton.bones.size(); i++)
+		{
+			boneIndexMap.emplace(skeleton.bones[i].name, (int)i);
+		}
+
+		for (size_t a = 0; a < aiScene->mNumAnimations; a++)
+		{
+			const aiAnimation* aiAnim = aiScene->mAnimations[a];
+			LibraryClip clip;
+			clip.name = fileStem + "/" + (aiAnim->mName.length > 0 ? std::string(aiAnim->mName.C_Str()) : std::to_string(a));
+			clip.duration = (float)aiAnim->mDuration;
+			clip.ticksPerSecond = (int)aiAnim->mTicksPerSecond;
+			clip.skeletonIndex = skeletonIndex;
+			clip.channels.reserve(aiAnim->mNumChannels);
+			clip.binding.boneIndices.reserve(aiAnim->mNumChannels);
+			for (size_t i = 0; i < aiAnim->mNumChannels; i++)
+			{
+				BoneAnimation channel = loadBoneAnimation(aiAnim->mChannels[i]);
+				auto it = boneIndexMap.find(channel.name);
+				if (it == boneIndexMap.end()) {
+					printf("Animation channel %s has no matching bone\n", channel.name.c_str());
+					continue;
+				}
+				clip.binding.boneIndices.push_back(it->second);
+				clip.channels.push_back(addChannel(std::move(channel)));
+			}
+			const int clipIndex = (int)m_clips.size();
+			addClipName(clip.name, clipIndex);
+			m_clips.push_back(std::move(clip));
+		}
+		if (aiScene->mNumAnimations == 1) {
+			addClipName(fileStem, (int)m_clips.size() - 1);
+		}
+		return (int)aiScene->mNumAnimations;
+	}
+
+	int AnimationLibrary::addSkeleton(ew::Skeleton&& skeleton) {
+		for (size_t i = 0; i < m_skeletons.size(); i++)
+		{
+			if (skeletonsCompatible(m_skeletons[i], skeleton))
+				return (int)i;
+		}
+		m_skeletons.push_back(std::move(skeleton));
+		return (int)m_skeletons.size() - 1;
+	}
+
+	int AnimationLibrary::addChannel(ew::BoneAnimation&& channel) {
+		collapseConstantTrack(channel.positionKeyFrames);
+		collapseConstantTrack(channel.rotationKeyFrames);
+		collapseConstantTrack(channel.scaleKeyFrames);
+		const uint64_t hash = hashChannel(channel);
+		auto range = m_channelHashes.equal_range(hash);
+		for (auto it = range.first; it != range.second; ++it)
+		{
+			if (channelsEqual(m_channels[it->second], channel)) {
+				m_numSharedChannels++;
+				return it->second;
+			}
+		}
+		const int channelIndex = (int)m_channels.size();
+		m_channels.push_back(std::move(channel));
+		m_channelHashes.emplace(hash, channelIndex);
+		return channelIndex;
+	}
+
+	void AnimationLibrary::addClipName(const std::string& name, int clipIndex) {
+		if (!m_clipIndices.emplace(name, clipIndex).second) {
+			printf("Animation clip name %s is already taken, use its index %d\n", name.c_str(), clipIndex);
+		}
+	}
+
+	int AnimationLibrary::findClip(const std::string& name) const {
+		auto it = m_clipIndices.find(name);
+		return it == m_clipIndices.end() ? -1 : it->second;
+	}
+
+	void AnimationLibrary::updateSkeleton(ew::Skeleton* skeleton, int clipIndex, float normalizedTime, ew::AnimationCursor* cursor) const {
+		const LibraryClip& clip = m_clips[clipIndex];
+		const float time = clip.duration * glm::clamp(normalizedTime, 0.0f, 1.0f);
+		if (cursor != nullptr && cursor->channels.size() != clip.channels.size()) {
+			cursor->channels.assign(clip.channels.size(), ChannelCursor());
+		}
+		for (size_t i = 0; i < clip.channels.size(); i++)
+		{
+			glm::vec3 position, scale;
+			glm::quat rotation;
+			sampleBoneAnimation(m_channels[clip.channels[i]], time, cursor ? &cursor->channels[i] : nullptr, &position, &rotation, &scale);
+			glm::mat4 localTransform = glm::translate(glm::mat4(1), position) * glm::toMat4(rotation);
+			ew::setLocalTransform(skeleton, clip.binding.boneIndices[i], glm::scale(localTransform, scale));
+		}
+	}
+
+	ew::AnimatedSkeletonPackage AnimationLibrary::makePackage(int clipIndex) const {
+		const LibraryClip& clip = m_clips[clipIndex];
+		AnimatedSkeletonPackage package;
+		package.skeleton = m_skeletons[clip.skeletonIndex];
+		package.animationClip.duration = clip.duration;
+		package.animationClip.ticksPerSecond = clip.ticksPerSecond;
+		package.animationClip.bones.reserve(clip.channels.size());
+		for (int channelIndex : clip.channels)
+		{
+			package.animationClip.bones.push_back(m_channels[channelIndex]);
+		}
+		package.binding = clip.binding;
+		return package;
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include "animation.h"
+#include <unordered_map>
+#include <stdint.h>
+
+namespace ew {
+	//A clip in an AnimationLibrary. Channels live in the library's shared channel pool.
+	struct LibraryClip {
+		std::string name;
+		float duration;
+		int ticksPerSecond;
+		int skeletonIndex;
+		std::vector<int> channels; //Channel pool index of each channel
+		ew::AnimationBinding binding; //channels[i] drives bone binding.boneIndices[i] of the clip's skeleton
+	};
+
+	/// <summary>
+	/// Every animation of any number of files, sharing skeletons and identical channels.
+	/// Files whose skeletons have the same bone names, parents and bind pose share the first one loaded.
+	/// Channels with the same bone name and keys, such as constant bind pose tracks, are stored once.
+	/// Clips are named "file/animation", with the file name stripped of its folder and extension.
+	/// A file with a single animation is also registered under just its file name.
+	/// </summary>
+	class AnimationLibrary {
+	public:
+		//Imports every animation in filePath. Returns the number of clips added, or -1 on failure.
+		int loadFile(const char* filePath);
+
+		inline size_t getNumClips() const { return m_clips.size(); }
+		inline const ew::LibraryClip& getClip(int clipIndex) const { return m_clips[clipIndex]; }
+		//Returns -1 if no clip has this name
+		int findClip(const std::string& name) const;
+
+		inline size_t getNumSkeletons() const { return m_skeletons.size(); }
+		inline const ew::Skeleton& getSkeleton(int skeletonIndex) const { return m_skeletons[skeletonIndex]; }
+		inline const ew::Skeleton& getClipSkeleton(int clipIndex) const { return m_skeletons[m_clips[clipIndex].skeletonIndex]; }
+
+		inline size_t getNumChannels() const { return m_channels.size(); }
+		inline const ew::BoneAnimation& getChannel(int channelIndex) const { return m_channels[channelIndex]; }
+		//Channels that were found already in the pool instead of being added
+		inline size_t getNumSharedChannels() const { return m_numSharedChannels; }
+
+		//skeleton must have the bones of the clip's skeleton
+		void updateSkeleton(ew::Skeleton* skeleton, int clipIndex, float normalizedTime, ew::AnimationCursor* cursor = nullptr) const;
+		//Standalone copy of a clip and its skeleton, for code that takes an AnimatedSkeletonPackage
+		ew::AnimatedSkeletonPackage makePackage(int clipIndex) const;
+	private:
+		int addSkeleton(ew::Skeleton&& skeleton);
+		int addChannel(ew::BoneAnimation&& channel);
+		void addClipName(const std::string& name, int clipIndex);
+
+		std::vector<ew::Skeleton> m_skeletons;
+		std::vector<ew::LibraryClip> m_clips;
+		std::vector<ew::BoneAnimation> m_channels;
+		std::unordered_map<std::string, int> m_clipIndices;
+		std::unordered_multimap<uint64_t, int> m_channelHashes; //Content hash -> channel pool index
+		size_t m_numSharedChannels = 0;
+	};
+}
@@ -0,0 +1,433 @@
+#include "animationStreaming.h"
+#include <string.h>
+#include <algorithm>
+#include <unordered_map>
+#include <sys/stat.h>
+
+namespace ew {
+	//File layout, all in native byte order:
+	//StreamHeader
+	//Per channel: uint32 name length, then the name (not null terminated)
+	//uint64 file offset * numBlocks
+	//Per block: positions, rotations, scales of each frame, indexed [frame * numChannels + channel]
+	//Block b holds frames b * framesPerBlock to b * framesPerBlock + framesPerBlock, or up to the last frame.
+	const char STREAMING_CLIP_MAGIC[4] = { 'E','W','S','C' };
+
+	//fseek and ftell take a long, which is 32 bits on Windows, so clips past 2GB need the 64-bit versions
+	static int seekFile(FILE* file, uint64_t offset, int origin) {
+#ifdef _MSC_VER
+		return _fseeki64(file, (__int64)offset, origin);
+#else
+		return fseeko(file, (off_t)offset, origin);
+#endif
+	}
+
+	static uint64_t tellFile(FILE* file) {
+#ifdef _MSC_VER
+		return (uint64_t)_ftelli64(file);
+#else
+		return (uint64_t)ftello(file);
+#endif
+	}
+
+	struct StreamHeader {
+		char magic[4];
+		uint32_t version;
+		uint64_t fileSize;
+		uint32_t numChannels;
+		uint32_t numFrames;
+		uint32_t framesPerBlock;
+		uint32_t numBlocks;
+		float duration;
+		int32_t ticksPerSecond;
+		float ticksPerFrame;
+		//Catches files written by a build where these types have another size
+		uint32_t vec3Size;
+		uint32_t quatSize;
+	};
+
+	static int getNumBlocks(int numFrames, int framesPerBlock) {
+		//The last frame only ends an interval, so it never starts a block
+		return glm::max((numFrames - 2) / framesPerBlock + 1, 1);
+	}
+
+	static int getBlockFrames(int block, int numFrames, int framesPerBlock) {
+		return glm::min(framesPerBlock + 1, numFrames - block * framesPerBlock);
+	}
+
+	static size_t getFrameBytes(size_t numChannels) {
+		return numChannels * (sizeof(glm::vec3) * 2 + sizeof(glm::quat));
+	}
+
+	bool isStreamingClipStale(const char* filePath, const char* sourcePath) {
+		struct stat fileStat, sourceStat;
+		if (stat(filePath, &fileStat) != 0)
+			return true;
+		return stat(sourcePath, &sourceStat) == 0 && sourceStat.st_mtime > fileStat.st_mtime;
+	}
+
+	bool writeStreamingClip(const ew::AnimationClip& animClip, float sampleRate, const char* filePath, int framesPerBlock) {
+		framesPerBlock = glm::max(framesPerBlock, 1);
+		//Same frame spacing as bakeAnimationClip
+		const float durationSeconds = animClip.duration / ew::getTicksPerSecond(animClip);
+		const int numFrames = glm::max((int)ceilf(durationSeconds * sampleRate), 1) + 1;
+		const size_t numChannels = animClip.bones.size();
+
+		StreamHeader header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, STREAMING_CLIP_MAGIC, sizeof(header.magic));
+		header.version = STREAMING_CLIP_VERSION;
+		header.numChannels = (uint32_t)numChannels;
+		header.numFrames = (uint32_t)numFrames;
+		header.framesPerBlock = (uint32_t)framesPerBlock;
+		header.numBlocks = (uint32_t)getNumBlocks(numFrames, framesPerBlock);
+		header.duration = animClip.duration;
+		header.ticksPerSecond = animClip.ticksPerSecond;
+		header.ticksPerFrame = animClip.duration / (numFrames - 1);
+		header.vec3Size = sizeof(glm::vec3);
+		header.quatSize = sizeof(glm::quat);
+
+		uint64_t offset = sizeof(StreamHeader) + sizeof(uint64_t) * header.numBlocks;
+		for (const BoneAnimation& boneAnim : animClip.bones)
+		{
+			offset += sizeof(uint32_t) + boneAnim.name.size();
+		}
+		std::vector<uint64_t> blockOffsets(header.numBlocks);
+		for (uint32_t b = 0; b < header.numBlocks; b++)
+		{
+			blockOffsets[b] = offset;
+			offset += getBlockFrames(b, numFrames, framesPerBlock) * getFrameBytes(numChannels);
+		}
+		header.fileSize = offset;
+
+		FILE* file = fopen(filePath, "wb");
+		if (file == NULL) {
+			printf("Failed to write streaming clip %s\n", filePath);
+			return false;
+		}
+		fwrite(&header, sizeof(header), 1, file);
+		for (const BoneAnimation& boneAnim : animClip.bones)
+		{
+			uint32_t nameLength = (uint32_t)boneAnim.name.size();
+			fwrite(&nameLength, sizeof(nameLength), 1, file);
+			fwrite(boneAnim.name.data(), 1, nameLength, file);
+		}
+		fwrite(blockOffsets.data(), sizeof(uint64_t), blockOffsets.size(), file);
+
+		const size_t maxBlockValues = (size_t)(framesPerBlock + 1) * numChannels;
+		std::vector<glm::vec3> positions(maxBlockValues);
+		std::vector<glm::quat> rotations(maxBlockValues);
+		std::vector<glm::vec3> scales(maxBlockValues);
+		std::vector<glm::quat> prevRotations(numChannels);
+		std::vector<ChannelCursor> cursors(numChannels);
+		for (uint32_t b = 0; b < header.numBlocks; b++)
+		{
+			const int blockFrames = getBlockFrames(b, numFrames, framesPerBlock);
+			for (int f = 0; f < blockFrames; f++)
+			{
+				const int frame = b * framesPerBlock + f;
+				const float time = frame == numFrames - 1 ? animClip.duration : frame * header.ticksPerFrame;
+				for (size_t c = 0; c < numChannels; c++)
+				{
+					const size_t i = f * numChannels + c;
+					sampleBoneAnimation(animClip.bones[c], time, &cursors[c], &positions[i], &rotations[i], &scales[i]);
+					//Keep consecutive frames in the same hemisphere, across blocks too
+					if (frame > 0 && glm::dot(rotations[i], prevRotations[c]) < 0) {
+						rotations[i] = -rotations[i];
+					}
+					prevRotations[c] = rotations[i];
+				}
+			}
+			const size_t count = blockFrames * numChannels;
+			fwrite(positions.data(), sizeof(glm::vec3), count, file);
+			fwrite(rotations.data(), sizeof(glm::quat), count, file);
+			fwrite(scales.data(), sizeof(glm::vec3), count, file);
+		}
+		bool ok = tellFile(file) == header.fileSize;
+		ok = fclose(file) == 0 && ok;
+		if (!ok) {
+			printf("Failed to write streaming clip %s\n", filePath);
+			remove(filePath);
+		}
+		return ok;
+	}
+
+	StreamingClipSampler::~StreamingClipSampler() {
+		close();
+	}
+
+	bool StreamingClipSampler::open(const char* filePath, int windowBlocks, bool loop) {
+		close();
+		FILE* file = fopen(filePath, "rb");
+		if (file == NULL) {
+			printf("Failed to open streaming clip %s\n", filePath);
+			return false;
+		}
+		seekFile(file, 0, SEEK_END);
+		const uint64_t fileBytes = tellFile(file);
+		seekFile(file, 0, SEEK_SET);
+
+		StreamHeader header;
+		bool ok = fread(&header, sizeof(header), 1, file) == 1
+			&& memcmp(header.magic, STREAMING_CLIP_MAGIC, sizeof(header.magic)) == 0
+			&& header.version == STREAMING_CLIP_VERSION
+			&& header.fileSize == fileBytes
+			&& header.vec3Size == sizeof(glm::vec3)
+			&& header.quatSize == sizeof(glm::quat)
+			&& header.numFrames >= 2
+			&& header.framesPerBlock > 0
+			&& header.numBlocks == (uint32_t)getNumBlocks(header.numFrames, header.framesPerBlock);
+		std::vector<std::string> channelNames;
+		for (uint32_t c = 0; ok && c < header.numChannels; c++)
+		{
+			uint32_t nameLength;
+			ok = fread(&nameLength, sizeof(nameLength), 1, file) == 1 && nameLength <= fileBytes;
+			if (ok) {
+				std::string name(nameLength, '\0');
+				ok = fread(&name[0], 1, nameLength, file) == nameLength;
+				channelNames.push_back(std::move(name));
+			}
+		}
+		std::vector<uint64_t> blockOffsets(ok ? header.numBlocks : 0);
+		ok = ok && fread(blockOffsets.data(), sizeof(uint64_t), blockOffsets.size(), file) == blockOffsets.size();
+		for (uint32_t b = 0; ok && b < header.numBlocks; b++)
+		{
+			const uint64_t blockBytes = getBlockFrames(b, header.numFrames, header.framesPerBlock) * getFrameBytes(header.numChannels);
+			ok = blockOffsets[b] + blockBytes <= fileBytes;
+		}
+		if (!ok) {
+			printf("Invalid streaming clip %s\n", filePath);
+			fclose(file);
+			return false;
+		}
+
+		m_file = file;
+		m_channelNames = std::move(channelNames);
+		m_blockOffsets = std::move(blockOffsets);
+		m_duration = header.duration;
+		m_ticksPerSecond = header.ticksPerSecond;
+		m_ticksPerFrame = header.ticksPerFrame;
+		m_numFrames = header.numFrames;
+		m_framesPerBlock = header.framesPerBlock;
+		m_loop = loop;
+		m_fileBytes = fileBytes;
+
+		//All block memory is allocated here and reused for the life of the sampler
+		const size_t maxBlockValues = (size_t)getBlockFrames(0, m_numFrames, m_framesPerBlock) * m_channelNames.size();
+		m_slots.resize(glm::clamp(windowBlocks, 1, (int)header.numBlocks));
+		for (BlockSlot& slot : m_slots)
+		{
+			slot.positions.resize(maxBlockValues);
+			slot.rotations.resize(maxBlockValues);
+			slot.scales.resize(maxBlockValues);
+		}
+		m_playheadBlock = 0;
+		m_shutdown = false;
+		m_blocksLoaded = 0;
+		m_stalls = 0;
+		m_loader = std::thread(&StreamingClipSampler::loaderLoop, this);
+		return true;
+	}
+
+	void StreamingClipSampler::close() {
+		if (m_loader.joinable()) {
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_shutdown = true;
+			}
+			m_workCondition.notify_all();
+			m_loader.join();
+		}
+		if (m_file != nullptr) {
+			fclose(m_file);
+			m_file = nullptr;
+		}
+		m_slots.clear();
+		m_channelNames.clear();
+		m_blockOffsets.clear();
+	}
+
+	ew::AnimationBinding StreamingClipSampler::bind(const ew::Skeleton& skeleton) const {
+		std::unordered_map<std::string, int> boneIndexMap;
+		boneIndexMap.reserve(skeleton.bones.size());
+		for (size_t i = 0; i < skeleton.bones.size(); i++)
+		{
+			boneIndexMap.emplace(skeleton.bones[i].name, (int)i);
+		}
+		AnimationBinding binding;
+		binding.boneIndices.resize(m_channelNames.size());
+		for (size_t c = 0; c < m_channelNames.size(); c++)
+		{
+			auto it = boneIndexMap.find(m_channelNames[c]);
+			if (it == boneIndexMap.end()) {
+				printf("Animation channel %s does not match any bone. Skipping.\n", m_channelNames[c].c_str());
+			}
+			binding.boneIndices[c] = it == boneIndexMap.end() ? -1 : it->second;
+		}
+		return binding;
+	}
+
+	int StreamingClipSampler::findBlock(float normalizedTime, int* frame, float* t) const {
+		const float time = glm::clamp(normalizedTime, 0.0f, 1.0f) * m_duration;
+		const float frameTime = m_ticksPerFrame > 0 ? time / m_ticksPerFrame : 0.0f;
+		*frame = glm::min((int)frameTime, m_numFrames - 2);
+		*t = glm::clamp(frameTime - *frame, 0.0f, 1.0f);
+		return *frame / m_framesPerBlock;
+	}
+
+	//Call with m_mutex held
+	void StreamingClipSampler::setPlayheadBlock(int block) {
+		if (block != m_playheadBlock) {
+			m_playheadBlock = block;
+			m_workCondition.notify_one();
+		}
+	}
+
+	//Call with m_mutex held
+	bool StreamingClipSampler::isWanted(int block) const {
+		const int numBlocks = (int)m_blockOffsets.size();
+		int ahead = block - m_playheadBlock;
+		if (m_loop && ahead < 0) {
+			ahead += numBlocks;
+		}
+		return ahead >= 0 && ahead < (int)m_slots.size();
+	}
+
+	void StreamingClipSampler::seek(float normalizedTime) {
+		if (!isOpen())
+			return;
+		int frame;
+		float t;
+		const int block = findBlock(normalizedTime, &frame, &t);
+		std::lock_guard<std::mutex> lock(m_mutex);
+		setPlayheadBlock(block);
+	}
+
+	void StreamingClipSampler::updateSkeleton(ew::Skeleton* skeleton, const ew::AnimationBinding& binding, float normalizedTime) {
+		if (!isOpen())
+			return;
+		int frame;
+		float t;
+		const int block = findBlock(normalizedTime, &frame, &t);
+		const BlockSlot* slot = nullptr;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			setPlayheadBlock(block);
+			auto findReady = [&] {
+				for (const BlockSlot& s : m_slots)
+				{
+					if (s.block == block && !s.loading) {
+						slot = &s;
+						return true;
+					}
+				}
+				return false;
+			};
+			if (!findReady()) {
+				m_stalls++;
+				m_readyCondition.wait(lock, findReady);
+			}
+		}
+		//The loader never evicts the playhead block, so the slot can be read unlocked
+		const size_t numChannels = m_channelNames.size();
+		const size_t frameStart = (size_t)(frame - block * m_framesPerBlock) * numChannels;
+		for (size_t c = 0; c < numChannels; c++)
+		{
+			const int boneIndex = binding.boneIndices[c];
+			if (boneIndex < 0)
+				continue;
+			const size_t a = frameStart + c;
+			const size_t b = a + numChannels;
+			const glm::vec3 position = glm::mix(slot->positions[a], slot->positions[b], t);
+			const glm::vec3 scale = glm::mix(slot->scales[a], slot->scales[b], t);
+			//Frames share a hemisphere, so a normalized lerp needs no sign check
+			const glm::quat& qa = slot->rotations[a];
+			const glm::quat& qb = slot->rotations[b];
+			const glm::quat rotation = glm::normalize(glm::quat(
+				qa.w + (qb.w - qa.w) * t, qa.x + (qb.x - qa.x) * t, qa.y + (qb.y - qa.y) * t, qa.z + (qb.z - qa.z) * t));
+			setLocalTransform(skeleton, boneIndex, glm::scale(glm::translate(glm::mat4(1), position) * glm::toMat4(rotation), scale));
+		}
+	}
+
+	StreamingClipStats StreamingClipSampler::getStats() {
+		StreamingClipStats stats;
+		std::lock_guard<std::mutex> lock(m_mutex);
+		stats.numBlocks = (int)m_blockOffsets.size();
+		stats.fileBytes = m_fileBytes;
+		stats.blocksLoaded = m_blocksLoaded;
+		stats.stalls = m_stalls;
+		for (const BlockSlot& slot : m_slots)
+		{
+			if (slot.block >= 0 && !slot.loading) {
+				stats.residentBlocks++;
+			}
+			stats.residentBytes += slot.positions.size() * sizeof(glm::vec3) + slot.rotations.size() * sizeof(glm::quat) + slot.scales.size() * sizeof(glm::vec3);
+		}
+		return stats;
+	}
+
+	void StreamingClipSampler::loaderLoop() {
+		const int numBlocks = (int)m_blockOffsets.size();
+		while (true) {
+			BlockSlot* slot = nullptr;
+			int block = -1;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				//Nearest missing block in the window, loaded into a slot that has left it
+				auto findWork = [&] {
+					for (int i = 0; i < (int)m_slots.size(); i++)
+					{
+						int wanted = m_playheadBlock + i;
+						if (wanted >= numBlocks) {
+							if (!m_loop)
+								return false;
+							wanted -= numBlocks;
+						}
+						bool resident = false;
+						BlockSlot* freeSlot = nullptr;
+						for (BlockSlot& s : m_slots)
+						{
+							resident = resident || s.block == wanted;
+							if (!s.loading && (s.block < 0 || !isWanted(s.block))) {
+								freeSlot = &s;
+							}
+						}
+						if (!resident && freeSlot != nullptr) {
+							slot = freeSlot;
+							block = wanted;
+							return true;
+						}
+					}
+					return false;
+				};
+				m_workCondition.wait(lock, [&] { return m_shutdown || findWork(); });
+				if (m_shutdown)
+					return;
+				slot->block = block;
+				slot->loading = true;
+			}
+			loadBlock(slot, block);
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				slot->loading = false;
+				m_blocksLoaded++;
+			}
+			m_readyCondition.notify_all();
+		}
+	}
+
+	//Runs on the loader thread, which is the only user of m_file after open
+	void StreamingClipSampler::loadBlock(BlockSlot* slot, int block) {
+		const size_t count = (size_t)getBlockFrames(block, m_numFrames, m_framesPerBlock) * m_channelNames.size();
+		bool ok = seekFile(m_file, m_blockOffsets[block], SEEK_SET) == 0
+			&& fread(slot->positions.data(), sizeof(glm::vec3), count, m_file) == count
+			&& fread(slot->rotations.data(), sizeof(glm::quat), count, m_file) == count
+			&& fread(slot->scales.data(), sizeof(glm::vec3), count, m_file) == count;
+		if (!ok) {
+			printf("Failed to read block %d of streaming clip\n", block);
+			std::fill(slot->positions.begin(), slot->positions.end(), glm::vec3(0));
+			std::fill(slot->rotations.begin(), slot->rotations.end(), glm::quat(1, 0, 0, 0));
+			std::fill(slot->scales.begin(), slot->scales.end(), glm::vec3(1));
+		}
+	}
+}
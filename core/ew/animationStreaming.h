@@ -0,0 +1,98 @@
+#pragma once
+#include "animation.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace ew {
+	//Bump when the layout of streaming clip files changes
+	const uint32_t STREAMING_CLIP_VERSION = 1;
+
+	/// <summary>
+	/// Resamples animClip at sampleRate and writes it as a streaming clip: a small header followed by
+	/// independent blocks of framesPerBlock frames. Frames are laid out like a BakedPoseTrack, and each block
+	/// repeats the first frame of the next so any frame pair can be sampled from one block.
+	/// Only one block is held in memory while writing.
+	/// </summary>
+	bool writeStreamingClip(const ew::AnimationClip& animClip, float sampleRate, const char* filePath, int framesPerBlock = 64);
+	//True if filePath is missing or older than sourcePath, the file its clip was loaded from
+	bool isStreamingClipStale(const char* filePath, const char* sourcePath);
+
+	struct StreamingClipStats {
+		int numBlocks = 0;
+		int residentBlocks = 0;
+		size_t residentBytes = 0; //Block buffers, allocated once in open
+		uint64_t fileBytes = 0;
+		int blocksLoaded = 0;
+		int stalls = 0; //Samples that had to wait for their block, such as after a seek
+	};
+
+	/// <summary>
+	/// Plays a streaming clip with only a window of blocks in memory. A background thread loads the block
+	/// under the playhead and the ones after it, wrapping around when looping. Memory use is fixed by the
+	/// window size, no matter how long the clip is.
+	/// Seeking anywhere works. The first sample after a seek waits for its block unless seek was called ahead of time.
+	/// Sample from one thread only.
+	/// </summary>
+	class StreamingClipSampler {
+	public:
+		StreamingClipSampler() {};
+		~StreamingClipSampler();
+		StreamingClipSampler(const StreamingClipSampler&) = delete;
+		StreamingClipSampler& operator=(const StreamingClipSampler&) = delete;
+
+		//windowBlocks is the number of blocks kept in memory, including the one being played
+		bool open(const char* filePath, int windowBlocks = 4, bool loop = true);
+		void close();
+		inline bool isOpen() const { return m_file != nullptr; }
+
+		//Resolves channels by name. Unmatched channels get -1 and are skipped.
+		ew::AnimationBinding bind(const ew::Skeleton& skeleton) const;
+		//Moves the window to normalizedTime (0-1) so its blocks start loading before they are sampled
+		void seek(float normalizedTime);
+		//Same as updateSkeleton with a baked clip
+		void updateSkeleton(ew::Skeleton* skeleton, const ew::AnimationBinding& binding, float normalizedTime);
+
+		inline float getDuration() const { return m_duration; } //Ticks
+		inline int getTicksPerSecond() const { return m_ticksPerSecond; }
+		inline int getNumFrames() const { return m_numFrames; }
+		StreamingClipStats getStats();
+	private:
+		struct BlockSlot {
+			int block = -1;
+			bool loading = false;
+			std::vector<glm::vec3> positions;
+			std::vector<glm::quat> rotations;
+			std::vector<glm::vec3> scales;
+		};
+		int findBlock(float normalizedTime, int* frame, float* t) const;
+		void setPlayheadBlock(int block);
+		bool isWanted(int block) const;
+		void loaderLoop();
+		void loadBlock(BlockSlot* slot, int block);
+
+		FILE* m_file = nullptr;
+		std::vector<std::string> m_channelNames;
+		std::vector<uint64_t> m_blockOffsets;
+		float m_duration = 0;
+		int m_ticksPerSecond = 0;
+		float m_ticksPerFrame = 0;
+		int m_numFrames = 0;
+		int m_framesPerBlock = 0;
+		bool m_loop = true;
+		uint64_t m_fileBytes = 0;
+
+		std::vector<BlockSlot> m_slots;
+		std::thread m_loader;
+		std::mutex m_mutex;
+		std::condition_variable m_workCondition;
+		std::condition_variable m_readyCondition;
+		int m_playheadBlock = 0;
+		bool m_shutdown = false;
+		int m_blocksLoaded = 0;
+		int m_stalls = 0;
+	};
+}
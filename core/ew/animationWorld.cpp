@@ -0,0 +1,334 @@
+#include "animationWorld.h"
+#include <algorithm>
+#include <chrono>
+#include <functional>
+
+namespace ew {
+	//Keeps a batch's SoA arrays in cache
+	const size_t MAX_BATCH_SAMPLES = 64;
+
+	AnimationWorld::AnimationWorld(int numThreads) {
+		setNumThreads(numThreads);
+	}
+
+	AnimationWorld::~AnimationWorld() {
+		stopWorkers();
+	}
+
+	int AnimationWorld::addInstance(const ew::AnimatedSkeletonPackage& package, float startTime) {
+		AnimationInstance instance;
+		instance.skeleton = package.skeleton;
+		instance.animClip = &package.animationClip;
+		instance.binding = &package.binding;
+		instance.time = startTime;
+		instance.worldMatrices.reserve(package.skeleton.bones.size());
+		instance.cursor.channels.resize(package.animationClip.bones.size());
+		instance.numRequiredChannels = countRequiredChannels(package.skeleton, package.binding);
+		m_instances.push_back(std::move(instance));
+		return (int)m_instances.size() - 1;
+	}
+
+	void AnimationWorld::clearInstances() {
+		m_instances.clear();
+	}
+
+	void AnimationWorld::setNumThreads(int numThreads) {
+		if (numThreads <= 0) {
+			numThreads = glm::max((int)std::thread::hardware_concurrency(), 1);
+		}
+		stopWorkers();
+		startWorkers(numThreads - 1);
+	}
+
+	void AnimationWorld::startWorkers(int numWorkers) {
+		m_shutdown = false;
+		m_workers.reserve(numWorkers);
+		for (int i = 0; i < numWorkers; i++)
+		{
+			//Partition 0 belongs to the calling thread
+			m_workers.emplace_back(&AnimationWorld::workerLoop, this, i + 1, m_frame);
+		}
+	}
+
+	void AnimationWorld::stopWorkers() {
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_shutdown = true;
+		}
+		m_startCondition.notify_all();
+		for (std::thread& worker : m_workers)
+		{
+			worker.join();
+		}
+		m_workers.clear();
+	}
+
+	void AnimationWorld::update(float deltaTime) {
+		auto startTime = std::chrono::high_resolution_clock::now();
+		const size_t numPartitions = m_workers.size() + 1;
+		const size_t numLevels = glm::max(m_lodSettings.levels.size(), (size_t)1);
+		m_partitionStats.resize(numPartitions);
+		m_partitionScratchSkeletons.resize(numPartitions);
+		m_partitionScratchMatrices.resize(numPartitions);
+		m_partitionBatches.resize(numPartitions);
+		m_partitionCacheStats.assign(numPartitions, PoseCacheStats());
+		if (m_poseCacheSettings.enabled) {
+			m_poseCache.beginFrame();
+		}
+		for (AnimationLODStats& stats : m_partitionStats)
+		{
+			stats.instancesPerLevel.assign(numLevels, 0);
+			stats.sampledInstances = 0;
+			stats.sampledChannels = 0;
+			stats.maxPositionError = 0.0f;
+		}
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_deltaTime = deltaTime;
+			m_pendingWorkers = (int)m_workers.size();
+			m_frame++;
+		}
+		m_startCondition.notify_all();
+
+		updatePartition(0, deltaTime);
+
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_doneCondition.wait(lock, [this] { return m_pendingWorkers == 0; });
+		}
+		m_lodStats = m_partitionStats[0];
+		for (size_t p = 1; p < numPartitions; p++)
+		{
+			const AnimationLODStats& stats = m_partitionStats[p];
+			for (size_t level = 0; level < numLevels; level++)
+			{
+				m_lodStats.instancesPerLevel[level] += stats.instancesPerLevel[level];
+			}
+			m_lodStats.sampledInstances += stats.sampledInstances;
+			m_lodStats.sampledChannels += stats.sampledChannels;
+			m_lodStats.maxPositionError = glm::max(m_lodStats.maxPositionError, stats.maxPositionError);
+		}
+		m_poseCacheStats = PoseCacheStats();
+		for (const PoseCacheStats& stats : m_partitionCacheStats)
+		{
+			m_poseCacheStats.lookups += stats.lookups;
+			m_poseCacheStats.hits += stats.hits;
+			m_poseCacheStats.savedMilliseconds += stats.savedMilliseconds;
+		}
+		m_poseCacheStats.entries = m_poseCacheSettings.enabled ? m_poseCache.getNumEntries() : 0;
+		std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - startTime;
+		m_lastUpdateMilliseconds = elapsed.count();
+	}
+
+	void AnimationWorld::workerLoop(int partition, uint64_t startFrame) {
+		uint64_t lastFrame = startFrame;
+		while (true) {
+			float deltaTime;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_startCondition.wait(lock, [&] { return m_shutdown || m_frame != lastFrame; });
+				if (m_shutdown)
+					return;
+				lastFrame = m_frame;
+				deltaTime = m_deltaTime;
+			}
+			updatePartition(partition, deltaTime);
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				if (--m_pendingWorkers == 0) {
+					m_doneCondition.notify_one();
+				}
+			}
+		}
+	}
+
+	void AnimationWorld::updatePartition(int partition, float deltaTime) {
+		const size_t numInstances = m_instances.size();
+		const size_t numPartitions = m_workers.size() + 1;
+		const size_t begin = numInstances * partition / numPartitions;
+		const size_t end = numInstances * (partition + 1) / numPartitions;
+		for (size_t i = begin; i < end; i++)
+		{
+			updateInstance(i, deltaTime, partition);
+		}
+		sampleBatchedInstances(partition);
+	}
+
+	static inline float wrapTime(const ew::AnimationInstance& instance, float time) {
+		return instance.loop ? glm::fract(time) : glm::clamp(time, 0.0f, 1.0f);
+	}
+
+	void AnimationWorld::updateInstance(size_t index, float deltaTime, int partition) {
+		AnimationInstance& instance = m_instances[index];
+		const AnimationClip* animClip = instance.animClip;
+		float ticksPerSecond = ew::getTicksPerSecond(*animClip);
+		//Normalized time advanced per frame
+		float timeStep = 0.0f;
+		if (animClip->duration > 0) {
+			timeStep = deltaTime * instance.speed * ticksPerSecond / animClip->duration;
+		}
+		instance.time = wrapTime(instance, instance.time + timeStep);
+
+		AnimationLODStats& stats = m_partitionStats[partition];
+		//Nothing shows the pose of an instance out of view, so keep the last one
+		if (!instance.visible && m_lodSettings.levels.empty() && !instance.worldMatrices.empty())
+			return;
+		int lod = 0;
+		AnimationLODLevel level;
+		if (!m_lodSettings.levels.empty()) {
+			lod = instance.visible ? selectAnimationLOD(m_lodSettings, glm::distance(instance.position, m_viewerPosition)) : (int)m_lodSettings.levels.size() - 1;
+			level = m_lodSettings.levels[lod];
+		}
+		stats.instancesPerLevel[lod]++;
+		const int interval = glm::max(level.updateInterval, 1);
+		const int numSampledChannels = level.skipOptionalBones ? instance.numRequiredChannels : (int)animClip->bones.size();
+
+		if (interval == 1 && !level.skipOptionalBones && m_batchSampling && !m_poseCacheSettings.enabled) {
+			m_partitionBatches[partition].instances.push_back(index);
+		}
+		else if (interval == 1 || instance.worldMatrices.empty()) {
+			sampleInstance(instance, instance.time, level.skipOptionalBones, numSampledChannels, instance.worldMatrices, partition);
+			//Restart interpolation from this pose if the interval grows
+			instance.lodFrame = instance.lodInterval = 0;
+			instance.lodSampleTime = instance.time;
+		}
+		else {
+			if (lod != instance.lod || instance.lodFrame >= instance.lodInterval) {
+				if (lod != instance.lod || instance.lodInterval == 0) {
+					//Shorten the first interval by a per-instance offset so instances sample on different frames
+					instance.lodInterval = interval - (int)(index % interval);
+				}
+				else {
+					instance.lodInterval = interval;
+				}
+				//Clips rarely loop seamlessly, so never blend across the loop point.
+				//End the interval on the last frame before it, and start over from an exact pose after it.
+				if (timeStep > 0) {
+					int framesToEnd = (int)((1.0f - instance.time) / timeStep) + 1;
+					instance.lodInterval = glm::clamp(framesToEnd, 1, instance.lodInterval);
+				}
+				//prev is normally the pose shown last frame
+				int aheadFrames = instance.lodInterval - 1;
+				instance.lodFrame = 0;
+				if (instance.time < instance.lodSampleTime) {
+					sampleInstance(instance, instance.time, level.skipOptionalBones, numSampledChannels, instance.prevWorldMatrices, partition);
+					//prev is this frame's pose, so the blend starts at 0 and runs one frame longer
+					aheadFrames++;
+					instance.lodFrame = -1;
+				}
+				else {
+					instance.prevWorldMatrices = instance.worldMatrices;
+				}
+				//Sample the pose due on the last frame of this interval and blend toward it
+				instance.lodSampleTime = wrapTime(instance, instance.time + timeStep * aheadFrames);
+				sampleInstance(instance, instance.lodSampleTime, level.skipOptionalBones, numSampledChannels, instance.nextWorldMatrices, partition);
+			}
+			instance.lodFrame++;
+			const float t = (float)instance.lodFrame / instance.lodInterval;
+			for (size_t b = 0; b < instance.worldMatrices.size(); b++)
+			{
+				instance.worldMatrices[b] = instance.prevWorldMatrices[b] * (1.0f - t) + instance.nextWorldMatrices[b] * t;
+			}
+		}
+		instance.lod = lod;
+
+		if (m_measureLODError && (interval > 1 || level.skipOptionalBones)) {
+			stats.maxPositionError = glm::max(stats.maxPositionError, measureLODError(instance, partition));
+		}
+	}
+
+	void AnimationWorld::sampleInstance(ew::AnimationInstance& instance, float time, bool skipOptionalBones, int numSampledChannels, std::vector<glm::mat4>& worldMatrices, int partition) {
+		PoseCacheEntry* entry = nullptr;
+		bool created = false;
+		std::chrono::high_resolution_clock::time_point startTime;
+		//Skipped optional bones keep whatever pose each instance had, so those poses can't be shared
+		if (m_poseCacheSettings.enabled && !skipOptionalBones) {
+			PoseCacheStats& cacheStats = m_partitionCacheStats[partition];
+			startTime = std::chrono::high_resolution_clock::now();
+			time = PoseCache::quantizeTime(*instance.animClip, time, m_poseCacheSettings.timeStep);
+			entry = m_poseCache.findOrCreate(instance.animClip, instance.binding, time, &created);
+			cacheStats.lookups++;
+			if (!created && entry->ready.load(std::memory_order_acquire)) {
+				const size_t numBones = instance.skeleton.bones.size();
+				for (size_t b = 0; b < numBones; b++)
+				{
+					ew::setLocalTransform(&instance.skeleton, (int)b, entry->localTransforms[b]);
+				}
+				worldMatrices = entry->worldMatrices;
+				std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - startTime;
+				cacheStats.hits++;
+				cacheStats.savedMilliseconds += entry->sampleMicroseconds / 1000.0f - elapsed.count();
+				return;
+			}
+		}
+		ew::updateSkeleton(&instance.skeleton, instance.animClip, *instance.binding, time, &instance.cursor, skipOptionalBones);
+		ew::solveFK(instance.skeleton, worldMatrices);
+		AnimationLODStats& stats = m_partitionStats[partition];
+		stats.sampledInstances++;
+		stats.sampledChannels += numSampledChannels;
+		if (created) {
+			const size_t numBones = instance.skeleton.bones.size();
+			entry->localTransforms.resize(numBones);
+			for (size_t b = 0; b < numBones; b++)
+			{
+				entry->localTransforms[b] = instance.skeleton.bones[b].localTransform;
+			}
+			entry->worldMatrices = worldMatrices;
+			std::chrono::duration<float, std::micro> elapsed = std::chrono::high_resolution_clock::now() - startTime;
+			entry->sampleMicroseconds = elapsed.count();
+			PoseCache::publish(entry);
+		}
+	}
+
+	void AnimationWorld::sampleBatchedInstances(int partition) {
+		SampleBatch& batch = m_partitionBatches[partition];
+		AnimationLODStats& stats = m_partitionStats[partition];
+		//Group instances of the same clip. Each sample is independent, so the order only affects speed.
+		std::stable_sort(batch.instances.begin(), batch.instances.end(), [this](size_t a, size_t b) {
+			return std::less<const AnimationClip*>()(m_instances[a].animClip, m_instances[b].animClip);
+		});
+		const size_t numQueued = batch.instances.size();
+		size_t begin = 0;
+		while (begin < numQueued) {
+			const AnimationClip* animClip = m_instances[batch.instances[begin]].animClip;
+			size_t end = begin + 1;
+			while (end < numQueued && end - begin < MAX_BATCH_SAMPLES && m_instances[batch.instances[end]].animClip == animClip)
+				end++;
+			const size_t numSamples = end - begin;
+			batch.times.resize(numSamples);
+			for (size_t i = 0; i < numSamples; i++)
+			{
+				batch.times[i] = m_instances[batch.instances[begin + i]].time;
+			}
+			//Match updateSkeleton: slerp between keys, nlerp between baked frames
+			QuatInterpolation quatInterpolation = animClip->useBakedTrack ? QuatInterpolation::NLERP : QuatInterpolation::SLERP;
+			ew::sampleAnimationClipBatch(*animClip, batch.times.data(), numSamples, &batch.poses, quatInterpolation);
+			for (size_t i = 0; i < numSamples; i++)
+			{
+				AnimationInstance& instance = m_instances[batch.instances[begin + i]];
+				ew::applyPoseBatch(batch.poses, i, *instance.binding, &instance.skeleton);
+				ew::solveFK(instance.skeleton, instance.worldMatrices);
+				instance.lodFrame = instance.lodInterval = 0;
+				instance.lodSampleTime = instance.time;
+			}
+			stats.sampledInstances += (int)numSamples;
+			stats.sampledChannels += (int)(numSamples * animClip->bones.size());
+			begin = end;
+		}
+		batch.instances.clear();
+	}
+
+	float AnimationWorld::measureLODError(const ew::AnimationInstance& instance, int partition) {
+		Skeleton& reference = m_partitionScratchSkeletons[partition];
+		std::vector<glm::mat4>& referenceMatrices = m_partitionScratchMatrices[partition];
+		reference = instance.skeleton;
+		ew::updateSkeleton(&reference, instance.animClip, *instance.binding, instance.time);
+		ew::solveFK(reference, referenceMatrices);
+		float maxError = 0.0f;
+		for (size_t b = 0; b < referenceMatrices.size(); b++)
+		{
+			maxError = glm::max(maxError, glm::distance(glm::vec3(referenceMatrices[b][3]), glm::vec3(instance.worldMatrices[b][3])));
+		}
+		return maxError;
+	}
+}
@@ -0,0 +1,132 @@
+#pragma once
+#include "animation.h"
+#include "animationBatch.h"
+#include "animationLOD.h"
+#include "poseCache.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdint.h>
+
+namespace ew {
+	//One animated character owned by an AnimationWorld
+	struct AnimationInstance {
+		ew::Skeleton skeleton; //Local transforms of this instance
+		const ew::AnimationClip* animClip = nullptr;
+		const ew::AnimationBinding* binding = nullptr;
+		ew::AnimationCursor cursor;
+		float time = 0.0f; //Normalized playback time (0-1)
+		float speed = 1.0f; //Playback rate. 1 = clip's own tick rate
+		bool loop = true;
+		glm::vec3 position = glm::vec3(0); //World position, used to pick the LOD
+		bool visible = true; //Set false when outside the view. See AnimationWorld.
+		std::vector<glm::mat4> worldMatrices; //Output of solveFK
+
+		//LOD state
+		int lod = 0;
+		int lodFrame = 0; //Frames since the last sample
+		int lodInterval = 0; //Frames between the last sample and the next one
+		float lodSampleTime = 0.0f; //Time of nextWorldMatrices
+		int numRequiredChannels = 0; //Channels still sampled when optional bones are skipped
+		std::vector<glm::mat4> prevWorldMatrices; //Pose shown when the last sample was taken
+		std::vector<glm::mat4> nextWorldMatrices; //Pose sampled ahead, reached at the end of the interval
+	};
+
+	/// <summary>
+	/// Owns many animated skeletons and updates them in parallel.
+	/// Every update, instances are split into contiguous ranges, one per thread, and each range
+	/// is sampled and solved independently. Results do not depend on the thread count.
+	/// After the first update of an instance, updates do not allocate.
+	/// With LOD settings, instances far from the viewer sample every few frames and interpolate
+	/// world matrices between samples. Each sample is taken ahead at the time the interval ends,
+	/// so the interpolated pose does not lag behind.
+	/// Instances that are not visible use the coarsest LOD level. Without LOD levels they only advance
+	/// in time and keep their last pose.
+	/// With the pose cache enabled, instances of the same package that sample the same quantized time
+	/// in a frame share one sample and FK solve.
+	/// With batch sampling, full detail instances are grouped by clip and sampled together with
+	/// sampleAnimationClipBatch. Not used together with the pose cache.
+	/// </summary>
+	class AnimationWorld {
+	public:
+		//numThreads includes the calling thread. 0 = one per hardware thread.
+		AnimationWorld(int numThreads = 0);
+		~AnimationWorld();
+		AnimationWorld(const AnimationWorld&) = delete;
+		AnimationWorld& operator=(const AnimationWorld&) = delete;
+
+		//package must outlive the world. Returns instance index.
+		int addInstance(const ew::AnimatedSkeletonPackage& package, float startTime = 0.0f);
+		inline ew::AnimationInstance& getInstance(int index) { return m_instances[index]; }
+		inline const ew::AnimationInstance& getInstance(int index) const { return m_instances[index]; }
+		inline size_t getNumInstances() const { return m_instances.size(); }
+		void clearInstances();
+
+		void setNumThreads(int numThreads);
+		inline int getNumThreads() const { return (int)m_workers.size() + 1; }
+
+		//Advances, samples and solves FK for every instance
+		void update(float deltaTime);
+		inline float getLastUpdateMilliseconds() const { return m_lastUpdateMilliseconds; }
+
+		inline void setLODSettings(const ew::AnimationLODSettings& settings) { m_lodSettings = settings; }
+		inline const ew::AnimationLODSettings& getLODSettings() const { return m_lodSettings; }
+		inline void setViewerPosition(const glm::vec3& position) { m_viewerPosition = position; }
+		//Also runs a full detail update of every reduced LOD instance to measure error. Slow.
+		inline void setMeasureLODError(bool measure) { m_measureLODError = measure; }
+		inline const ew::AnimationLODStats& getLODStats() const { return m_lodStats; }
+
+		inline void setPoseCacheSettings(const ew::PoseCacheSettings& settings) { m_poseCacheSettings = settings; }
+		inline const ew::PoseCacheSettings& getPoseCacheSettings() const { return m_poseCacheSettings; }
+		inline const ew::PoseCacheStats& getPoseCacheStats() const { return m_poseCacheStats; }
+
+		inline void setBatchSampling(bool enabled) { m_batchSampling = enabled; }
+		inline bool getBatchSampling() const { return m_batchSampling; }
+	private:
+		void startWorkers(int numWorkers);
+		void stopWorkers();
+		void workerLoop(int partition, uint64_t startFrame);
+		void updatePartition(int partition, float deltaTime);
+		void updateInstance(size_t index, float deltaTime, int partition);
+		float measureLODError(const ew::AnimationInstance& instance, int partition);
+		//updateSkeleton and solveFK into worldMatrices, through the pose cache when it is enabled
+		void sampleInstance(ew::AnimationInstance& instance, float time, bool skipOptionalBones, int numSampledChannels, std::vector<glm::mat4>& worldMatrices, int partition);
+		//Samples and solves the instances queued by updateInstance, a clip at a time
+		void sampleBatchedInstances(int partition);
+
+		std::vector<ew::AnimationInstance> m_instances;
+		std::vector<std::thread> m_workers;
+		std::mutex m_mutex;
+		std::condition_variable m_startCondition;
+		std::condition_variable m_doneCondition;
+		uint64_t m_frame = 0;
+		int m_pendingWorkers = 0;
+		bool m_shutdown = false;
+		float m_deltaTime = 0.0f;
+		float m_lastUpdateMilliseconds = 0.0f;
+
+		ew::AnimationLODSettings m_lodSettings;
+		glm::vec3 m_viewerPosition = glm::vec3(0);
+		bool m_measureLODError = false;
+		ew::AnimationLODStats m_lodStats;
+		//Per partition, merged after each update
+		std::vector<ew::AnimationLODStats> m_partitionStats;
+		std::vector<ew::Skeleton> m_partitionScratchSkeletons;
+		std::vector<std::vector<glm::mat4>> m_partitionScratchMatrices;
+
+		ew::PoseCacheSettings m_poseCacheSettings;
+		ew::PoseCache m_poseCache;
+		ew::PoseCacheStats m_poseCacheStats;
+		std::vector<ew::PoseCacheStats> m_partitionCacheStats;
+
+		//Instances waiting for batch sampling, and the batch they are sampled into
+		struct SampleBatch {
+			std::vector<size_t> instances;
+			std::vector<float> times;
+			ew::PoseBatch poses;
+		};
+		bool m_batchSampling = true;
+		std::vector<SampleBatch> m_partitionBatches;
+	};
+}
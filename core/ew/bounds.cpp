@@ -0,0 +1,215 @@
+#include "bounds.h"
+#include "skinning.h"
+#include "simd.h"
+
+namespace ew {
+	void growSphere(ew::BoundingSphere* sphere, const glm::vec3& point) {
+		if (sphere->isEmpty()) {
+			sphere->center = point;
+			sphere->radius = 0.0f;
+			return;
+		}
+		const float distance = glm::length(point - sphere->center);
+		if (distance <= sphere->radius)
+			return;
+		const float radius = (sphere->radius + distance) * 0.5f;
+		sphere->center += (point - sphere->center) * ((radius - sphere->radius) / distance);
+		sphere->radius = radius;
+	}
+
+	BoundingSphere mergeSpheres(const ew::BoundingSphere& a, const ew::BoundingSphere& b) {
+		if (a.isEmpty())
+			return b;
+		if (b.isEmpty())
+			return a;
+		const glm::vec3 offset = b.center - a.center;
+		const float distance = glm::length(offset);
+		if (distance + b.radius <= a.radius)
+			return a;
+		if (distance + a.radius <= b.radius)
+			return b;
+		BoundingSphere merged;
+		merged.radius = (distance + a.radius + b.radius) * 0.5f;
+		merged.center = a.center + offset * ((merged.radius - a.radius) / distance);
+		return merged;
+	}
+
+	BoundingSphere transformSphere(const ew::BoundingSphere& sphere, const glm::mat4& m) {
+		if (sphere.isEmpty())
+			return sphere;
+		const float scale2 = glm::max(glm::max(glm::dot(glm::vec3(m[0]), glm::vec3(m[0])), glm::dot(glm::vec3(m[1]), glm::vec3(m[1]))), glm::dot(glm::vec3(m[2]), glm::vec3(m[2])));
+		BoundingSphere result;
+		result.center = glm::vec3(m * glm::vec4(sphere.center, 1.0f));
+		result.radius = sphere.radius * sqrtf(scale2);
+		return result;
+	}
+
+	AABB transformAABB(const ew::AABB& aabb, const glm::mat4& m) {
+		if (aabb.isEmpty())
+			return aabb;
+		//Arvo's method: each output axis is the translation plus the extreme of every input axis' contribution
+		AABB result;
+		for (int i = 0; i < 3; i++)
+		{
+			result.min[i] = result.max[i] = m[3][i];
+			for (int j = 0; j < 3; j++)
+			{
+				const float a = m[j][i] * aabb.min[j];
+				const float b = m[j][i] * aabb.max[j];
+				result.min[i] += glm::min(a, b);
+				result.max[i] += glm::max(a, b);
+			}
+		}
+		return result;
+	}
+
+	Frustum extractFrustum(const glm::mat4& viewProjection) {
+		//Gribb-Hartmann. glm is column-major, so row i is m[c][i].
+		glm::vec4 rows[4];
+		for (int i = 0; i < 4; i++)
+		{
+			rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+		}
+		Frustum frustum;
+		frustum.planes[0] = rows[3] + rows[0]; //Left
+		frustum.planes[1] = rows[3] - rows[0]; //Right
+		frustum.planes[2] = rows[3] + rows[1]; //Bottom
+		frustum.planes[3] = rows[3] - rows[1]; //Top
+		frustum.planes[4] = rows[3] + rows[2]; //Near, OpenGL clip space depth is -1 to 1
+		frustum.planes[5] = rows[3] - rows[2]; //Far
+		for (glm::vec4& plane : frustum.planes)
+		{
+			plane /= glm::length(glm::vec3(plane));
+		}
+		return frustum;
+	}
+
+	bool isVisible(const ew::Frustum& frustum, const ew::AABB& aabb) {
+		if (aabb.isEmpty())
+			return false;
+		for (const glm::vec4& plane : frustum.planes)
+		{
+			//Corner furthest along the plane normal
+			const glm::vec3 corner(
+				plane.x > 0 ? aabb.max.x : aabb.min.x,
+				plane.y > 0 ? aabb.max.y : aabb.min.y,
+				plane.z > 0 ? aabb.max.z : aabb.min.z);
+			if (glm::dot(glm::vec3(plane), corner) + plane.w < 0)
+				return false;
+		}
+		return true;
+	}
+
+	SkinnedBounds makeSkinnedBounds(const ew::Model& model, const ew::SkinBinding& skinBinding) {
+		SkinnedBounds bounds;
+		bounds.staticSphere = model.getUnskinnedBounds();
+		const std::vector<BoundingSphere>& boneBounds = model.getBoneBounds();
+		for (size_t i = 0; i < boneBounds.size() && i < skinBinding.boneIndices.size(); i++)
+		{
+			const BoundingSphere& sphere = boneBounds[i];
+			if (sphere.isEmpty())
+				continue;
+			const int boneIndex = skinBinding.boneIndices[i];
+			//Unbound bones stay in bind pose, see computeSkinningPalette
+			if (boneIndex == -1) {
+				bounds.staticSphere = mergeSpheres(bounds.staticSphere, transformSphere(sphere, glm::inverse(skinBinding.inverseBindPoses[i])));
+				continue;
+			}
+			bounds.boneIndices.push_back(boneIndex);
+			bounds.centerX.push_back(sphere.center.x);
+			bounds.centerY.push_back(sphere.center.y);
+			bounds.centerZ.push_back(sphere.center.z);
+			bounds.radii.push_back(sphere.radius);
+		}
+		bounds.numSpheres = (int)bounds.boneIndices.size();
+		//Pad with copies of the last sphere, which leave the bounds unchanged
+		if (bounds.numSpheres > 0) {
+			const size_t paddedSize = simdPaddedSize(bounds.numSpheres);
+			bounds.boneIndices.resize(paddedSize, bounds.boneIndices.back());
+			bounds.centerX.resize(paddedSize, bounds.centerX.back());
+			bounds.centerY.resize(paddedSize, bounds.centerY.back());
+			bounds.centerZ.resize(paddedSize, bounds.centerZ.back());
+			bounds.radii.resize(paddedSize, bounds.radii.back());
+		}
+		return bounds;
+	}
+
+	//Bounds of spheres [begin, end), a lane width at a time
+	template<typename V>
+	static void boundSphereLanes(const ew::SkinnedBounds& bounds, const std::vector<glm::mat4>& worldMatrices, size_t begin, size_t end, ew::AABB* aabb) {
+		const size_t LANES = sizeof(V) / sizeof(float);
+		if (begin >= end)
+			return;
+		V minX = vset(INFINITY, V()), minY = minX, minZ = minX;
+		V maxX = vset(-INFINITY, V()), maxY = maxX, maxZ = maxX;
+		for (size_t i = begin; i < end; i += LANES)
+		{
+			//Gather the affine part of each lane's bone matrix, column-major
+			float m[12][LANES];
+			for (size_t l = 0; l < LANES; l++)
+			{
+				const glm::mat4& world = worldMatrices[bounds.boneIndices[i + l]];
+				for (int c = 0; c < 4; c++)
+				{
+					m[c * 3][l] = world[c][0];
+					m[c * 3 + 1][l] = world[c][1];
+					m[c * 3 + 2][l] = world[c][2];
+				}
+			}
+			V col[12];
+			for (int k = 0; k < 12; k++)
+			{
+				col[k] = vload(m[k], V());
+			}
+			const V x = vload(&bounds.centerX[i], V());
+			const V y = vload(&bounds.centerY[i], V());
+			const V z = vload(&bounds.centerZ[i], V());
+			const V cx = vadd(vadd(vmul(col[0], x), vmul(col[3], y)), vadd(vmul(col[6], z), col[9]));
+			const V cy = vadd(vadd(vmul(col[1], x), vmul(col[4], y)), vadd(vmul(col[7], z), col[10]));
+			const V cz = vadd(vadd(vmul(col[2], x), vmul(col[5], y)), vadd(vmul(col[8], z), col[11]));
+			//Largest axis scale of the bone
+			const V scale0 = vadd(vadd(vmul(col[0], col[0]), vmul(col[1], col[1])), vmul(col[2], col[2]));
+			const V scale1 = vadd(vadd(vmul(col[3], col[3]), vmul(col[4], col[4])), vmul(col[5], col[5]));
+			const V scale2 = vadd(vadd(vmul(col[6], col[6]), vmul(col[7], col[7])), vmul(col[8], col[8]));
+			const V r = vmul(vload(&bounds.radii[i], V()), vsqrt(vmax(vmax(scale0, scale1), scale2)));
+			minX = vmin(minX, vsub(cx, r));
+			minY = vmin(minY, vsub(cy, r));
+			minZ = vmin(minZ, vsub(cz, r));
+			maxX = vmax(maxX, vadd(cx, r));
+			maxY = vmax(maxY, vadd(cy, r));
+			maxZ = vmax(maxZ, vadd(cz, r));
+		}
+		float lanes[6][LANES];
+		vstore(lanes[0], minX);
+		vstore(lanes[1], minY);
+		vstore(lanes[2], minZ);
+		vstore(lanes[3], maxX);
+		vstore(lanes[4], maxY);
+		vstore(lanes[5], maxZ);
+		for (size_t l = 0; l < LANES; l++)
+		{
+			aabb->min = glm::min(aabb->min, glm::vec3(lanes[0][l], lanes[1][l], lanes[2][l]));
+			aabb->max = glm::max(aabb->max, glm::vec3(lanes[3][l], lanes[4][l], lanes[5][l]));
+		}
+	}
+
+	AABB computeSkinnedAABB(const ew::SkinnedBounds& bounds, const std::vector<glm::mat4>& worldMatrices, const glm::mat4& modelMatrix) {
+		AABB aabb;
+		if (!bounds.staticSphere.isEmpty()) {
+			aabb.min = bounds.staticSphere.center - bounds.staticSphere.radius;
+			aabb.max = bounds.staticSphere.center + bounds.staticSphere.radius;
+		}
+		const size_t count = bounds.numSpheres;
+		size_t i = 0;
+#ifdef EW_SIMD_AVX
+		boundSphereLanes<__m256>(bounds, worldMatrices, i, count / 8 * 8, &aabb);
+		i = count / 8 * 8;
+#endif
+#ifdef EW_SIMD_SSE
+		boundSphereLanes<__m128>(bounds, worldMatrices, i, count / 4 * 4, &aabb);
+		i = glm::max(i, count / 4 * 4);
+#endif
+		boundSphereLanes<float>(bounds, worldMatrices, i, count, &aabb);
+		return transformAABB(aabb, modelMatrix);
+	}
+}
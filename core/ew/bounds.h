@@ -0,0 +1,57 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+#include <math.h>
+
+namespace ew {
+	class Model;
+	struct SkinBinding;
+
+	struct BoundingSphere {
+		glm::vec3 center = glm::vec3(0);
+		float radius = -1.0f; //Negative = empty
+		inline bool isEmpty() const { return radius < 0.0f; }
+	};
+	struct AABB {
+		glm::vec3 min = glm::vec3(INFINITY);
+		glm::vec3 max = glm::vec3(-INFINITY);
+		inline bool isEmpty() const { return min.x > max.x; }
+	};
+	//Planes with normals pointing inside, as (normal, distance). dot(normal, p) + distance >= 0 inside.
+	struct Frustum {
+		glm::vec4 planes[6];
+	};
+
+	//Grows sphere just enough to contain point. Moves the center toward the point, so it stays small for any input order.
+	void growSphere(ew::BoundingSphere* sphere, const glm::vec3& point);
+	//Smallest sphere containing both
+	BoundingSphere mergeSpheres(const ew::BoundingSphere& a, const ew::BoundingSphere& b);
+	//Sphere containing sphere after an affine transform. Radius is scaled by the largest axis scale.
+	BoundingSphere transformSphere(const ew::BoundingSphere& sphere, const glm::mat4& m);
+	//AABB containing aabb after an affine transform
+	AABB transformAABB(const ew::AABB& aabb, const glm::mat4& m);
+
+	//Planes of a view projection matrix, in the space the matrix transforms from
+	Frustum extractFrustum(const glm::mat4& viewProjection);
+	//Conservative: may return true for boxes just outside a frustum corner
+	bool isVisible(const ew::Frustum& frustum, const ew::AABB& aabb);
+
+	/// <summary>
+	/// Per bone spheres of a skinned model in structure-of-arrays form, for bounding animated instances.
+	/// Each sphere holds every vertex the bone influences, in that bone's space.
+	/// A skinned vertex is a weighted average of its bones' transforms, so it always lies inside
+	/// the transformed spheres of its bones.
+	/// </summary>
+	struct SkinnedBounds {
+		int numSpheres = 0;
+		std::vector<int> boneIndices; //Skeleton bone per sphere
+		std::vector<float> centerX, centerY, centerZ, radii; //Padded to simdPaddedSize(numSpheres)
+		BoundingSphere staticSphere; //Model space. Unskinned vertices and bones the skeleton lacks.
+	};
+	SkinnedBounds makeSkinnedBounds(const ew::Model& model, const ew::SkinBinding& skinBinding);
+	/// <summary>
+	/// AABB of an animated instance, from the world matrices of solveFK placed by modelMatrix.
+	/// Every sphere is transformed by its bone in one SIMD pass.
+	/// </summary>
+	AABB computeSkinnedAABB(const ew::SkinnedBounds& bounds, const std::vector<glm::mat4>& worldMatrices, const glm::mat4& modelMatrix = glm::mat4(1.0f));
+}
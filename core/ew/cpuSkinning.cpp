@@ -0,0 +1,196 @@
+#include "cpuSkinning.h"
+#include "simd.h"
+#include <math.h>
+
+//Every kernel computes, per vertex:
+//  blend = ((w0 * M0 + w1 * M1) + w2 * M2) + w3 * M3, or identity if the weights sum to 0
+//  v' = (c0 * x + c2 * z) + (c1 * y + c3 * w) with c = columns of blend, w = 1 for positions, 0 for directions
+//  directions are scaled by 1 / sqrt((x * x + y * y) + z * z)
+//The transform order is the one AVX gets for free with two columns per register.
+namespace ew {
+	static inline bool isWeighted(const ew::Vertex& vertex) {
+		return ((vertex.boneWeights[0] + vertex.boneWeights[1]) + vertex.boneWeights[2]) + vertex.boneWeights[3] > 0.0f;
+	}
+
+	static inline glm::vec3 transformReference(const float* m, float x, float y, float z, float w) {
+		glm::vec3 r;
+		for (int i = 0; i < 3; i++)
+		{
+			r[i] = (m[i] * x + m[8 + i] * z) + (m[4 + i] * y + m[12 + i] * w);
+		}
+		return r;
+	}
+
+	static inline glm::vec3 normalizeReference(const glm::vec3& v) {
+		float invLength = 1.0f / sqrtf((v.x * v.x + v.y * v.y) + v.z * v.z);
+		return glm::vec3(v.x * invLength, v.y * invLength, v.z * invLength);
+	}
+
+	void skinVerticesReference(const ew::MeshData& meshData, const glm::mat4* palette, size_t begin, size_t end, const ew::SkinningOutput& output) {
+		const glm::mat4 identity(1.0f);
+		for (size_t i = begin; i < end; i++)
+		{
+			const Vertex& vertex = meshData.vertices[i];
+			float m[16];
+			const float* blend = m;
+			if (isWeighted(vertex)) {
+				const float* m0 = &palette[vertex.boneIDs[0]][0][0];
+				const float* m1 = &palette[vertex.boneIDs[1]][0][0];
+				const float* m2 = &palette[vertex.boneIDs[2]][0][0];
+				const float* m3 = &palette[vertex.boneIDs[3]][0][0];
+				const float* w = vertex.boneWeights;
+				for (int e = 0; e < 16; e++)
+				{
+					m[e] = ((w[0] * m0[e] + w[1] * m1[e]) + w[2] * m2[e]) + w[3] * m3[e];
+				}
+			}
+			else {
+				blend = &identity[0][0];
+			}
+			output.positions[i] = transformReference(blend, vertex.pos.x, vertex.pos.y, vertex.pos.z, 1.0f);
+			if (output.normals != nullptr) {
+				output.normals[i] = normalizeReference(transformReference(blend, vertex.normal.x, vertex.normal.y, vertex.normal.z, 0.0f));
+			}
+			if (output.tangents != nullptr) {
+				output.tangents[i] = normalizeReference(transformReference(blend, vertex.tangent.x, vertex.tangent.y, vertex.tangent.z, 0.0f));
+			}
+		}
+	}
+
+#ifdef EW_SIMD_SSE
+	static inline void storeVec3(glm::vec3* dst, __m128 v) {
+		float* f = &dst->x;
+		_mm_storel_pi((__m64*)f, v);
+		_mm_store_ss(f + 2, _mm_movehl_ps(v, v));
+	}
+
+	//Directions only. Lane 3 is ignored.
+	static inline __m128 normalize3(__m128 v) {
+		__m128 sq = _mm_mul_ps(v, v);
+		__m128 lengthSq = _mm_add_ss(_mm_add_ss(sq, _mm_shuffle_ps(sq, sq, _MM_SHUFFLE(1, 1, 1, 1))), _mm_shuffle_ps(sq, sq, _MM_SHUFFLE(2, 2, 2, 2)));
+		__m128 invLength = _mm_div_ss(_mm_set_ss(1.0f), _mm_sqrt_ss(lengthSq));
+		return _mm_mul_ps(v, _mm_shuffle_ps(invLength, invLength, 0));
+	}
+#endif
+
+#ifdef EW_SIMD_AVX
+	//Blend matrix as 2 registers: columns 0|1 and 2|3
+	static inline void blendPaletteAVX(const ew::Vertex& vertex, const glm::mat4* palette, __m256* c01, __m256* c23) {
+		if (!isWeighted(vertex)) {
+			*c01 = _mm256_setr_ps(1, 0, 0, 0, 0, 1, 0, 0);
+			*c23 = _mm256_setr_ps(0, 0, 1, 0, 0, 0, 0, 1);
+			return;
+		}
+		const float* m0 = &palette[vertex.boneIDs[0]][0][0];
+		const float* m1 = &palette[vertex.boneIDs[1]][0][0];
+		const float* m2 = &palette[vertex.boneIDs[2]][0][0];
+		const float* m3 = &palette[vertex.boneIDs[3]][0][0];
+		const __m256 w0 = _mm256_set1_ps(vertex.boneWeights[0]);
+		const __m256 w1 = _mm256_set1_ps(vertex.boneWeights[1]);
+		const __m256 w2 = _mm256_set1_ps(vertex.boneWeights[2]);
+		const __m256 w3 = _mm256_set1_ps(vertex.boneWeights[3]);
+		*c01 = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(
+			_mm256_mul_ps(w0, _mm256_loadu_ps(m0)), _mm256_mul_ps(w1, _mm256_loadu_ps(m1))),
+			_mm256_mul_ps(w2, _mm256_loadu_ps(m2))), _mm256_mul_ps(w3, _mm256_loadu_ps(m3)));
+		*c23 = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(
+			_mm256_mul_ps(w0, _mm256_loadu_ps(m0 + 8)), _mm256_mul_ps(w1, _mm256_loadu_ps(m1 + 8))),
+			_mm256_mul_ps(w2, _mm256_loadu_ps(m2 + 8))), _mm256_mul_ps(w3, _mm256_loadu_ps(m3 + 8)));
+	}
+
+	//(c0 * x + c2 * z) + (c1 * y + c3 * w)
+	static inline __m128 transformAVX(__m256 c01, __m256 c23, const glm::vec3& v, float w) {
+		const __m128 xyzw = _mm_setr_ps(v.x, v.y, v.z, w);
+		const __m256 both = _mm256_insertf128_ps(_mm256_castps128_ps256(xyzw), xyzw, 1);
+		//x in the low half and y in the high half, then z and w
+		const __m256 xy = _mm256_permutevar_ps(both, _mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1));
+		const __m256 zw = _mm256_permutevar_ps(both, _mm256_setr_epi32(2, 2, 2, 2, 3, 3, 3, 3));
+		const __m256 r = _mm256_add_ps(_mm256_mul_ps(c01, xy), _mm256_mul_ps(c23, zw));
+		return _mm_add_ps(_mm256_castps256_ps128(r), _mm256_extractf128_ps(r, 1));
+	}
+
+	static void skinVerticesAVX(const ew::MeshData& meshData, const glm::mat4* palette, size_t begin, size_t end, const ew::SkinningOutput& output) {
+		for (size_t i = begin; i < end; i++)
+		{
+			const Vertex& vertex = meshData.vertices[i];
+			__m256 c01, c23;
+			blendPaletteAVX(vertex, palette, &c01, &c23);
+			storeVec3(&output.positions[i], transformAVX(c01, c23, vertex.pos, 1.0f));
+			if (output.normals != nullptr) {
+				storeVec3(&output.normals[i], normalize3(transformAVX(c01, c23, vertex.normal, 0.0f)));
+			}
+			if (output.tangents != nullptr) {
+				storeVec3(&output.tangents[i], normalize3(transformAVX(c01, c23, vertex.tangent, 0.0f)));
+			}
+		}
+	}
+#elif defined(EW_SIMD_SSE)
+	static inline void blendPaletteSSE(const ew::Vertex& vertex, const glm::mat4* palette, __m128 c[4]) {
+		if (!isWeighted(vertex)) {
+			c[0] = _mm_setr_ps(1, 0, 0, 0);
+			c[1] = _mm_setr_ps(0, 1, 0, 0);
+			c[2] = _mm_setr_ps(0, 0, 1, 0);
+			c[3] = _mm_setr_ps(0, 0, 0, 1);
+			return;
+		}
+		const float* m0 = &palette[vertex.boneIDs[0]][0][0];
+		const float* m1 = &palette[vertex.boneIDs[1]][0][0];
+		const float* m2 = &palette[vertex.boneIDs[2]][0][0];
+		const float* m3 = &palette[vertex.boneIDs[3]][0][0];
+		const __m128 w0 = _mm_set1_ps(vertex.boneWeights[0]);
+		const __m128 w1 = _mm_set1_ps(vertex.boneWeights[1]);
+		const __m128 w2 = _mm_set1_ps(vertex.boneWeights[2]);
+		const __m128 w3 = _mm_set1_ps(vertex.boneWeights[3]);
+		for (int col = 0; col < 4; col++)
+		{
+			c[col] = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(w0, _mm_loadu_ps(m0 + col * 4)), _mm_mul_ps(w1, _mm_loadu_ps(m1 + col * 4))),
+				_mm_mul_ps(w2, _mm_loadu_ps(m2 + col * 4))), _mm_mul_ps(w3, _mm_loadu_ps(m3 + col * 4)));
+		}
+	}
+
+	//(c0 * x + c2 * z) + (c1 * y + c3 * w)
+	static inline __m128 transformSSE(const __m128 c[4], const glm::vec3& v, float w) {
+		return _mm_add_ps(
+			_mm_add_ps(_mm_mul_ps(c[0], _mm_set1_ps(v.x)), _mm_mul_ps(c[2], _mm_set1_ps(v.z))),
+			_mm_add_ps(_mm_mul_ps(c[1], _mm_set1_ps(v.y)), _mm_mul_ps(c[3], _mm_set1_ps(w))));
+	}
+
+	static void skinVerticesSSE(const ew::MeshData& meshData, const glm::mat4* palette, size_t begin, size_t end, const ew::SkinningOutput& output) {
+		for (size_t i = begin; i < end; i++)
+		{
+			const Vertex& vertex = meshData.vertices[i];
+			__m128 c[4];
+			blendPaletteSSE(vertex, palette, c);
+			storeVec3(&output.positions[i], transformSSE(c, vertex.pos, 1.0f));
+			if (output.normals != nullptr) {
+				storeVec3(&output.normals[i], normalize3(transformSSE(c, vertex.normal, 0.0f)));
+			}
+			if (output.tangents != nullptr) {
+				storeVec3(&output.tangents[i], normalize3(transformSSE(c, vertex.tangent, 0.0f)));
+			}
+		}
+	}
+#endif
+
+	void skinVertices(const ew::MeshData& meshData, const glm::mat4* palette, size_t begin, size_t end, const ew::SkinningOutput& output) {
+#if defined(EW_SIMD_AVX)
+		skinVerticesAVX(meshData, palette, begin, end, output);
+#elif defined(EW_SIMD_SSE)
+		skinVerticesSSE(meshData, palette, begin, end, output);
+#else
+		skinVerticesReference(meshData, palette, begin, end, output);
+#endif
+	}
+
+	void skinMesh(const ew::MeshData& meshData, const glm::mat4* palette, const ew::SkinningOutput& output, ew::WorkerPool* pool) {
+		const size_t numVertices = meshData.vertices.size();
+		if (pool == nullptr) {
+			pool = &ew::getDefaultWorkerPool();
+		}
+		const size_t maxThreads = glm::max(numVertices / MIN_SKINNING_VERTICES_PER_THREAD, (size_t)1);
+		const size_t numPartitions = glm::min((size_t)pool->getNumThreads(), maxThreads);
+		pool->run((int)numPartitions, [&](int p) {
+			skinVertices(meshData, palette, numVertices * p / numPartitions, numVertices * (p + 1) / numPartitions, output);
+		});
+	}
+}
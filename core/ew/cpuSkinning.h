@@ -0,0 +1,27 @@
+#pragma once
+#include "mesh.h"
+#include "workerPool.h"
+
+namespace ew {
+	//Caller owned output arrays, one element per vertex of the mesh.
+	//normals and tangents may be null to skip them.
+	struct SkinningOutput {
+		glm::vec3* positions = nullptr;
+		glm::vec3* normals = nullptr;
+		glm::vec3* tangents = nullptr;
+	};
+	//Ranges smaller than this are not split across threads
+	const size_t MIN_SKINNING_VERTICES_PER_THREAD = 4096;
+
+	/// <summary>
+	/// Scalar linear blend skinning of vertices [begin, end).
+	/// Blends palette matrices by weight, transforms position, normal and tangent, and normalizes the directions.
+	/// Uses the same operation order as the SIMD kernels, so results match them bit for bit.
+	/// core/CMakeLists.txt turns off FMA contraction for cpuSkinning.cpp to keep it that way.
+	/// </summary>
+	void skinVerticesReference(const ew::MeshData& meshData, const glm::mat4* palette, size_t begin, size_t end, const ew::SkinningOutput& output);
+	//Same as skinVerticesReference using the widest SIMD kernel available (AVX, SSE, or scalar)
+	void skinVertices(const ew::MeshData& meshData, const glm::mat4* palette, size_t begin, size_t end, const ew::SkinningOutput& output);
+	//Skins the whole mesh, split into contiguous vertex ranges across pool's threads, or getDefaultWorkerPool() if null.
+	void skinMesh(const ew::MeshData& meshData, const glm::mat4* palette, const ew::SkinningOutput& output, ew::WorkerPool* pool = nullptr);
+}
@@ -0,0 +1,402 @@
+#include "ik.h"
+#include "simd.h"
+
+namespace ew {
+	//Two-bone batch arrays, each holding one component per chain
+	enum TwoBoneArray {
+		TWO_BONE_A = 0, //Root position xyz
+		TWO_BONE_B = 3, //Mid position xyz
+		TWO_BONE_C = 6, //End position xyz
+		TWO_BONE_TARGET = 9,
+		TWO_BONE_POLE = 12,
+		TWO_BONE_ROOT_ROTATION = 15, //Output xyzw, world space about A
+		TWO_BONE_MID_ROTATION = 19, //Output xyzw, world space about B, applied before the root rotation
+		TWO_BONE_NUM_ARRAYS = 23
+	};
+
+	static float* getBatchLanes(ew::IKBatch* batch, size_t numTasks, size_t numArrays) {
+		batch->stride = simdPaddedSize(numTasks);
+		if (batch->lanes.size() < batch->stride * numArrays) {
+			batch->lanes.resize(batch->stride * numArrays);
+		}
+		return batch->lanes.data();
+	}
+
+	static inline void storeLanes3(float* lanes, size_t stride, int array, size_t i, const glm::vec3& v) {
+		lanes[array * stride + i] = v.x;
+		lanes[(array + 1) * stride + i] = v.y;
+		lanes[(array + 2) * stride + i] = v.z;
+	}
+
+	static inline glm::vec3 loadLanes3(const float* lanes, size_t stride, int array, size_t i) {
+		return glm::vec3(lanes[array * stride + i], lanes[(array + 1) * stride + i], lanes[(array + 2) * stride + i]);
+	}
+
+	//SIMD 3D vector math, one vector per lane
+	template<typename V>
+	struct Vec3Lanes {
+		V x, y, z;
+	};
+
+	template<typename V>
+	static inline Vec3Lanes<V> loadVec3(const float* lanes, size_t stride, int array, size_t i) {
+		return { vload(lanes + array * stride + i, V()), vload(lanes + (array + 1) * stride + i, V()), vload(lanes + (array + 2) * stride + i, V()) };
+	}
+	template<typename V>
+	static inline void storeVec3(float* lanes, size_t stride, int array, size_t i, const Vec3Lanes<V>& v) {
+		vstore(lanes + array * stride + i, v.x);
+		vstore(lanes + (array + 1) * stride + i, v.y);
+		vstore(lanes + (array + 2) * stride + i, v.z);
+	}
+	template<typename V>
+	static inline Vec3Lanes<V> sub3(const Vec3Lanes<V>& a, const Vec3Lanes<V>& b) {
+		return { vsub(a.x, b.x), vsub(a.y, b.y), vsub(a.z, b.z) };
+	}
+	template<typename V>
+	static inline Vec3Lanes<V> add3(const Vec3Lanes<V>& a, const Vec3Lanes<V>& b) {
+		return { vadd(a.x, b.x), vadd(a.y, b.y), vadd(a.z, b.z) };
+	}
+	template<typename V>
+	static inline Vec3Lanes<V> scale3(const Vec3Lanes<V>& a, V s) {
+		return { vmul(a.x, s), vmul(a.y, s), vmul(a.z, s) };
+	}
+	template<typename V>
+	static inline V dot3(const Vec3Lanes<V>& a, const Vec3Lanes<V>& b) {
+		return vadd(vadd(vmul(a.x, b.x), vmul(a.y, b.y)), vmul(a.z, b.z));
+	}
+	template<typename V>
+	static inline Vec3Lanes<V> cross3(const Vec3Lanes<V>& a, const Vec3Lanes<V>& b) {
+		return { vsub(vmul(a.y, b.z), vmul(a.z, b.y)), vsub(vmul(a.z, b.x), vmul(a.x, b.z)), vsub(vmul(a.x, b.y), vmul(a.y, b.x)) };
+	}
+	template<typename V>
+	static inline V length3(const Vec3Lanes<V>& a) {
+		return vsqrt(dot3(a, a));
+	}
+	//Zero vectors stay zero
+	template<typename V>
+	static inline Vec3Lanes<V> normalize3(const Vec3Lanes<V>& a) {
+		return scale3(a, vdiv(vset(1.0f, V()), vsqrt(vadd(dot3(a, a), vset(1e-20f, V())))));
+	}
+
+	template<typename V>
+	struct QuatLanes {
+		V x, y, z, w;
+	};
+
+	template<typename V>
+	static inline QuatLanes<V> multiplyQuat(const QuatLanes<V>& a, const QuatLanes<V>& b) {
+		QuatLanes<V> r;
+		multiplyQuatLanes(a.x, a.y, a.z, a.w, b.x, b.y, b.z, b.w, &r.x, &r.y, &r.z, &r.w);
+		return r;
+	}
+	template<typename V>
+	static inline Vec3Lanes<V> rotate3(const QuatLanes<V>& q, const Vec3Lanes<V>& v) {
+		//v + 2 * (w * (q x v) + q x (q x v))
+		const Vec3Lanes<V> u = { q.x, q.y, q.z };
+		const Vec3Lanes<V> uv = cross3(u, v);
+		const Vec3Lanes<V> uuv = cross3(u, uv);
+		return add3(v, scale3(add3(scale3(uv, q.w), uuv), vset(2.0f, V())));
+	}
+	//Shortest rotation taking unit vector from to unit vector to. Identity if either is zero.
+	template<typename V>
+	static inline QuatLanes<V> quatBetween(const Vec3Lanes<V>& from, const Vec3Lanes<V>& to) {
+		const Vec3Lanes<V> axis = cross3(from, to);
+		const V w = vadd(vset(1.0f, V()), dot3(from, to));
+		const V invLength = vdiv(vset(1.0f, V()), vsqrt(vadd(vadd(dot3(axis, axis), vmul(w, w)), vset(1e-20f, V()))));
+		return { vmul(axis.x, invLength), vmul(axis.y, invLength), vmul(axis.z, invLength), vmul(w, invLength) };
+	}
+	//Rotation about a unit axis by the angle with this cosine and sine. Half angle identities, no trig calls.
+	template<typename V>
+	static inline QuatLanes<V> quatFromCosSin(V cosAngle, V sinAngle, const Vec3Lanes<V>& axis) {
+		const V zero = vset(0.0f, V()), one = vset(1.0f, V()), half = vset(0.5f, V());
+		const V halfCos = vsqrt(vmax(zero, vmul(vadd(one, cosAngle), half)));
+		const V halfSin = vmul(vsqrt(vmax(zero, vmul(vsub(one, cosAngle), half))), vsign(sinAngle));
+		return { vmul(axis.x, halfSin), vmul(axis.y, halfSin), vmul(axis.z, halfSin), halfCos };
+	}
+	//Rotation by angle(cosTo) - angle(cosFrom) about a unit axis, for angles in [0, pi]
+	template<typename V>
+	static inline QuatLanes<V> quatAngleDifference(V cosTo, V cosFrom, const Vec3Lanes<V>& axis) {
+		const V zero = vset(0.0f, V()), one = vset(1.0f, V());
+		const V sinTo = vsqrt(vmax(zero, vsub(one, vmul(cosTo, cosTo))));
+		const V sinFrom = vsqrt(vmax(zero, vsub(one, vmul(cosFrom, cosFrom))));
+		return quatFromCosSin(vadd(vmul(cosTo, cosFrom), vmul(sinTo, sinFrom)), vsub(vmul(sinTo, cosFrom), vmul(cosTo, sinFrom)), axis);
+	}
+	//Rotation about unit axis n taking from onto to, both perpendicular to n. Identity if either is zero.
+	template<typename V>
+	static inline QuatLanes<V> quatAboutAxis(const Vec3Lanes<V>& from, const Vec3Lanes<V>& to, const Vec3Lanes<V>& n) {
+		const V cosScaled = dot3(from, to);
+		const V sinScaled = dot3(n, cross3(from, to));
+		const V scale = vsqrt(vadd(vmul(cosScaled, cosScaled), vmul(sinScaled, sinScaled)));
+		const V cosAngle = vselectLess(scale, vset(1e-12f, V()), vset(1.0f, V()), vdiv(cosScaled, vmax(scale, vset(1e-12f, V()))));
+		return quatFromCosSin(cosAngle, sinScaled, n);
+	}
+	//fallback where primary is shorter than threshold
+	template<typename V>
+	static inline Vec3Lanes<V> selectShort(const Vec3Lanes<V>& primary, V threshold, const Vec3Lanes<V>& fallback) {
+		const V length = length3(primary);
+		return { vselectLess(length, threshold, fallback.x, primary.x), vselectLess(length, threshold, fallback.y, primary.y), vselectLess(length, threshold, fallback.z, primary.z) };
+	}
+	template<typename V>
+	static inline V clampCos(V v) {
+		return vmin(vmax(v, vset(-1.0f, V())), vset(1.0f, V()));
+	}
+
+	/// <summary>
+	/// Solves two-bone chains by the law of cosines, after Holden, "Simple Two Joint IK".
+	/// The root and mid joint are bent so the root to end distance matches the target, keeping the direction from root to end.
+	/// Then the root swings that direction onto the target and twists the mid joint toward the pole.
+	/// </summary>
+	template<typename V>
+	static inline void solveTwoBoneLanes(float* lanes, size_t stride, size_t i) {
+		const Vec3Lanes<V> a = loadVec3<V>(lanes, stride, TWO_BONE_A, i);
+		const Vec3Lanes<V> b = loadVec3<V>(lanes, stride, TWO_BONE_B, i);
+		const Vec3Lanes<V> c = loadVec3<V>(lanes, stride, TWO_BONE_C, i);
+		const Vec3Lanes<V> target = loadVec3<V>(lanes, stride, TWO_BONE_TARGET, i);
+		const Vec3Lanes<V> pole = loadVec3<V>(lanes, stride, TWO_BONE_POLE, i);
+		const V tiny = vset(1e-20f, V());
+
+		const Vec3Lanes<V> ab = sub3(b, a), cb = sub3(c, b), ac = sub3(c, a), at = sub3(target, a);
+		const V lab = length3(ab), lcb = length3(cb), lac = length3(ac);
+		//Slightly short of full extension so the knee never locks straight
+		const V lat = vmin(vmax(length3(at), vset(1e-5f, V())), vmul(vadd(lab, lcb), vset(0.9999f, V())));
+		const V minusTwoLab = vmul(lab, vset(-2.0f, V()));
+
+		//Current and wanted angles at the root (between ac and ab) and at the mid joint (between ba and bc)
+		const V cosRoot0 = clampCos(vdiv(dot3(ac, ab), vadd(vmul(lac, lab), tiny)));
+		const V cosMid0 = clampCos(vdiv(vsub(vset(0.0f, V()), dot3(ab, cb)), vadd(vmul(lab, lcb), tiny)));
+		const V cosRoot1 = clampCos(vdiv(vsub(vsub(vmul(lcb, lcb), vmul(lab, lab)), vmul(lat, lat)), vadd(vmul(minusTwoLab, lat), tiny)));
+		const V cosMid1 = clampCos(vdiv(vsub(vsub(vmul(lat, lat), vmul(lab, lab)), vmul(lcb, lcb)), vadd(vmul(minusTwoLab, lcb), tiny)));
+
+		//Bend in the plane of the chain. A straight chain bends toward the pole instead, or any perpendicular without one.
+		const V straight = vmul(vmul(lac, lab), vset(1e-4f, V()));
+		const V zero = vset(0.0f, V()), one = vset(1.0f, V());
+		Vec3Lanes<V> axis = selectShort(cross3(ac, pole), straight, selectShort(cross3(ac, Vec3Lanes<V>{ one, zero, zero }), straight, cross3(ac, Vec3Lanes<V>{ zero, zero, one })));
+		axis = normalize3(selectShort(cross3(ac, ab), straight, axis));
+		const QuatLanes<V> rootBend = quatAngleDifference(cosRoot1, cosRoot0, axis);
+		const QuatLanes<V> midBend = quatAngleDifference(cosMid1, cosMid0, axis);
+
+		const Vec3Lanes<V> targetDirection = normalize3(at);
+		QuatLanes<V> rootRotation = multiplyQuat(quatBetween(normalize3(ac), targetDirection), rootBend);
+
+		//Twist about the target direction so the mid joint faces the pole
+		const Vec3Lanes<V> bendDirection = rotate3(rootRotation, ab);
+		const Vec3Lanes<V> midOffset = sub3(bendDirection, scale3(targetDirection, dot3(bendDirection, targetDirection)));
+		const Vec3Lanes<V> poleOffset = sub3(pole, scale3(targetDirection, dot3(pole, targetDirection)));
+		rootRotation = multiplyQuat(quatAboutAxis(midOffset, poleOffset, targetDirection), rootRotation);
+
+		vstore(lanes + TWO_BONE_ROOT_ROTATION * stride + i, rootRotation.x);
+		vstore(lanes + (TWO_BONE_ROOT_ROTATION + 1) * stride + i, rootRotation.y);
+		vstore(lanes + (TWO_BONE_ROOT_ROTATION + 2) * stride + i, rootRotation.z);
+		vstore(lanes + (TWO_BONE_ROOT_ROTATION + 3) * stride + i, rootRotation.w);
+		vstore(lanes + TWO_BONE_MID_ROTATION * stride + i, midBend.x);
+		vstore(lanes + (TWO_BONE_MID_ROTATION + 1) * stride + i, midBend.y);
+		vstore(lanes + (TWO_BONE_MID_ROTATION + 2) * stride + i, midBend.z);
+		vstore(lanes + (TWO_BONE_MID_ROTATION + 3) * stride + i, midBend.w);
+	}
+
+	static inline glm::quat loadLanesQuat(const float* lanes, size_t stride, int array, size_t i) {
+		return glm::quat(lanes[(array + 3) * stride + i], lanes[array * stride + i], lanes[(array + 1) * stride + i], lanes[(array + 2) * stride + i]);
+	}
+
+	//World space rotation by q about point
+	static inline glm::mat4 rotateAbout(const glm::quat& q, const glm::vec3& point) {
+		return glm::translate(glm::mat4(1), point) * glm::toMat4(q) * glm::translate(glm::mat4(1), -point);
+	}
+
+	//Sets the local transform that gives bone newWorld under a parent whose world matrix is parentWorld
+	static inline void writeBackBone(const ew::IKTask& task, int bone, const glm::mat4& newWorld, const glm::mat4& parentWorld) {
+		ew::setLocalTransform(task.skeleton, bone, task.skeleton->bones[bone].parentIndex == -1 ? newWorld : glm::inverse(parentWorld) * newWorld);
+		(*task.worldMatrices)[bone] = newWorld;
+	}
+
+	static inline glm::mat4 getParentWorld(const ew::IKTask& task, int bone) {
+		int parent = task.skeleton->bones[bone].parentIndex;
+		return parent == -1 ? glm::mat4(1) : (*task.worldMatrices)[parent];
+	}
+
+	void solveTwoBoneIKBatch(const ew::IKTask* tasks, size_t numTasks, ew::IKBatch* batch) {
+		float* lanes = getBatchLanes(batch, numTasks, TWO_BONE_NUM_ARRAYS);
+		const size_t stride = batch->stride;
+		for (size_t t = 0; t < numTasks; t++)
+		{
+			const std::vector<glm::mat4>& world = *tasks[t].worldMatrices;
+			const std::vector<int>& bones = tasks[t].chain->bones;
+			storeLanes3(lanes, stride, TWO_BONE_A, t, glm::vec3(world[bones[0]][3]));
+			storeLanes3(lanes, stride, TWO_BONE_B, t, glm::vec3(world[bones[1]][3]));
+			storeLanes3(lanes, stride, TWO_BONE_C, t, glm::vec3(world[bones[2]][3]));
+			storeLanes3(lanes, stride, TWO_BONE_TARGET, t, tasks[t].target);
+			storeLanes3(lanes, stride, TWO_BONE_POLE, t, tasks[t].pole);
+		}
+		//Padding lanes are solved too and ignored
+		size_t i = 0;
+#ifdef EW_SIMD_AVX
+		for (; i + 8 <= stride; i += 8) solveTwoBoneLanes<__m256>(lanes, stride, i);
+#endif
+#ifdef EW_SIMD_SSE
+		for (; i + 4 <= stride; i += 4) solveTwoBoneLanes<__m128>(lanes, stride, i);
+#endif
+		for (; i < numTasks; i++) solveTwoBoneLanes<float>(lanes, stride, i);
+
+		for (size_t t = 0; t < numTasks; t++)
+		{
+			const ew::IKTask& task = tasks[t];
+			std::vector<glm::mat4>& world = *task.worldMatrices;
+			const int root = task.chain->bones[0], mid = task.chain->bones[1], end = task.chain->bones[2];
+			const glm::mat4 rootDelta = rotateAbout(loadLanesQuat(lanes, stride, TWO_BONE_ROOT_ROTATION, t), loadLanes3(lanes, stride, TWO_BONE_A, t));
+			const glm::mat4 midDelta = rootDelta * rotateAbout(loadLanesQuat(lanes, stride, TWO_BONE_MID_ROTATION, t), loadLanes3(lanes, stride, TWO_BONE_B, t));
+			//Bones between root and mid move rigidly with the root
+			const int midParent = task.skeleton->bones[mid].parentIndex;
+			const glm::mat4 midParentWorld = midParent == root ? rootDelta * world[root] : rootDelta * world[midParent];
+			const glm::mat4 endWorld = midDelta * world[end];
+			writeBackBone(task, root, rootDelta * world[root], getParentWorld(task, root));
+			writeBackBone(task, mid, midDelta * world[mid], midParentWorld);
+			world[end] = endWorld;
+		}
+	}
+
+	//FABRIK batch arrays for chains of n bones: n joint positions xyz, n - 1 bone lengths, target xyz, root xyz
+	static inline int fabrikJoint(int j) { return j * 3; }
+	static inline int fabrikLength(int numBones, int j) { return numBones * 3 + j; }
+	static inline int fabrikTarget(int numBones) { return numBones * 4 - 1; }
+	static inline int fabrikRoot(int numBones) { return numBones * 4 + 2; }
+	static inline int fabrikNumArrays(int numBones) { return numBones * 4 + 5; }
+
+	//Pulls targets out of reach back onto the sphere the chain can reach, so the chain ends up pointing at them
+	template<typename V>
+	static inline void clampFABRIKTargetLanes(float* lanes, size_t stride, int numBones, size_t i) {
+		V reach = vset(0.0f, V());
+		for (int j = 0; j + 1 < numBones; j++)
+		{
+			reach = vadd(reach, vload(lanes + fabrikLength(numBones, j) * stride + i, V()));
+		}
+		const Vec3Lanes<V> root = loadVec3<V>(lanes, stride, fabrikRoot(numBones), i);
+		const Vec3Lanes<V> toTarget = sub3(loadVec3<V>(lanes, stride, fabrikTarget(numBones), i), root);
+		const V scale = vmin(vset(1.0f, V()), vdiv(reach, vmax(length3(toTarget), vset(1e-10f, V()))));
+		storeVec3(lanes, stride, fabrikTarget(numBones), i, add3(root, scale3(toTarget, scale)));
+	}
+
+	//Places joint "to" along the direction from "from", one bone length away
+	template<typename V>
+	static inline Vec3Lanes<V> placeJoint(const Vec3Lanes<V>& from, const Vec3Lanes<V>& to, V length) {
+		return add3(from, scale3(normalize3(sub3(to, from)), length));
+	}
+
+	//One backward pass from the target and one forward pass from the root
+	template<typename V>
+	static inline void iterateFABRIKLanes(float* lanes, size_t stride, int numBones, size_t i) {
+		Vec3Lanes<V> next = loadVec3<V>(lanes, stride, fabrikTarget(numBones), i);
+		storeVec3(lanes, stride, fabrikJoint(numBones - 1), i, next);
+		for (int j = numBones - 2; j >= 0; j--)
+		{
+			next = placeJoint(next, loadVec3<V>(lanes, stride, fabrikJoint(j), i), vload(lanes + fabrikLength(numBones, j) * stride + i, V()));
+			storeVec3(lanes, stride, fabrikJoint(j), i, next);
+		}
+		Vec3Lanes<V> prev = loadVec3<V>(lanes, stride, fabrikRoot(numBones), i);
+		storeVec3(lanes, stride, fabrikJoint(0), i, prev);
+		for (int j = 0; j + 1 < numBones; j++)
+		{
+			prev = placeJoint(prev, loadVec3<V>(lanes, stride, fabrikJoint(j + 1), i), vload(lanes + fabrikLength(numBones, j) * stride + i, V()));
+			storeVec3(lanes, stride, fabrikJoint(j + 1), i, prev);
+		}
+	}
+
+	static bool fabrikConverged(const float* lanes, size_t stride, int numBones, size_t numTasks, float tolerance) {
+		for (size_t t = 0; t < numTasks; t++)
+		{
+			glm::vec3 end = loadLanes3(lanes, stride, fabrikJoint(numBones - 1), t);
+			glm::vec3 target = loadLanes3(lanes, stride, fabrikTarget(numBones), t);
+			if (glm::length(end - target) > tolerance)
+				return false;
+		}
+		return true;
+	}
+
+	//Tasks whose chains all have numBones bones
+	static void solveFABRIKRun(const ew::IKTask* tasks, size_t numTasks, int numBones, ew::IKBatch* batch, const ew::FABRIKSettings& settings) {
+		if (numBones < 2)
+			return;
+		float* lanes = getBatchLanes(batch, numTasks, fabrikNumArrays(numBones));
+		const size_t stride = batch->stride;
+		for (size_t t = 0; t < numTasks; t++)
+		{
+			const std::vector<glm::mat4>& world = *tasks[t].worldMatrices;
+			const std::vector<int>& bones = tasks[t].chain->bones;
+			for (int j = 0; j < numBones; j++)
+			{
+				storeLanes3(lanes, stride, fabrikJoint(j), t, glm::vec3(world[bones[j]][3]));
+			}
+			for (int j = 0; j + 1 < numBones; j++)
+			{
+				lanes[fabrikLength(numBones, j) * stride + t] = glm::length(glm::vec3(world[bones[j + 1]][3] - world[bones[j]][3]));
+			}
+			storeLanes3(lanes, stride, fabrikTarget(numBones), t, tasks[t].target);
+			storeLanes3(lanes, stride, fabrikRoot(numBones), t, glm::vec3(world[bones[0]][3]));
+		}
+		size_t i = 0;
+#ifdef EW_SIMD_AVX
+		for (; i + 8 <= stride; i += 8) clampFABRIKTargetLanes<__m256>(lanes, stride, numBones, i);
+#endif
+#ifdef EW_SIMD_SSE
+		for (; i + 4 <= stride; i += 4) clampFABRIKTargetLanes<__m128>(lanes, stride, numBones, i);
+#endif
+		for (; i < numTasks; i++) clampFABRIKTargetLanes<float>(lanes, stride, numBones, i);
+
+		for (int iteration = 0; iteration < settings.maxIterations; iteration++)
+		{
+			if (fabrikConverged(lanes, stride, numBones, numTasks, settings.tolerance))
+				break;
+			i = 0;
+#ifdef EW_SIMD_AVX
+			for (; i + 8 <= stride; i += 8) iterateFABRIKLanes<__m256>(lanes, stride, numBones, i);
+#endif
+#ifdef EW_SIMD_SSE
+			for (; i + 4 <= stride; i += 4) iterateFABRIKLanes<__m128>(lanes, stride, numBones, i);
+#endif
+			for (; i < numTasks; i++) iterateFABRIKLanes<float>(lanes, stride, numBones, i);
+		}
+
+		//Rotate each bone so its child lands on the solved joint, carrying the change down the chain
+		for (size_t t = 0; t < numTasks; t++)
+		{
+			const ew::IKTask& task = tasks[t];
+			std::vector<glm::mat4>& world = *task.worldMatrices;
+			const std::vector<int>& bones = task.chain->bones;
+			glm::mat4 carried(1);
+			glm::mat4 previousWorld; //World matrix of bones[j - 1] before it was overwritten
+			for (int j = 0; j + 1 < numBones; j++)
+			{
+				const int parent = task.skeleton->bones[bones[j]].parentIndex;
+				const glm::mat4 parentWorld = parent == -1 ? glm::mat4(1) : carried * (j > 0 && parent == bones[j - 1] ? previousWorld : world[parent]);
+				previousWorld = world[bones[j]];
+				const glm::mat4 boneWorld = carried * world[bones[j]];
+				const glm::vec3 position = glm::vec3(boneWorld[3]);
+				const glm::vec3 childPosition = glm::vec3((carried * world[bones[j + 1]])[3]);
+				const glm::vec3 solvedChild = loadLanes3(lanes, stride, fabrikJoint(j + 1), t);
+				const glm::quat rotation = glm::rotation(glm::normalize(childPosition - position), glm::normalize(solvedChild - position));
+				carried = rotateAbout(rotation, position) * carried;
+				writeBackBone(task, bones[j], rotateAbout(rotation, position) * boneWorld, parentWorld);
+			}
+			world[bones[numBones - 1]] = carried * world[bones[numBones - 1]];
+		}
+	}
+
+	void solveFABRIKBatch(const ew::IKTask* tasks, size_t numTasks, ew::IKBatch* batch, const ew::FABRIKSettings& settings) {
+		//Lanes are laid out for one chain length, so each run of equal length chains is its own batch
+		size_t runStart = 0;
+		for (size_t t = 1; t <= numTasks; t++)
+		{
+			if (t == numTasks || tasks[t].chain->bones.size() != tasks[runStart].chain->bones.size()) {
+				solveFABRIKRun(tasks + runStart, t - runStart, (int)tasks[runStart].chain->bones.size(), batch, settings);
+				runStart = t;
+			}
+		}
+	}
+
+	void solveTwoBoneIK(const ew::IKTask& task, ew::IKBatch* batch) {
+		solveTwoBoneIKBatch(&task, 1, batch);
+	}
+
+	void solveFABRIK(const ew::IKTask& task, ew::IKBatch* batch, const ew::FABRIKSettings& settings) {
+		solveFABRIKBatch(&task, 1, batch, settings);
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include "animation.h"
+
+namespace ew {
+	//Bones from the root of a chain to its end effector. Each bone must be a descendant of the one before it.
+	//Two-bone IK uses exactly 3 bones: root, mid joint and end, such as upper leg, lower leg and foot.
+	struct IKChain {
+		std::vector<int> bones;
+	};
+	//One chain of one character to solve
+	struct IKTask {
+		ew::Skeleton* skeleton;
+		std::vector<glm::mat4>* worldMatrices; //From solveFK of skeleton
+		const ew::IKChain* chain;
+		glm::vec3 target; //World space position for the end effector
+		glm::vec3 pole = glm::vec3(0); //World space direction the mid joint bends toward. Zero keeps the current bend. Two-bone only.
+	};
+	struct FABRIKSettings {
+		int maxIterations = 10;
+		float tolerance = 0.001f; //Stop once every end effector is this close to its target
+	};
+
+	/// <summary>
+	/// Structure-of-arrays scratch for the batch solvers, one lane per chain.
+	/// Reused between calls and only reallocated when a batch grows.
+	/// </summary>
+	struct IKBatch {
+		size_t stride = 0;
+		std::vector<float> lanes; //Indexed [array * stride + chain]
+	};
+
+	/// <summary>
+	/// Analytic two-bone IK on many chains. Positions are gathered into an IKBatch, solved 4 or 8 chains at a time,
+	/// and the rotations are written back into the local transforms of each root and mid bone.
+	/// Targets out of reach leave the chain pointing straight at them.
+	/// worldMatrices of the chain bones are updated and the rotated bones are marked dirty. Call solveFKIncremental
+	/// to update the rest of their descendants.
+	/// </summary>
+	void solveTwoBoneIKBatch(const ew::IKTask* tasks, size_t numTasks, ew::IKBatch* batch);
+	/// <summary>
+	/// FABRIK on many chains. Iterates until every chain is within tolerance.
+	/// Chains are batched while they have the same number of bones, so sort tasks by chain length.
+	/// Each run of equal length chains is solved as its own batch.
+	/// Results are written back the same way as solveTwoBoneIKBatch, with every bone but the end effector rotated.
+	/// </summary>
+	void solveFABRIKBatch(const ew::IKTask* tasks, size_t numTasks, ew::IKBatch* batch, const ew::FABRIKSettings& settings = ew::FABRIKSettings());
+
+	//Single chain versions. Prefer the batch versions for many characters.
+	//batch is scratch. Reuse it between calls so they don't allocate.
+	void solveTwoBoneIK(const ew::IKTask& task, ew::IKBatch* batch);
+	void solveFABRIK(const ew::IKTask& task, ew::IKBatch* batch, const ew::FABRIKSettings& settings = ew::FABRIKSettings());
+}
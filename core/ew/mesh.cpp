@@ -6,60 +6,136 @@
 */
 
 #include "mesh.h"
+#include "vertexPacking.h"
 #include "external/glad.h"
+#include <stdio.h>
 
 namespace ew {
-	Mesh::Mesh(const MeshData& meshData)
+	Mesh::Mesh(const MeshData& meshData, VertexFormat format, const PositionQuantization* quantization)
 	{
-		load(meshData);
+		load(meshData, format, quantization);
 	}
-	void Mesh::load(const MeshData& meshData)
-	{
-		if (!m_initialized) {
-			glGenVertexArrays(1, &m_vao);
-			glBindVertexArray(m_vao);
-
-			glGenBuffers(1, &m_vbo);
-			glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
-
-			glGenBuffers(1, &m_ebo);
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+	//Points attributes at the vertex buffer bound to GL_ARRAY_BUFFER
+	static void setVertexAttributes(const VertexLayout& layout) {
+		const GLsizei stride = layout.stride;
+		if (layout.format == VertexFormat::FULL) {
 			//Position attribute
-			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)offsetof(Vertex, pos));
-			glEnableVertexAttribArray(0);
-
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (const void*)(size_t)layout.pos);
 			//Normal attribute
-			glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)offsetof(Vertex, normal));
-			glEnableVertexAttribArray(1);
-
+			glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (const void*)(size_t)layout.normal);
 			//UV attribute
-			glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)(offsetof(Vertex, uv)));
-			glEnableVertexAttribArray(2);
-
+			glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (const void*)(size_t)layout.uv);
 			//Tangent attribute
-			glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)(offsetof(Vertex, tangent)));
-			glEnableVertexAttribArray(3);
-
-			//Bone IDs attribute
-			glVertexAttribPointer(4, 4, GL_UNSIGNED_SHORT, GL_FALSE, sizeof(Vertex), (const void*)(offsetof(Vertex, boneIDs)));
-			glEnableVertexAttribArray(4);
-
+			glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, stride, (const void*)(size_t)layout.tangent);
+			//Bone IDs attribute. Integer attribute, read as uvec4 in shaders.
+			glVertexAttribIPointer(4, 4, GL_UNSIGNED_SHORT, stride, (const void*)(size_t)layout.boneIDs);
 			//Bone Weights attribute
-			glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)(offsetof(Vertex, boneWeights)));
-			glEnableVertexAttribArray(5);
+			glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, stride, (const void*)(size_t)layout.boneWeights);
+		}
+		else {
+			//Position attribute. Quantized positions read as 0-1, dequantized in the shader.
+			if (layout.format == VertexFormat::PACKED_QUANTIZED) {
+				glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride, (const void*)(size_t)layout.pos);
+			}
+			else {
+				glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (const void*)(size_t)layout.pos);
+			}
+			//Normal and tangent attributes. Octahedral, read as vec2 and decoded in the shader.
+			glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, stride, (const void*)(size_t)layout.normal);
+			glVertexAttribPointer(3, 2, GL_SHORT, GL_TRUE, stride, (const void*)(size_t)layout.tangent);
+			//UV attribute
+			glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, (const void*)(size_t)layout.uv);
+			if (layout.boneIDs >= 0) {
+				glVertexAttribIPointer(4, 4, GL_UNSIGNED_BYTE, stride, (const void*)(size_t)layout.boneIDs);
+				glVertexAttribPointer(5, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (const void*)(size_t)layout.boneWeights);
+			}
+		}
+		const bool hasBones = layout.boneIDs >= 0;
+		for (unsigned int i = 0; i < 6; i++)
+		{
+			if (i < 4 || hasBones) {
+				glEnableVertexAttribArray(i);
+			}
+			else {
+				glDisableVertexAttribArray(i);
+			}
+		}
+	}
+	void Mesh::load(const MeshData& meshData, VertexFormat format, const PositionQuantization* quantization)
+	{
+		bool skinned = false;
+		bool fitsPacked = true;
+		for (const Vertex& vertex : meshData.vertices)
+		{
+			for (int i = 0; i < MAX_BONE_WEIGHTS; i++)
+			{
+				if (vertex.boneWeights[i] > 0.0f) {
+					skinned = true;
+					fitsPacked &= vertex.boneIDs[i] <= 255;
+				}
+			}
+		}
+		if (format != VertexFormat::FULL && !fitsPacked) {
+			printf("Mesh has bone IDs above 255, loading it unpacked\n");
+			format = VertexFormat::FULL;
+		}
+		m_layout = ew::getVertexLayout(format, skinned);
+		m_positionQuantization = PositionQuantization();
+		if (format == VertexFormat::PACKED_QUANTIZED) {
+			if (quantization) {
+				m_positionQuantization = *quantization;
+			}
+			else {
+				AABB bounds;
+				for (const Vertex& vertex : meshData.vertices)
+				{
+					bounds.min = glm::min(bounds.min, vertex.pos);
+					bounds.max = glm::max(bounds.max, vertex.pos);
+				}
+				m_positionQuantization = makePositionQuantization(bounds);
+			}
+		}
 
+		if (!m_initialized) {
+			glGenVertexArrays(1, &m_vao);
+			glGenBuffers(1, &m_vbo);
+			glGenBuffers(1, &m_ebo);
 			m_initialized = true;
 		}
 
 		glBindVertexArray(m_vao);
 		glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+		setVertexAttributes(m_layout);
 
 		if (meshData.vertices.size() > 0) {
-			glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * meshData.vertices.size(), meshData.vertices.data(), GL_STATIC_DRAW);
+			const GLenum usage = m_dynamicVertices ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW;
+			if (format == VertexFormat::FULL) {
+				glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * meshData.vertices.size(), meshData.vertices.data(), usage);
+			}
+			else {
+				std::vector<uint8_t> packed((size_t)m_layout.stride * meshData.vertices.size());
+				packVertices(meshData.vertices.data(), 0, meshData.vertices.size(), m_layout, m_positionQuantization, packed.data());
+				glBufferData(GL_ARRAY_BUFFER, packed.size(), packed.data(), usage);
+			}
 		}
+		//16 bit indices when every vertex is addressable with them, halving the index buffer
+		m_indexSize = meshData.vertices.size() <= 65536 ? 2 : 4;
+		m_lods.clear();
 		if (meshData.indices.size() > 0) {
-			glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * meshData.indices.size(), meshData.indices.data(), GL_STATIC_DRAW);
+			std::vector<unsigned int> indices = meshData.indices;
+			for (const MeshLODData& lod : meshData.lods)
+			{
+				m_lods.push_back({ (unsigned int)indices.size(), (unsigned int)lod.indices.size(), lod.error });
+				indices.insert(indices.end(), lod.indices.begin(), lod.indices.end());
+			}
+			if (m_indexSize == 2) {
+				std::vector<unsigned short> shortIndices(indices.begin(), indices.end());
+				glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned short) * shortIndices.size(), shortIndices.data(), GL_STATIC_DRAW);
+			}
+			else {
+				glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * indices.size(), indices.data(), GL_STATIC_DRAW);
+			}
 		}
 		m_numVertices = meshData.vertices.size();
 		m_numIndices = meshData.indices.size();
@@ -72,20 +148,77 @@ namespace ew {
 	{
 		glBindVertexArray(m_vao);
 		if (drawMode == DrawMode::TRIANGLES) {
-			glDrawElements(GL_TRIANGLES, m_numIndices, GL_UNSIGNED_INT, NULL);
+			glDrawElements(GL_TRIANGLES, m_numIndices, m_indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, NULL);
 		}
 		else {
 			glDrawArrays(GL_POINTS, 0, m_numVertices);
 		}
 	}
 
+	void Mesh::drawLOD(int lod) const
+	{
+		if (lod <= 0 || lod > (int)m_lods.size()) {
+			draw();
+			return;
+		}
+		const LOD& level = m_lods[lod - 1];
+		glBindVertexArray(m_vao);
+		glDrawElements(GL_TRIANGLES, level.numIndices, m_indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, (const void*)((size_t)level.firstIndex * m_indexSize));
+	}
+
 	void Mesh::drawInstanced(DrawMode drawMode, int instanceCount)const {
 		glBindVertexArray(m_vao);
 		if (drawMode == DrawMode::TRIANGLES) {
-			glDrawElementsInstanced(GL_TRIANGLES, m_numIndices, GL_UNSIGNED_INT, NULL, instanceCount);
+			glDrawElementsInstanced(GL_TRIANGLES, m_numIndices, m_indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, NULL, instanceCount);
 		}
 		else {
 			glDrawArraysInstanced(GL_POINTS, 0, m_numVertices, instanceCount);
 		}
 	}
-}
\ No newline at end of file
+
+	void Mesh::setInstanceAttributes(const glm::vec4* data, int numInstances, int vec4sPerInstance) {
+		glBindVertexArray(m_vao);
+		if (m_instanceVbo == 0) {
+			glGenBuffers(1, &m_instanceVbo);
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, m_instanceVbo);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec4) * vec4sPerInstance * numInstances, data, GL_DYNAMIC_DRAW);
+		for (int i = 0; i < vec4sPerInstance; i++)
+		{
+			const unsigned int location = INSTANCE_ATTRIBUTE_LOCATION + i;
+			glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4) * vec4sPerInstance, (const void*)(sizeof(glm::vec4) * i));
+			glEnableVertexAttribArray(location);
+			glVertexAttribDivisor(location, 1);
+		}
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	void Mesh::updateVertices(const Vertex* vertices, size_t first, size_t count) {
+		if (count == 0 || first + count > m_numVertices)
+			return;
+		glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+		//Respecify once with a dynamic usage hint, as drivers may place static buffers where updates are slow
+		const bool respecify = !m_dynamicVertices;
+		if (respecify) {
+			m_dynamicVertices = true;
+			first = 0;
+			count = m_numVertices;
+		}
+		const size_t stride = m_layout.stride;
+		const void* data = vertices + first;
+		std::vector<uint8_t> packed;
+		if (m_layout.format != VertexFormat::FULL) {
+			packed.resize(stride * count);
+			packVertices(vertices, first, count, m_layout, m_positionQuantization, packed.data());
+			data = packed.data();
+		}
+		if (respecify) {
+			glBufferData(GL_ARRAY_BUFFER, stride * count, data, GL_DYNAMIC_DRAW);
+		}
+		else {
+			glBufferSubData(GL_ARRAY_BUFFER, stride * first, stride * count, data);
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+}
@@ -5,9 +5,12 @@
 #pragma once
 #include <glm/glm.hpp>
 #include <vector>
+#include <stddef.h>
 
 namespace ew {
 #define MAX_BONE_WEIGHTS 4
+//First attribute location of per instance data set with Mesh::setInstanceAttributes
+#define INSTANCE_ATTRIBUTE_LOCATION 6
 	struct Vertex {
 		glm::vec3 pos;
 		glm::vec3 normal;
@@ -17,9 +20,38 @@ namespace ew {
 		float boneWeights[MAX_BONE_WEIGHTS];
 	};
 
+	enum class VertexFormat {
+		FULL = 0, //Vertex as is, 68 bytes
+		PACKED = 1, //Float positions, octahedral 16 bit normals and tangents, half float UVs, 8 bit bone IDs and weights. 32 bytes, 24 without bones.
+		PACKED_QUANTIZED = 2 //PACKED with 16 bit positions, see PositionQuantization. 28 bytes, 20 without bones.
+	};
+	//Byte offsets of attributes within a vertex. -1 if the attribute is not stored.
+	struct VertexLayout {
+		VertexFormat format = VertexFormat::FULL;
+		int stride = sizeof(Vertex);
+		int pos = offsetof(Vertex, pos);
+		int normal = offsetof(Vertex, normal);
+		int uv = offsetof(Vertex, uv);
+		int tangent = offsetof(Vertex, tangent);
+		int boneIDs = offsetof(Vertex, boneIDs);
+		int boneWeights = offsetof(Vertex, boneWeights);
+	};
+	//Quantized positions are offset + scale * (q / 65535). Packed shaders apply it with _PositionOffset and _PositionScale.
+	struct PositionQuantization {
+		glm::vec3 offset = glm::vec3(0);
+		glm::vec3 scale = glm::vec3(1);
+	};
+
+	//Coarser index list over the same vertices
+	struct MeshLODData {
+		std::vector<unsigned int> indices;
+		float error = 0; //Estimated distance from the full mesh, in mesh units. See simplifyMesh.
+	};
+
 	struct MeshData {
 		std::vector<Vertex> vertices;
 		std::vector<unsigned int> indices;
+		std::vector<MeshLODData> lods; //Increasingly coarse, see generateMeshLODs
 	};
 
 	enum class DrawMode {
@@ -30,19 +62,51 @@ namespace ew {
 	class Mesh {
 	public:
 		Mesh() {};
-		Mesh(const MeshData& meshData);
-		void load(const MeshData& meshData);
+		Mesh(const MeshData& meshData, VertexFormat format = VertexFormat::FULL, const PositionQuantization* quantization = nullptr);
+		//Packed formats drop bone attributes when no vertex has weights. quantization null fits the mesh's own bounds.
+		//Falls back to FULL if a bone ID does not fit in 8 bits.
+		void load(const MeshData& meshData, VertexFormat format = VertexFormat::FULL, const PositionQuantization* quantization = nullptr);
 		void draw(DrawMode drawMode = DrawMode::TRIANGLES)const;
+		//Draws a level of detail from MeshData::lods, 1 being the first coarse one. 0 or out of range levels draw the full mesh.
+		void drawLOD(int lod)const;
 		void drawInstanced(DrawMode drawMode, int instanceCount)const;
+		//Uploads vec4sPerInstance vec4 attributes per instance, at locations INSTANCE_ATTRIBUTE_LOCATION and up.
+		//They advance once per instance in drawInstanced.
+		void setInstanceAttributes(const glm::vec4* data, int numInstances, int vec4sPerInstance);
+		//Uploads vertices [first, first + count) of the full array vertices, such as the range a morph pass changed.
+		//The first call switches the vertex buffer to a dynamic one. Packed formats repack the range, and quantized
+		//positions outside the bounds the mesh was loaded with are clamped.
+		void updateVertices(const Vertex* vertices, size_t first, size_t count);
 		inline int getNumVertices()const { return m_numVertices; }
 		inline int getNumIndices()const { return m_numIndices; }
+		//Levels of detail including the full mesh, so at least 1
+		inline int getNumLODs()const { return (int)m_lods.size() + 1; }
+		inline int getLODNumIndices(int lod)const { return lod <= 0 ? m_numIndices : m_lods[lod - 1].numIndices; }
+		//Estimated distance of a level from the full mesh, in mesh units
+		inline float getLODError(int lod)const { return lod <= 0 ? 0.0f : m_lods[lod - 1].error; }
+		//2 or 4 bytes, picked by load from the vertex count
+		inline int getIndexSize()const { return m_indexSize; }
+		inline const VertexLayout& getVertexLayout()const { return m_layout; }
+		inline const PositionQuantization& getPositionQuantization()const { return m_positionQuantization; }
 		unsigned int getVaoID() const { return m_vao; }
 	private:
 		bool m_initialized = false;
 		unsigned int m_vao = 0;
 		unsigned int m_vbo = 0;
 		unsigned int m_ebo = 0;
+		unsigned int m_instanceVbo = 0;
+		bool m_dynamicVertices = false;
+		VertexLayout m_layout;
+		PositionQuantization m_positionQuantization;
 		unsigned int m_numVertices = 0;
 		unsigned int m_numIndices = 0;
+		int m_indexSize = 4;
+		//Coarse levels are stored after the full index list in the same index buffer
+		struct LOD {
+			unsigned int firstIndex;
+			unsigned int numIndices;
+			float error;
+		};
+		std::vector<LOD> m_lods;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,440 @@
+#include "meshOptimizer.h"
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace ew {
+	void MeshOptimizationReport::add(const MeshOptimizationReport& other) {
+		const int totalTriangles = triangles + other.triangles;
+		if (totalTriangles > 0) {
+			const float a = (float)triangles / totalTriangles;
+			const float b = (float)other.triangles / totalTriangles;
+			acmrBefore = acmrBefore * a + other.acmrBefore * b;
+			acmrAfter = acmrAfter * a + other.acmrAfter * b;
+			atvrBefore = atvrBefore * a + other.atvrBefore * b;
+			atvrAfter = atvrAfter * a + other.atvrAfter * b;
+		}
+		verticesBefore += other.verticesBefore;
+		verticesAfter += other.verticesAfter;
+		triangles = totalTriangles;
+		milliseconds += other.milliseconds;
+	}
+
+	//FIFO cache simulated with timestamps. A vertex is cached if it missed within the last cacheSize misses.
+	struct FifoCache {
+		std::vector<unsigned int> timestamps;
+		unsigned int timestamp;
+		unsigned int cacheSize;
+		FifoCache(size_t numVertices, int cacheSize) : timestamps(numVertices, 0), timestamp(cacheSize + 1), cacheSize(cacheSize) {}
+		//Returns 1 on a miss
+		inline int access(unsigned int v) {
+			if (timestamp - timestamps[v] > cacheSize) {
+				timestamps[v] = timestamp++;
+				return 1;
+			}
+			return 0;
+		}
+		inline int accessTriangle(const unsigned int* triangle) {
+			return access(triangle[0]) + access(triangle[1]) + access(triangle[2]);
+		}
+		inline void clear() {
+			timestamp += cacheSize + 1;
+		}
+	};
+
+	static size_t countMisses(const std::vector<unsigned int>& indices, size_t numVertices, int cacheSize) {
+		FifoCache cache(numVertices, cacheSize);
+		size_t misses = 0;
+		for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		{
+			misses += cache.accessTriangle(&indices[i]);
+		}
+		return misses;
+	}
+
+	float computeACMR(const std::vector<unsigned int>& indices, size_t numVertices, int cacheSize) {
+		const size_t numTriangles = indices.size() / 3;
+		return numTriangles > 0 ? (float)countMisses(indices, numVertices, cacheSize) / numTriangles : 0.0f;
+	}
+
+	float computeATVR(const std::vector<unsigned int>& indices, size_t numVertices, int cacheSize) {
+		std::vector<bool> referenced(numVertices, false);
+		size_t numReferenced = 0;
+		for (unsigned int index : indices)
+		{
+			if (!referenced[index]) {
+				referenced[index] = true;
+				numReferenced++;
+			}
+		}
+		return numReferenced > 0 ? (float)countMisses(indices, numVertices, cacheSize) / numReferenced : 0.0f;
+	}
+
+	static uint32_t hashVertex(const ew::Vertex& vertex) {
+		uint32_t words[sizeof(Vertex) / 4];
+		memcpy(words, &vertex, sizeof(words));
+		//Murmur2 style mixing
+		uint32_t hash = 0;
+		for (uint32_t k : words)
+		{
+			k *= 0x5bd1e995;
+			k ^= k >> 24;
+			k *= 0x5bd1e995;
+			hash = (hash * 0x5bd1e995) ^ k;
+		}
+		return hash;
+	}
+
+	size_t weldVertices(ew::MeshData* meshData, std::vector<unsigned int>* remap) {
+		static_assert(sizeof(Vertex) % 4 == 0, "hashVertex reads whole words");
+		const std::vector<Vertex>& vertices = meshData->vertices;
+		size_t tableSize = 1;
+		while (tableSize < vertices.size() * 2)
+			tableSize *= 2;
+		//Open addressing with linear probing. Slots hold new vertex index + 1, 0 is empty.
+		std::vector<unsigned int> table(tableSize, 0);
+		std::vector<unsigned int> vertexRemap(vertices.size());
+		std::vector<Vertex> unique;
+		unique.reserve(vertices.size());
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			size_t slot = hashVertex(vertices[i]) & (tableSize - 1);
+			while (table[slot] != 0 && memcmp(&unique[table[slot] - 1], &vertices[i], sizeof(Vertex)) != 0)
+			{
+				slot = (slot + 1) & (tableSize - 1);
+			}
+			if (table[slot] == 0) {
+				unique.push_back(vertices[i]);
+				table[slot] = (unsigned int)unique.size();
+			}
+			vertexRemap[i] = table[slot] - 1;
+		}
+		for (unsigned int& index : meshData->indices)
+		{
+			index = vertexRemap[index];
+		}
+		meshData->vertices = std::move(unique);
+		if (remap) {
+			*remap = std::move(vertexRemap);
+		}
+		return meshData->vertices.size();
+	}
+
+	//Forsyth's scoring constants, from "Linear-Speed Vertex Cache Optimisation"
+	const float CACHE_DECAY_POWER = 1.5f;
+	const float LAST_TRIANGLE_SCORE = 0.75f;
+	const float VALENCE_BOOST_SCALE = 2.0f;
+	const float VALENCE_BOOST_POWER = 0.5f;
+
+	const unsigned int VALENCE_TABLE_SIZE = 32;
+	struct ForsythScoreTables {
+		float cache[VERTEX_CACHE_OPTIMIZE_SIZE];
+		float valence[VALENCE_TABLE_SIZE];
+		ForsythScoreTables() {
+			for (int i = 0; i < VERTEX_CACHE_OPTIMIZE_SIZE; i++)
+			{
+				//The last triangle's vertices score the same, so its edges are not favored over each other
+				cache[i] = i < 3 ? LAST_TRIANGLE_SCORE : powf(1.0f - (i - 3) * (1.0f / (VERTEX_CACHE_OPTIMIZE_SIZE - 3)), CACHE_DECAY_POWER);
+			}
+			valence[0] = 0.0f;
+			for (unsigned int i = 1; i < VALENCE_TABLE_SIZE; i++)
+			{
+				valence[i] = VALENCE_BOOST_SCALE * powf((float)i, -VALENCE_BOOST_POWER);
+			}
+		}
+	};
+	static const ForsythScoreTables forsythScoreTables;
+
+	static float forsythVertexScore(int cachePosition, unsigned int remainingTriangles) {
+		if (remainingTriangles == 0)
+			return -1.0f;
+		const float cacheScore = cachePosition >= 0 ? forsythScoreTables.cache[cachePosition] : 0.0f;
+		const float valenceScore = remainingTriangles < VALENCE_TABLE_SIZE ? forsythScoreTables.valence[remainingTriangles]
+			: VALENCE_BOOST_SCALE * powf((float)remainingTriangles, -VALENCE_BOOST_POWER);
+		return cacheScore + valenceScore;
+	}
+
+	void optimizeVertexCache(std::vector<unsigned int>* indices, size_t numVertices) {
+		const size_t numTriangles = indices->size() / 3;
+		if (numTriangles == 0)
+			return;
+		const std::vector<unsigned int>& input = *indices;
+
+		//Triangles of each vertex. remaining shrinks as triangles are emitted.
+		std::vector<unsigned int> offsets(numVertices + 1, 0);
+		std::vector<unsigned int> remaining(numVertices, 0);
+		for (size_t i = 0; i < numTriangles * 3; i++)
+		{
+			remaining[input[i]]++;
+		}
+		for (size_t v = 0; v < numVertices; v++)
+		{
+			offsets[v + 1] = offsets[v] + remaining[v];
+		}
+		std::vector<unsigned int> adjacency(numTriangles * 3);
+		std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+		for (size_t t = 0; t < numTriangles; t++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				adjacency[fill[input[t * 3 + k]]++] = (unsigned int)t;
+			}
+		}
+
+		std::vector<int> cachePositions(numVertices, -1);
+		std::vector<float> vertexScores(numVertices);
+		for (size_t v = 0; v < numVertices; v++)
+		{
+			vertexScores[v] = forsythVertexScore(-1, remaining[v]);
+		}
+		std::vector<float> triangleScores(numTriangles);
+		std::vector<bool> emitted(numTriangles, false);
+		int bestTriangle = 0;
+		for (size_t t = 0; t < numTriangles; t++)
+		{
+			triangleScores[t] = vertexScores[input[t * 3]] + vertexScores[input[t * 3 + 1]] + vertexScores[input[t * 3 + 2]];
+			if (triangleScores[t] > triangleScores[bestTriangle]) {
+				bestTriangle = (int)t;
+			}
+		}
+
+		std::vector<unsigned int> output(numTriangles * 3);
+		std::vector<unsigned int> cache, newCache;
+		cache.reserve(VERTEX_CACHE_OPTIMIZE_SIZE + 3);
+		newCache.reserve(VERTEX_CACHE_OPTIMIZE_SIZE + 3);
+		size_t scanCursor = 0;
+		for (size_t i = 0; i < numTriangles; i++)
+		{
+			if (bestTriangle < 0) {
+				//Nothing in the cache has triangles left. Continue from the next unemitted triangle in input order.
+				while (emitted[scanCursor])
+					scanCursor++;
+				bestTriangle = (int)scanCursor;
+			}
+			const unsigned int* triangle = &input[bestTriangle * 3];
+			memcpy(&output[i * 3], triangle, sizeof(unsigned int) * 3);
+			emitted[bestTriangle] = true;
+			for (int k = 0; k < 3; k++)
+			{
+				const unsigned int v = triangle[k];
+				unsigned int* begin = &adjacency[offsets[v]];
+				unsigned int* end = begin + remaining[v];
+				*std::find(begin, end, (unsigned int)bestTriangle) = *(end - 1);
+				remaining[v]--;
+			}
+
+			//Triangle's vertices move to the front of the LRU cache
+			newCache.assign(triangle, triangle + 3);
+			for (unsigned int v : cache)
+			{
+				if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+					newCache.push_back(v);
+				}
+			}
+			//Rescore cached vertices, including those just evicted, and pick the best triangle touching them
+			bestTriangle = -1;
+			float bestScore = -1.0f;
+			for (size_t c = 0; c < newCache.size(); c++)
+			{
+				const unsigned int v = newCache[c];
+				cachePositions[v] = c < VERTEX_CACHE_OPTIMIZE_SIZE ? (int)c : -1;
+				vertexScores[v] = forsythVertexScore(cachePositions[v], remaining[v]);
+			}
+			for (unsigned int v : newCache)
+			{
+				for (unsigned int a = offsets[v]; a < offsets[v] + remaining[v]; a++)
+				{
+					const unsigned int t = adjacency[a];
+					const unsigned int* other = &input[t * 3];
+					triangleScores[t] = vertexScores[other[0]] + vertexScores[other[1]] + vertexScores[other[2]];
+					if (triangleScores[t] > bestScore) {
+						bestScore = triangleScores[t];
+						bestTriangle = (int)t;
+					}
+				}
+			}
+			if (newCache.size() > VERTEX_CACHE_OPTIMIZE_SIZE) {
+				newCache.resize(VERTEX_CACHE_OPTIMIZE_SIZE);
+			}
+			std::swap(cache, newCache);
+		}
+		*indices = std::move(output);
+	}
+
+	void optimizeOverdraw(std::vector<unsigned int>* indices, const std::vector<ew::Vertex>& vertices, float threshold) {
+		const size_t numTriangles = indices->size() / 3;
+		if (numTriangles == 0)
+			return;
+		const std::vector<unsigned int>& input = *indices;
+
+		//Hard boundaries: triangles that miss on all 3 vertices, where the cache effectively restarts
+		std::vector<size_t> hardBoundaries = { 0 };
+		FifoCache cache(vertices.size(), VERTEX_CACHE_MEASURE_SIZE);
+		for (size_t t = 0; t < numTriangles; t++)
+		{
+			if (cache.accessTriangle(&input[t * 3]) == 3 && t > 0) {
+				hardBoundaries.push_back(t);
+			}
+		}
+		hardBoundaries.push_back(numTriangles);
+
+		//Split hard clusters further wherever the part so far is within threshold of the cluster's own ACMR.
+		//Each cluster then starts with a cold cache, so reordering them costs at most threshold.
+		std::vector<size_t> clusterStarts;
+		for (size_t h = 0; h + 1 < hardBoundaries.size(); h++)
+		{
+			const size_t start = hardBoundaries[h];
+			const size_t end = hardBoundaries[h + 1];
+			cache.clear();
+			size_t clusterMisses = 0;
+			for (size_t t = start; t < end; t++)
+			{
+				clusterMisses += cache.accessTriangle(&input[t * 3]);
+			}
+			const float missesPerTriangle = threshold * clusterMisses / (end - start);
+			cache.clear();
+			clusterStarts.push_back(start);
+			size_t softStart = start;
+			size_t softMisses = 0;
+			for (size_t t = start; t < end; t++)
+			{
+				softMisses += cache.accessTriangle(&input[t * 3]);
+				if (t + 1 < end && softMisses <= (t + 1 - softStart) * missesPerTriangle) {
+					clusterStarts.push_back(t + 1);
+					cache.clear();
+					softStart = t + 1;
+					softMisses = 0;
+				}
+			}
+		}
+		clusterStarts.push_back(numTriangles);
+		const size_t numClusters = clusterStarts.size() - 1;
+
+		glm::vec3 meshCenter = glm::vec3(0);
+		for (const Vertex& vertex : vertices)
+		{
+			meshCenter += vertex.pos;
+		}
+		meshCenter /= (float)glm::max(vertices.size(), (size_t)1);
+
+		//Clusters facing away from the center occlude the most, so draw them first
+		std::vector<float> sortKeys(numClusters);
+		for (size_t c = 0; c < numClusters; c++)
+		{
+			glm::vec3 areaNormal = glm::vec3(0);
+			glm::vec3 centroid = glm::vec3(0);
+			float area = 0.0f;
+			for (size_t t = clusterStarts[c]; t < clusterStarts[c + 1]; t++)
+			{
+				const glm::vec3& a = vertices[input[t * 3]].pos;
+				const glm::vec3& b = vertices[input[t * 3 + 1]].pos;
+				const glm::vec3& p = vertices[input[t * 3 + 2]].pos;
+				const glm::vec3 normal = glm::cross(b - a, p - a);
+				const float triangleArea = glm::length(normal);
+				areaNormal += normal;
+				centroid += (a + b + p) * (triangleArea / 3.0f);
+				area += triangleArea;
+			}
+			const float normalLength = glm::length(areaNormal);
+			if (area <= 0.0f || normalLength <= 0.0f) {
+				sortKeys[c] = 0.0f;
+				continue;
+			}
+			centroid /= area;
+			sortKeys[c] = glm::dot(centroid - meshCenter, areaNormal / normalLength);
+		}
+		std::vector<size_t> order(numClusters);
+		for (size_t c = 0; c < numClusters; c++)
+		{
+			order[c] = c;
+		}
+		std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sortKeys[a] > sortKeys[b]; });
+
+		std::vector<unsigned int> output;
+		output.reserve(input.size());
+		for (size_t c : order)
+		{
+			output.insert(output.end(), input.begin() + clusterStarts[c] * 3, input.begin() + clusterStarts[c + 1] * 3);
+		}
+		*indices = std::move(output);
+	}
+
+	size_t optimizeVertexFetch(ew::MeshData* meshData, std::vector<unsigned int>* remap) {
+		std::vector<unsigned int> vertexRemap(meshData->vertices.size(), ~0u);
+		std::vector<Vertex> ordered;
+		ordered.reserve(meshData->vertices.size());
+		for (unsigned int& index : meshData->indices)
+		{
+			if (vertexRemap[index] == ~0u) {
+				vertexRemap[index] = (unsigned int)ordered.size();
+				ordered.push_back(meshData->vertices[index]);
+			}
+			index = vertexRemap[index];
+		}
+		meshData->vertices = std::move(ordered);
+		if (remap) {
+			*remap = std::move(vertexRemap);
+		}
+		return meshData->vertices.size();
+	}
+
+	//Composes remap with a later pass's remap
+	static void chainRemap(std::vector<unsigned int>* remap, const std::vector<unsigned int>& next) {
+		for (unsigned int& index : *remap)
+		{
+			if (index != ~0u) {
+				index = next[index];
+			}
+		}
+	}
+
+	MeshOptimizationReport optimizeMesh(ew::MeshData* meshData, const ew::MeshOptimizationSettings& settings, std::vector<unsigned int>* remap) {
+		auto startTime = std::chrono::high_resolution_clock::now();
+		MeshOptimizationReport report;
+		report.verticesBefore = (int)meshData->vertices.size();
+		report.triangles = (int)(meshData->indices.size() / 3);
+		report.acmrBefore = computeACMR(meshData->indices, meshData->vertices.size());
+		report.atvrBefore = computeATVR(meshData->indices, meshData->vertices.size());
+		if (remap) {
+			remap->resize(meshData->vertices.size());
+			for (size_t i = 0; i < remap->size(); i++)
+			{
+				(*remap)[i] = (unsigned int)i;
+			}
+		}
+
+		std::vector<unsigned int> passRemap;
+		if (settings.weld) {
+			weldVertices(meshData, &passRemap);
+			if (remap) {
+				chainRemap(remap, passRemap);
+			}
+		}
+		if (settings.vertexCache) {
+			optimizeVertexCache(&meshData->indices, meshData->vertices.size());
+		}
+		if (settings.overdraw) {
+			optimizeOverdraw(&meshData->indices, meshData->vertices, settings.overdrawThreshold);
+		}
+		if (settings.vertexFetch) {
+			optimizeVertexFetch(meshData, &passRemap);
+			if (remap) {
+				chainRemap(remap, passRemap);
+			}
+		}
+
+		report.verticesAfter = (int)meshData->vertices.size();
+		report.acmrAfter = computeACMR(meshData->indices, meshData->vertices.size());
+		report.atvrAfter = computeATVR(meshData->indices, meshData->vertices.size());
+		std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - startTime;
+		report.milliseconds = elapsed.count();
+		return report;
+	}
+
+	void printMeshOptimizationReport(const char* name, const ew::MeshOptimizationReport& report) {
+		printf("Mesh optimization %s: %d -> %d vertices, %d triangles, %.2f ms\n", name, report.verticesBefore, report.verticesAfter, report.triangles, report.milliseconds);
+		printf("   ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", report.acmrBefore, report.acmrAfter, report.atvrBefore, report.atvrAfter);
+	}
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include "mesh.h"
+#include <stdint.h>
+
+namespace ew {
+	//FIFO cache size used to measure ACMR and ATVR, typical of post transform caches
+	const int VERTEX_CACHE_MEASURE_SIZE = 16;
+	//LRU cache size the Forsyth scores are tuned for
+	const int VERTEX_CACHE_OPTIMIZE_SIZE = 32;
+
+	struct MeshOptimizationSettings {
+		bool weld = true; //Merge bitwise identical vertices
+		bool vertexCache = true;
+		bool overdraw = true;
+		//Overdraw reordering may raise ACMR up to this factor
+		float overdrawThreshold = 1.05f;
+		bool vertexFetch = true;
+	};
+	struct MeshOptimizationReport {
+		int verticesBefore = 0;
+		int verticesAfter = 0;
+		int triangles = 0;
+		//Average cache miss ratio: transformed vertices per triangle. 0.5 is ideal for large regular meshes, 3 is worst.
+		float acmrBefore = 0;
+		float acmrAfter = 0;
+		//Average transformed vertex ratio: transformed vertices per vertex. 1 is ideal.
+		float atvrBefore = 0;
+		float atvrAfter = 0;
+		float milliseconds = 0;
+		void add(const MeshOptimizationReport& other); //Sums counts, weighting ratios by triangles
+	};
+
+	//Simulates a FIFO cache of cacheSize and returns misses per triangle
+	float computeACMR(const std::vector<unsigned int>& indices, size_t numVertices, int cacheSize = VERTEX_CACHE_MEASURE_SIZE);
+	//Misses per referenced vertex
+	float computeATVR(const std::vector<unsigned int>& indices, size_t numVertices, int cacheSize = VERTEX_CACHE_MEASURE_SIZE);
+
+	//Merges bitwise identical vertices through a hash table and returns the new vertex count.
+	//Every byte of Vertex is hashed and compared, bone fields included, so vertices must be fully
+	//initialized (Vertex v = {}), as Model and procGen build them.
+	//remap, if not null, gets the new index of every old vertex.
+	size_t weldVertices(ew::MeshData* meshData, std::vector<unsigned int>* remap = nullptr);
+	/// <summary>
+	/// Reorders triangles for post transform cache reuse with Forsyth's linear speed algorithm.
+	/// Each step emits the highest scoring triangle next to the simulated LRU cache. Vertex scores
+	/// favor recently used vertices and vertices with few triangles left, so fans are finished before moving on.
+	/// </summary>
+	void optimizeVertexCache(std::vector<unsigned int>* indices, size_t numVertices);
+	/// <summary>
+	/// Reorders cache optimized triangles to reduce overdraw, after Sander et al. 2007.
+	/// Triangles are split into clusters where the cache restarts, and clusters facing away from the mesh center
+	/// are drawn first, as they tend to occlude the rest from most views. Clusters are kept long enough that
+	/// ACMR stays within threshold of the input's.
+	/// </summary>
+	void optimizeOverdraw(std::vector<unsigned int>* indices, const std::vector<ew::Vertex>& vertices, float threshold = 1.05f);
+	//Orders vertices by first use in the index buffer and drops unreferenced ones. Returns the new vertex count.
+	//remap, if not null, gets the new index of every old vertex, or ~0u if it was dropped.
+	size_t optimizeVertexFetch(ew::MeshData* meshData, std::vector<unsigned int>* remap = nullptr);
+
+	//Runs the enabled passes in order: weld, vertex cache, overdraw, vertex fetch.
+	//remap, if not null, gets the final index of every input vertex, or ~0u if it was dropped.
+	MeshOptimizationReport optimizeMesh(ew::MeshData* meshData, const ew::MeshOptimizationSettings& settings = ew::MeshOptimizationSettings(), std::vector<unsigned int>* remap = nullptr);
+	void printMeshOptimizationReport(const char* name, const ew::MeshOptimizationReport& report);
+}
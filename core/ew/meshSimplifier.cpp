@@ -0,0 +1,406 @@
+#include "meshSimplifier.h"
+#include "meshOptimizer.h"
+#include <algorithm>
+#include <unordered_map>
+#include <math.h>
+#include <string.h>
+
+namespace ew {
+	//Sum of weighted squared linear forms (n.p + d)^2, as p'Ap + 2b.p + c. Doubles, as the terms cancel closely.
+	struct Quadric {
+		double a00 = 0, a11 = 0, a22 = 0, a01 = 0, a02 = 0, a12 = 0;
+		double b0 = 0, b1 = 0, b2 = 0;
+		double c = 0;
+		double w = 0;
+		void addPlane(double nx, double ny, double nz, double d, double weight) {
+			a00 += weight * nx * nx; a11 += weight * ny * ny; a22 += weight * nz * nz;
+			a01 += weight * nx * ny; a02 += weight * nx * nz; a12 += weight * ny * nz;
+			b0 += weight * nx * d; b1 += weight * ny * d; b2 += weight * nz * d;
+			c += weight * d * d;
+			w += weight;
+		}
+		void add(const Quadric& o) {
+			a00 += o.a00; a11 += o.a11; a22 += o.a22; a01 += o.a01; a02 += o.a02; a12 += o.a12;
+			b0 += o.b0; b1 += o.b1; b2 += o.b2;
+			c += o.c;
+			w += o.w;
+		}
+		double eval(const glm::vec3& p) const {
+			const double x = p.x, y = p.y, z = p.z;
+			return a00 * x * x + a11 * y * y + a22 * z * z + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z)
+				+ 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+		}
+	};
+	//Hoppe's attribute quadric: sum of (g.p + d - s)^2 where g.p + d is a face's linear attribute field
+	struct AttributeQuadric {
+		Quadric field;
+		double g0 = 0, g1 = 0, g2 = 0, d = 0; //Weighted sums of g and d
+		void addGradient(double gx, double gy, double gz, double gd, double weight) {
+			field.addPlane(gx, gy, gz, gd, weight);
+			g0 += weight * gx; g1 += weight * gy; g2 += weight * gz;
+			d += weight * gd;
+		}
+		void add(const AttributeQuadric& o) {
+			field.add(o.field);
+			g0 += o.g0; g1 += o.g1; g2 += o.g2;
+			d += o.d;
+		}
+		double eval(const glm::vec3& p, double s) const {
+			return field.eval(p) - 2.0 * s * (g0 * p.x + g1 * p.y + g2 * p.z + d) + s * s * field.w;
+		}
+	};
+	//u, v, normal x, y, z
+	const int NUM_SIMPLIFY_ATTRIBUTES = 5;
+
+	//Groups vertices with bitwise equal positions. Returns the number of groups.
+	static unsigned int groupPositions(const std::vector<ew::Vertex>& vertices, std::vector<unsigned int>* group) {
+		std::unordered_map<uint64_t, std::vector<unsigned int>> buckets;
+		group->resize(vertices.size());
+		std::vector<unsigned int> representatives;
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			uint32_t bits[3];
+			memcpy(bits, &vertices[i].pos, sizeof(bits));
+			const uint64_t key = ((uint64_t)bits[0] * 73856093u) ^ ((uint64_t)bits[1] * 19349663u) ^ ((uint64_t)bits[2] * 83492791u);
+			std::vector<unsigned int>& bucket = buckets[key];
+			unsigned int found = ~0u;
+			for (unsigned int g : bucket)
+			{
+				if (memcmp(&vertices[representatives[g]].pos, &vertices[i].pos, sizeof(glm::vec3)) == 0) {
+					found = g;
+					break;
+				}
+			}
+			if (found == ~0u) {
+				found = (unsigned int)representatives.size();
+				representatives.push_back((unsigned int)i);
+				bucket.push_back(found);
+			}
+			(*group)[i] = found;
+		}
+		return (unsigned int)representatives.size();
+	}
+
+	static bool isDegenerate(const unsigned int* triangle, const std::vector<unsigned int>& group) {
+		const unsigned int g0 = group[triangle[0]], g1 = group[triangle[1]], g2 = group[triangle[2]];
+		return g0 == g1 || g0 == g2 || g1 == g2;
+	}
+
+	std::vector<unsigned int> simplifyMesh(const std::vector<ew::Vertex>& vertices, const std::vector<unsigned int>& indices, size_t targetIndexCount, const ew::SimplifySettings& settings, float* resultError) {
+		const size_t numVertices = vertices.size();
+		std::vector<unsigned int> group;
+		const unsigned int numGroups = groupPositions(vertices, &group);
+		std::vector<int> groupSize(numGroups, 0);
+		for (unsigned int g : group)
+		{
+			groupSize[g]++;
+		}
+
+		//Errors are measured in units of the largest extent, so settings work for any mesh size
+		glm::vec3 boundsMin = glm::vec3(INFINITY), boundsMax = glm::vec3(-INFINITY);
+		for (const Vertex& vertex : vertices)
+		{
+			boundsMin = glm::min(boundsMin, vertex.pos);
+			boundsMax = glm::max(boundsMax, vertex.pos);
+		}
+		const glm::vec3 size = boundsMax - boundsMin;
+		const float extent = glm::max(glm::max(size.x, size.y), glm::max(size.z, 1e-20f));
+		std::vector<glm::vec3> positions(numVertices);
+		std::vector<float> attributes(numVertices * NUM_SIMPLIFY_ATTRIBUTES);
+		for (size_t i = 0; i < numVertices; i++)
+		{
+			positions[i] = (vertices[i].pos - boundsMin) / extent;
+			//Scaling attributes by their weight scales their squared error by weight^2
+			float* s = &attributes[i * NUM_SIMPLIFY_ATTRIBUTES];
+			s[0] = vertices[i].uv.x * settings.uvWeight;
+			s[1] = vertices[i].uv.y * settings.uvWeight;
+			s[2] = vertices[i].normal.x * settings.normalWeight;
+			s[3] = vertices[i].normal.y * settings.normalWeight;
+			s[4] = vertices[i].normal.z * settings.normalWeight;
+		}
+
+		std::vector<unsigned int> result;
+		result.reserve(indices.size());
+		for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		{
+			if (!isDegenerate(&indices[i], group)) {
+				result.insert(result.end(), &indices[i], &indices[i] + 3);
+			}
+		}
+
+		//Area weighted face quadrics. Positions per group, attributes per vertex.
+		std::vector<Quadric> positionQuadrics(numGroups);
+		std::vector<AttributeQuadric> attributeQuadrics(numVertices * NUM_SIMPLIFY_ATTRIBUTES);
+		for (size_t t = 0; t < result.size(); t += 3)
+		{
+			const unsigned int* triangle = &result[t];
+			const glm::vec3 p0 = positions[triangle[0]];
+			const glm::vec3 e1 = positions[triangle[1]] - p0;
+			const glm::vec3 e2 = positions[triangle[2]] - p0;
+			const glm::vec3 normal = glm::cross(e1, e2);
+			const float doubleArea = glm::length(normal);
+			if (doubleArea <= 0.0f)
+				continue;
+			const double area = doubleArea * 0.5;
+			const glm::vec3 n = normal / doubleArea;
+			const double planeD = -(double)glm::dot(n, p0);
+			for (int k = 0; k < 3; k++)
+			{
+				positionQuadrics[group[triangle[k]]].addPlane(n.x, n.y, n.z, planeD, area);
+			}
+			//Attribute gradient in the triangle's plane: g.e1 = s1 - s0, g.e2 = s2 - s0
+			const double a = glm::dot(e1, e1), b = glm::dot(e1, e2), c = glm::dot(e2, e2);
+			const double det = a * c - b * b;
+			if (det <= 0.0)
+				continue;
+			for (int j = 0; j < NUM_SIMPLIFY_ATTRIBUTES; j++)
+			{
+				const double s0 = attributes[triangle[0] * NUM_SIMPLIFY_ATTRIBUTES + j];
+				const double ds1 = attributes[triangle[1] * NUM_SIMPLIFY_ATTRIBUTES + j] - s0;
+				const double ds2 = attributes[triangle[2] * NUM_SIMPLIFY_ATTRIBUTES + j] - s0;
+				const double x = (c * ds1 - b * ds2) / det;
+				const double y = (a * ds2 - b * ds1) / det;
+				const double gx = x * e1.x + y * e2.x, gy = x * e1.y + y * e2.y, gz = x * e1.z + y * e2.z;
+				const double gd = s0 - (gx * p0.x + gy * p0.y + gz * p0.z);
+				for (int k = 0; k < 3; k++)
+				{
+					attributeQuadrics[triangle[k] * NUM_SIMPLIFY_ATTRIBUTES + j].addGradient(gx, gy, gz, gd, area);
+				}
+			}
+		}
+
+		//Squared distance error per unit area, or with attributes when positionOnly is false
+		auto collapseCost = [&](unsigned int from, unsigned int to, bool positionOnly) {
+			Quadric quadric = positionQuadrics[group[from]];
+			quadric.add(positionQuadrics[group[to]]);
+			const glm::vec3& p = positions[to];
+			double error = quadric.eval(p);
+			for (int j = 0; j < NUM_SIMPLIFY_ATTRIBUTES && !positionOnly; j++)
+			{
+				AttributeQuadric attributeQuadric = attributeQuadrics[from * NUM_SIMPLIFY_ATTRIBUTES + j];
+				attributeQuadric.add(attributeQuadrics[to * NUM_SIMPLIFY_ATTRIBUTES + j]);
+				error += attributeQuadric.eval(p, attributes[to * NUM_SIMPLIFY_ATTRIBUTES + j]);
+			}
+			return quadric.w > 0.0 ? glm::max(error / quadric.w, 0.0) : 0.0;
+		};
+
+		struct Collapse {
+			unsigned int from;
+			unsigned int to;
+			double cost;
+		};
+		const double maxCost = (double)settings.maxError * settings.maxError;
+		double largestCost = 0.0; //Position only, so its square root is an RMS plane distance
+		std::vector<Collapse> bestCollapses(numVertices);
+		std::vector<Collapse> collapses;
+		std::vector<unsigned int> fanOffsets(numGroups + 1);
+		std::vector<unsigned int> fans;
+		std::vector<uint8_t> locked(numGroups);
+		std::vector<uint8_t> touched(numGroups);
+		std::vector<unsigned int> neighbors;
+		std::unordered_map<uint64_t, int> edgeCounts;
+
+		//Each pass collapses an independent set of the cheapest edges: no two collapses share a fan
+		while (result.size() > targetIndexCount) {
+			const size_t numTriangles = result.size() / 3;
+
+			//Border vertices have an edge used by one triangle, or by more than two
+			edgeCounts.clear();
+			for (size_t t = 0; t < numTriangles; t++)
+			{
+				for (int k = 0; k < 3; k++)
+				{
+					const uint64_t g0 = group[result[t * 3 + k]], g1 = group[result[t * 3 + (k + 1) % 3]];
+					edgeCounts[g0 < g1 ? (g0 << 32) | g1 : (g1 << 32) | g0]++;
+				}
+			}
+			for (unsigned int g = 0; g < numGroups; g++)
+			{
+				locked[g] = groupSize[g] > 1; //Attribute seam
+			}
+			for (const auto& edge : edgeCounts)
+			{
+				if (edge.second != 2) {
+					locked[edge.first >> 32] = 1;
+					locked[edge.first & 0xffffffff] = 1;
+				}
+			}
+
+			//Triangles around each group
+			std::fill(fanOffsets.begin(), fanOffsets.end(), 0);
+			for (unsigned int index : result)
+			{
+				fanOffsets[group[index] + 1]++;
+			}
+			for (unsigned int g = 0; g < numGroups; g++)
+			{
+				fanOffsets[g + 1] += fanOffsets[g];
+			}
+			fans.resize(result.size());
+			{
+				std::vector<unsigned int> fill(fanOffsets.begin(), fanOffsets.end() - 1);
+				for (size_t i = 0; i < result.size(); i++)
+				{
+					fans[fill[group[result[i]]]++] = (unsigned int)(i / 3);
+				}
+			}
+
+			//Cheapest collapse of each free vertex along one of its edges
+			for (Collapse& collapse : bestCollapses)
+			{
+				collapse.cost = INFINITY;
+			}
+			for (size_t t = 0; t < numTriangles; t++)
+			{
+				for (int k = 0; k < 3; k++)
+				{
+					const unsigned int from = result[t * 3 + k];
+					if (locked[group[from]])
+						continue;
+					for (int o = 1; o < 3; o++)
+					{
+						const unsigned int to = result[t * 3 + (k + o) % 3];
+						const double cost = collapseCost(from, to, false);
+						if (cost < bestCollapses[from].cost) {
+							bestCollapses[from] = { from, to, cost };
+						}
+					}
+				}
+			}
+			collapses.clear();
+			for (const Collapse& collapse : bestCollapses)
+			{
+				if (collapse.cost <= maxCost) {
+					collapses.push_back(collapse);
+				}
+			}
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+			std::fill(touched.begin(), touched.end(), 0);
+			size_t remainingTriangles = numTriangles;
+			size_t numCollapsed = 0;
+			for (const Collapse& collapse : collapses)
+			{
+				if (remainingTriangles * 3 <= targetIndexCount)
+					break;
+				const unsigned int fromGroup = group[collapse.from];
+				const unsigned int toGroup = group[collapse.to];
+				if (touched[fromGroup] || touched[toGroup])
+					continue;
+				bool valid = true;
+				//Both fans must be as they were at the start of the pass
+				for (unsigned int f = fanOffsets[fromGroup]; f < fanOffsets[fromGroup + 1] && valid; f++)
+				{
+					for (int k = 0; k < 3; k++)
+					{
+						valid &= !touched[group[result[fans[f] * 3 + k]]];
+					}
+				}
+				if (!valid)
+					continue;
+
+				//Link condition: the edge's endpoints may only share the two opposite vertices, or the collapse pinches the surface
+				neighbors.clear();
+				for (unsigned int f = fanOffsets[fromGroup]; f < fanOffsets[fromGroup + 1]; f++)
+				{
+					for (int k = 0; k < 3; k++)
+					{
+						neighbors.push_back(group[result[fans[f] * 3 + k]]);
+					}
+				}
+				std::sort(neighbors.begin(), neighbors.end());
+				neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+				int shared = 0;
+				for (unsigned int f = fanOffsets[toGroup]; f < fanOffsets[toGroup + 1]; f++)
+				{
+					for (int k = 0; k < 3; k++)
+					{
+						const unsigned int g = group[result[fans[f] * 3 + k]];
+						if (g != fromGroup && g != toGroup && std::binary_search(neighbors.begin(), neighbors.end(), g)) {
+							shared++;
+						}
+					}
+				}
+				//Each shared neighbor is counted once per triangle of toGroup it is in, which is twice on a closed fan
+				if (shared > 4)
+					continue;
+
+				//Reject collapses that flip or fold a remaining triangle
+				for (unsigned int f = fanOffsets[fromGroup]; f < fanOffsets[fromGroup + 1] && valid; f++)
+				{
+					const unsigned int* triangle = &result[fans[f] * 3];
+					if (group[triangle[0]] == toGroup || group[triangle[1]] == toGroup || group[triangle[2]] == toGroup)
+						continue;
+					glm::vec3 p[3], q[3];
+					for (int k = 0; k < 3; k++)
+					{
+						p[k] = positions[triangle[k]];
+						q[k] = group[triangle[k]] == fromGroup ? positions[collapse.to] : p[k];
+					}
+					const glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+					const glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+					//Also rejects turns of more than ~75 degrees, which leave slivers standing on edge
+					valid = glm::dot(before, after) > 0.25f * glm::length(before) * glm::length(after);
+				}
+				if (!valid)
+					continue;
+
+				largestCost = glm::max(largestCost, collapseCost(collapse.from, collapse.to, true));
+				for (unsigned int f = fanOffsets[fromGroup]; f < fanOffsets[fromGroup + 1]; f++)
+				{
+					unsigned int* triangle = &result[fans[f] * 3];
+					for (int k = 0; k < 3; k++)
+					{
+						touched[group[triangle[k]]] = 1;
+						if (triangle[k] == collapse.from) {
+							triangle[k] = collapse.to;
+						}
+					}
+					if (isDegenerate(triangle, group)) {
+						remainingTriangles--;
+					}
+				}
+				positionQuadrics[toGroup].add(positionQuadrics[fromGroup]);
+				for (int j = 0; j < NUM_SIMPLIFY_ATTRIBUTES; j++)
+				{
+					attributeQuadrics[collapse.to * NUM_SIMPLIFY_ATTRIBUTES + j].add(attributeQuadrics[collapse.from * NUM_SIMPLIFY_ATTRIBUTES + j]);
+				}
+				numCollapsed++;
+			}
+			if (numCollapsed == 0)
+				break;
+
+			size_t write = 0;
+			for (size_t t = 0; t < numTriangles; t++)
+			{
+				if (!isDegenerate(&result[t * 3], group)) {
+					memmove(&result[write], &result[t * 3], sizeof(unsigned int) * 3);
+					write += 3;
+				}
+			}
+			result.resize(write);
+		}
+		if (resultError) {
+			//Back from units of the largest extent to mesh units
+			*resultError = (float)sqrt(largestCost) * extent;
+		}
+		return result;
+	}
+
+	void generateMeshLODs(ew::MeshData* meshData, int numLODs, float reduction, const ew::SimplifySettings& settings) {
+		meshData->lods.clear();
+		size_t previousTriangles = meshData->indices.size() / 3;
+		for (int i = 0; i < numLODs; i++)
+		{
+			const size_t targetIndexCount = (size_t)(previousTriangles * reduction) * 3;
+			MeshLODData lod;
+			lod.indices = simplifyMesh(meshData->vertices, meshData->indices, targetIndexCount, settings, &lod.error);
+			const size_t numTriangles = lod.indices.size() / 3;
+			if (numTriangles == 0 || numTriangles > previousTriangles * 0.9f)
+				break;
+			optimizeVertexCache(&lod.indices, meshData->vertices.size());
+			meshData->lods.push_back(std::move(lod));
+			previousTriangles = numTriangles;
+		}
+	}
+}
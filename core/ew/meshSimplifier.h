@@ -0,0 +1,31 @@
+#pragma once
+#include "mesh.h"
+
+namespace ew {
+	struct SimplifySettings {
+		//Attribute error weights, relative to position error in units of the mesh's largest extent
+		float normalWeight = 0.1f;
+		float uvWeight = 0.25f;
+		//Collapses costing more than this fraction of the mesh's largest extent are not made
+		float maxError = 0.1f;
+	};
+
+	/// <summary>
+	/// Quadric error metric simplification by half-edge collapses, so the result indexes a subset of vertices.
+	/// Position error uses Garland-Heckbert plane quadrics. UVs and normals use Hoppe's attribute quadrics, which
+	/// measure how far the kept vertex's attributes are from the linear attribute field of the removed faces.
+	/// Border and attribute seam vertices are never removed, so silhouettes of open meshes and UV seams hold.
+	/// Stops at targetIndexCount or when every remaining collapse exceeds settings.maxError.
+	/// resultError, if not null, gets the position error of the worst collapse, in mesh units. This is an estimate:
+	/// the area weighted RMS distance of the kept vertex from the planes of the faces merged into it, not a bound
+	/// on how far any point of the result is from the full mesh.
+	/// </summary>
+	std::vector<unsigned int> simplifyMesh(const std::vector<ew::Vertex>& vertices, const std::vector<unsigned int>& indices, size_t targetIndexCount, const ew::SimplifySettings& settings = ew::SimplifySettings(), float* resultError = nullptr);
+
+	/// <summary>
+	/// Fills meshData->lods with up to numLODs coarser index lists, each aiming for reduction times the triangles of the one before.
+	/// Each level is simplified from the full mesh and cache optimized. The chain ends early once a level
+	/// removes less than 10% of the previous one's triangles.
+	/// </summary>
+	void generateMeshLODs(ew::MeshData* meshData, int numLODs = 3, float reduction = 0.5f, const ew::SimplifySettings& settings = ew::SimplifySettings());
+}
@@ -3,26 +3,64 @@
 */
 
 #include "model.h"
+#include "vertexPacking.h"
+#include "meshOptimizer.h"
+#include "meshSimplifier.h"
 #include <assimp/Importer.hpp>
 #include <assimp/postprocess.h>
 
 #include <assimp/scene.h>
 #include <glm/glm.hpp>
+#include <stdio.h>
 
 namespace ew {
-	ew::Mesh processAiMesh(aiMesh* aiMesh);
+	ew::MeshData processAiMesh(aiMesh* aiMesh, std::map<std::string, ew::BoneInfo>* boneInfoMap, std::vector<ew::BoundingSphere>* boneBounds, ew::BoundingSphere* unskinnedBounds, ew::MorphTargetSet* morphTargets);
+	glm::mat4 convertAIMat4(const aiMatrix4x4& m);
 
 	Model::Model() {
 
 	}
-	Model::Model(const std::string& filePath)
+	Model::Model(const std::string& filePath, ew::VertexFormat vertexFormat)
 	{
 		Assimp::Importer importer;
-		const aiScene* aiScene = importer.ReadFile(filePath, aiProcess_Triangulate | aiProcess_CalcTangentSpace);
+		const aiScene* aiScene = importer.ReadFile(filePath, aiProcess_Triangulate | aiProcess_CalcTangentSpace | aiProcess_LimitBoneWeights);
+		if (aiScene == NULL) {
+			printf("Failed to load model %s\n", filePath.c_str());
+			return;
+		}
+		std::vector<ew::MeshData> meshDatas(aiScene->mNumMeshes);
+		m_morphTargets.resize(aiScene->mNumMeshes);
+		ew::AABB bounds;
 		for (size_t i = 0; i < aiScene->mNumMeshes; i++)
 		{
 			aiMesh* aiMesh = aiScene->mMeshes[i];
-			m_meshes.push_back(processAiMesh(aiMesh));
+			meshDatas[i] = processAiMesh(aiMesh, &m_boneInfoMap, &m_boneBounds, &m_unskinnedBounds, &m_morphTargets[i]);
+			//Welding could merge vertices that only differ in their blend shapes
+			ew::MeshOptimizationSettings optimizationSettings;
+			optimizationSettings.weld = m_morphTargets[i].isEmpty();
+			std::vector<unsigned int> remap;
+			m_optimizationReport.add(ew::optimizeMesh(&meshDatas[i], optimizationSettings, &remap));
+			if (!m_morphTargets[i].isEmpty()) {
+				ew::remapMorphTargets(&m_morphTargets[i], remap, meshDatas[i].vertices);
+			}
+			//Simplification error is measured on the base shape in bind pose, which blend shapes and skinning move away from
+			else if (!aiMesh->HasBones()) {
+				ew::generateMeshLODs(&meshDatas[i]);
+			}
+			for (const ew::Vertex& vertex : meshDatas[i].vertices)
+			{
+				bounds.min = glm::min(bounds.min, vertex.pos);
+				bounds.max = glm::max(bounds.max, vertex.pos);
+				growSphere(&m_bounds, vertex.pos);
+			}
+		}
+		//One quantization for every mesh, so a single pair of shader uniforms covers the model
+		if (vertexFormat == ew::VertexFormat::PACKED_QUANTIZED) {
+			m_positionQuantization = ew::makePositionQuantization(bounds);
+		}
+		for (const ew::MeshData& meshData : meshDatas)
+		{
+			m_meshes.push_back(ew::Mesh(meshData, vertexFormat, &m_positionQuantization));
 		}
 	}
 
@@ -34,16 +72,177 @@ namespace ew {
 		}
 	}
 
+	void Model::draw(const glm::mat4& modelMatrix, const ew::Camera& camera)
+	{
+		//Screen height fraction covered by one model space unit at the bounds' distance
+		const ew::BoundingSphere worldBounds = transformSphere(m_bounds, modelMatrix);
+		const float scale = m_bounds.radius > 0.0f ? worldBounds.radius / m_bounds.radius : 1.0f;
+		float unitsToScreen = INFINITY;
+		if (camera.orthographic) {
+			unitsToScreen = scale / camera.orthoHeight;
+		}
+		else {
+			//Nearest point of the bounds, so every part of the model is drawn at least this precisely
+			const float distance = glm::length(worldBounds.center - camera.position) - worldBounds.radius;
+			if (distance > 0.0f) {
+				unitsToScreen = scale / (2.0f * distance * tanf(glm::radians(camera.fov) * 0.5f));
+			}
+		}
+		for (size_t i = 0; i < m_meshes.size(); i++)
+		{
+			const ew::Mesh& mesh = m_meshes[i];
+			int lod = 0;
+			while (lod + 1 < mesh.getNumLODs() && mesh.getLODError(lod + 1) * unitsToScreen <= m_lodThreshold) {
+				lod++;
+			}
+			mesh.drawLOD(lod);
+			m_lodStats.drawnTriangles += mesh.getLODNumIndices(lod) / 3;
+			m_lodStats.fullTriangles += mesh.getNumIndices() / 3;
+		}
+	}
+
+	void Model::drawInstanced(int instanceCount)
+	{
+		for (size_t i = 0; i < m_meshes.size(); i++)
+		{
+			m_meshes[i].drawInstanced(ew::DrawMode::TRIANGLES, instanceCount);
+		}
+	}
+
+	void Model::setInstanceAttributes(const glm::vec4* data, int numInstances, int vec4sPerInstance)
+	{
+		for (size_t i = 0; i < m_meshes.size(); i++)
+		{
+			m_meshes[i].setInstanceAttributes(data, numInstances, vec4sPerInstance);
+		}
+	}
+
 	glm::vec3 convertAIVec3(const aiVector3D& v) {
 		return glm::vec3(v.x, v.y, v.z);
 	}
+	//Assimp matrices are row-major, glm is column-major
+	glm::mat4 convertAIMat4(const aiMatrix4x4& m) {
+		return glm::transpose(glm::mat4(
+			m.a1, m.a2, m.a3, m.a4,
+			m.b1, m.b2, m.b3, m.b4,
+			m.c1, m.c2, m.c3, m.c4,
+			m.d1, m.d2, m.d3, m.d4));
+	}
+
+	//Adds a weight to the first free slot of vertex.
+	//When all slots are taken, the smallest weight is replaced if this one is larger.
+	static void addBoneWeight(ew::Vertex* vertex, unsigned short boneID, float weight) {
+		int slot = 0;
+		for (int i = 1; i < MAX_BONE_WEIGHTS; i++)
+		{
+			if (vertex->boneWeights[i] < vertex->boneWeights[slot]) {
+				slot = i;
+			}
+		}
+		if (weight > vertex->boneWeights[slot]) {
+			vertex->boneIDs[slot] = boneID;
+			vertex->boneWeights[slot] = weight;
+		}
+	}
+
+	//Fills bone IDs and weights of vertices, adding new bones to boneInfoMap
+	static void processAiBones(aiMesh* aiMesh, std::map<std::string, ew::BoneInfo>* boneInfoMap, std::vector<ew::Vertex>* vertices) {
+		for (size_t i = 0; i < aiMesh->mNumBones; i++)
+		{
+			const aiBone* aiBone = aiMesh->mBones[i];
+			std::string boneName = aiBone->mName.C_Str();
+			auto it = boneInfoMap->find(boneName);
+			if (it == boneInfoMap->end()) {
+				ew::BoneInfo boneInfo;
+				boneInfo.id = (int)boneInfoMap->size();
+				boneInfo.invBindPose = convertAIMat4(aiBone->mOffsetMatrix);
+				it = boneInfoMap->emplace(boneName, boneInfo).first;
+			}
+			for (size_t j = 0; j < aiBone->mNumWeights; j++)
+			{
+				const aiVertexWeight& aiWeight = aiBone->mWeights[j];
+				addBoneWeight(&(*vertices)[aiWeight.mVertexId], (unsigned short)it->second.id, aiWeight.mWeight);
+			}
+		}
+		//Weights must sum to 1. Vertices with no weights are left unskinned.
+		for (ew::Vertex& vertex : *vertices)
+		{
+			float totalWeight = 0;
+			for (int i = 0; i < MAX_BONE_WEIGHTS; i++)
+			{
+				totalWeight += vertex.boneWeights[i];
+			}
+			if (totalWeight > 0) {
+				for (int i = 0; i < MAX_BONE_WEIGHTS; i++)
+				{
+					vertex.boneWeights[i] /= totalWeight;
+				}
+			}
+		}
+	}
+
+	//Grows the bone space sphere of every bone a vertex has weight on, or the unskinned sphere if it has none
+	static void growBoneBounds(const std::vector<ew::Vertex>& vertices, const std::map<std::string, ew::BoneInfo>& boneInfoMap, std::vector<ew::BoundingSphere>* boneBounds, ew::BoundingSphere* unskinnedBounds) {
+		std::vector<glm::mat4> invBindPoses(boneInfoMap.size());
+		for (const auto& it : boneInfoMap)
+		{
+			invBindPoses[it.second.id] = it.second.invBindPose;
+		}
+		boneBounds->resize(boneInfoMap.size());
+		for (const ew::Vertex& vertex : vertices)
+		{
+			bool skinned = false;
+			for (int i = 0; i < MAX_BONE_WEIGHTS; i++)
+			{
+				if (vertex.boneWeights[i] <= 0)
+					continue;
+				const int boneID = vertex.boneIDs[i];
+				growSphere(&(*boneBounds)[boneID], glm::vec3(invBindPoses[boneID] * glm::vec4(vertex.pos, 1.0f)));
+				skinned = true;
+			}
+			if (!skinned) {
+				growSphere(unskinnedBounds, vertex.pos);
+			}
+		}
+	}
 
 	//Utility functions local to this file
-	ew::Mesh processAiMesh(aiMesh* aiMesh) {
+	//Converts blend shapes to sparse morph targets. Assimp stores them as full morphed meshes.
+	static void processAiAnimMeshes(aiMesh* aiMesh, const std::vector<ew::Vertex>& vertices, ew::MorphTargetSet* morphTargets) {
+		morphTargets->baseVertices = vertices;
+		std::vector<glm::vec3> positions(vertices.size());
+		std::vector<glm::vec3> normals(vertices.size());
+		for (size_t i = 0; i < aiMesh->mNumAnimMeshes; i++)
+		{
+			const aiAnimMesh* aiAnimMesh = aiMesh->mAnimMeshes[i];
+			std::string name = aiAnimMesh->mName.C_Str();
+			if (name.empty()) {
+				name = "Target" + std::to_string(i);
+			}
+			if (!aiAnimMesh->HasPositions() || aiAnimMesh->mNumVertices != vertices.size()) {
+				printf("Skipping morph target %s of mesh %s: vertex count does not match\n", name.c_str(), aiMesh->mName.C_Str());
+				continue;
+			}
+			for (size_t j = 0; j < vertices.size(); j++)
+			{
+				positions[j] = convertAIVec3(aiAnimMesh->mVertices[j]);
+				if (aiAnimMesh->HasNormals()) {
+					normals[j] = convertAIVec3(aiAnimMesh->mNormals[j]);
+				}
+			}
+			morphTargets->targets.push_back(makeMorphTarget(name, vertices, positions.data(), aiAnimMesh->HasNormals() ? normals.data() : nullptr));
+		}
+		if (morphTargets->targets.empty()) {
+			morphTargets->baseVertices.clear();
+		}
+	}
+
+	ew::MeshData processAiMesh(aiMesh* aiMesh, std::map<std::string, ew::BoneInfo>* boneInfoMap, std::vector<ew::BoundingSphere>* boneBounds, ew::BoundingSphere* unskinnedBounds, ew::MorphTargetSet* morphTargets) {
 		ew::MeshData meshData;
+		meshData.vertices.reserve(aiMesh->mNumVertices);
 		for (size_t i = 0; i < aiMesh->mNumVertices; i++)
 		{
-			ew::Vertex vertex;
+			ew::Vertex vertex = {};
 			vertex.pos = convertAIVec3(aiMesh->mVertices[i]);
 			if (aiMesh->HasNormals()) {
 				vertex.normal = convertAIVec3(aiMesh->mNormals[i]);
@@ -56,6 +255,13 @@ namespace ew {
 			}
 			meshData.vertices.push_back(vertex);
 		}
+		if (aiMesh->HasBones()) {
+			processAiBones(aiMesh, boneInfoMap, &meshData.vertices);
+		}
+		growBoneBounds(meshData.vertices, *boneInfoMap, boneBounds, unskinnedBounds);
+		if (aiMesh->mNumAnimMeshes > 0) {
+			processAiAnimMeshes(aiMesh, meshData.vertices, morphTargets);
+		}
 		//Convert faces to indices
 		for (size_t i = 0; i < aiMesh->mNumFaces; i++)
 		{
@@ -64,7 +270,7 @@ namespace ew {
 				meshData.indices.push_back(aiMesh->mFaces[i].mIndices[j]);
 			}
 		}
-		return ew::Mesh(meshData);
+		return meshData;
 	}
 
 }
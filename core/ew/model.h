@@ -5,20 +5,76 @@
 #pragma once
 #include "mesh.h"
 #include "shader.h"
+#include "bounds.h"
+#include "morphTargets.h"
+#include "meshOptimizer.h"
+#include "camera.h"
 #include <vector>
 #include <map>
 
 namespace ew {
 	struct BoneInfo {
-		glm::mat4 invBindPose;
+		int id; //Index into the skinning palette, as stored in Vertex::boneIDs
+		glm::mat4 invBindPose; //Mesh space -> bone space in bind pose
+	};
+	enum class SkinningMode {
+		LINEAR_BLEND = 0, //mat4 palette. Supports scale.
+		DUAL_QUATERNION = 1 //Dual quaternion palette, half the size. Preserves volume at twisting joints, ignores scale.
+	};
+	//Triangles drawn by Model::draw with a camera, against what full detail would have drawn
+	struct LODStats {
+		size_t drawnTriangles = 0;
+		size_t fullTriangles = 0;
 	};
 	class Model {
 	public:
 		Model();
-		Model(const std::string& filePath);
+		Model(const std::string& filePath, ew::VertexFormat vertexFormat = ew::VertexFormat::FULL);
 		void draw();
+		/// <summary>
+		/// Draws each mesh at the coarsest level of detail whose error, projected by camera, covers at most
+		/// the LOD threshold as a fraction of screen height. modelMatrix should be the one set as _Model.
+		/// Adds to the LOD stats.
+		/// </summary>
+		void draw(const glm::mat4& modelMatrix, const ew::Camera& camera);
+		void drawInstanced(int instanceCount);
+		//Sets the same per instance attributes on every mesh. See Mesh::setInstanceAttributes.
+		void setInstanceAttributes(const glm::vec4* data, int numInstances, int vec4sPerInstance);
+		//Bones referenced by any mesh, by name. Empty if the model is not skinned.
+		inline const std::map<std::string, ew::BoneInfo>& getBoneInfoMap() const { return m_boneInfoMap; }
+		inline int getNumBones() const { return (int)m_boneInfoMap.size(); }
+		//Per palette entry, in bone space. Contains every vertex the bone has weight on. Empty for bones with no vertices.
+		inline const std::vector<ew::BoundingSphere>& getBoneBounds() const { return m_boneBounds; }
+		//Model space bounds of vertices with no bone weights
+		inline const ew::BoundingSphere& getUnskinnedBounds() const { return m_unskinnedBounds; }
+		//Dequantization of PACKED_QUANTIZED positions, shared by all meshes. Identity for other formats.
+		inline const ew::PositionQuantization& getPositionQuantization() const { return m_positionQuantization; }
+		//Meshes are optimized on import. Totals over every mesh.
+		inline const ew::MeshOptimizationReport& getOptimizationReport() const { return m_optimizationReport; }
+		inline int getNumMeshes() const { return (int)m_meshes.size(); }
+		inline ew::Mesh& getMesh(int index) { return m_meshes[index]; }
+		//Blend shapes of each mesh, by mesh index. Empty for meshes without any.
+		inline const ew::MorphTargetSet& getMorphTargets(int meshIndex) const { return m_morphTargets[meshIndex]; }
+		//Fraction of screen height a level's error may cover. 0 only allows levels with no error.
+		inline float getLODThreshold() const { return m_lodThreshold; }
+		inline void setLODThreshold(float threshold) { m_lodThreshold = threshold; }
+		inline const ew::LODStats& getLODStats() const { return m_lodStats; }
+		inline void resetLODStats() { m_lodStats = ew::LODStats(); }
+		//Model space, around every vertex
+		inline const ew::BoundingSphere& getBounds() const { return m_bounds; }
+		inline ew::SkinningMode getSkinningMode() const { return m_skinningMode; }
+		inline void setSkinningMode(ew::SkinningMode skinningMode) { m_skinningMode = skinningMode; }
 	private:
 		std::vector<ew::Mesh> m_meshes;
+		std::vector<ew::MorphTargetSet> m_morphTargets;
 		std::map<std::string, ew::BoneInfo> m_boneInfoMap;
+		std::vector<ew::BoundingSphere> m_boneBounds;
+		ew::BoundingSphere m_unskinnedBounds;
+		ew::SkinningMode m_skinningMode = ew::SkinningMode::LINEAR_BLEND;
+		ew::PositionQuantization m_positionQuantization;
+		ew::MeshOptimizationReport m_optimizationReport;
+		ew::BoundingSphere m_bounds;
+		float m_lodThreshold = 0.002f; //About 2 pixels at 1080p
+		ew::LODStats m_lodStats;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,168 @@
+#include "morphTargets.h"
+#include <algorithm>
+
+namespace ew {
+	MorphTarget makeMorphTarget(const std::string& name, const std::vector<ew::Vertex>& baseVertices, const glm::vec3* targetPositions, const glm::vec3* targetNormals) {
+		MorphTarget target;
+		target.name = name;
+		bool hasNormalDeltas = false;
+		const float epsilonSquared = MORPH_DELTA_EPSILON * MORPH_DELTA_EPSILON;
+		for (size_t i = 0; i < baseVertices.size(); i++)
+		{
+			const glm::vec3 positionDelta = targetPositions[i] - baseVertices[i].pos;
+			const glm::vec3 normalDelta = targetNormals ? targetNormals[i] - baseVertices[i].normal : glm::vec3(0);
+			const bool movesNormal = glm::dot(normalDelta, normalDelta) > epsilonSquared;
+			if (glm::dot(positionDelta, positionDelta) <= epsilonSquared && !movesNormal)
+				continue;
+			target.indices.push_back((uint32_t)i);
+			target.positionDeltas.push_back(positionDelta);
+			target.normalDeltas.push_back(normalDelta);
+			hasNormalDeltas |= movesNormal;
+		}
+		if (!hasNormalDeltas) {
+			target.normalDeltas.clear();
+		}
+		return target;
+	}
+
+	void remapMorphTargets(ew::MorphTargetSet* targetSet, const std::vector<unsigned int>& remap, const std::vector<ew::Vertex>& newVertices) {
+		targetSet->baseVertices = newVertices;
+		std::vector<size_t> order;
+		for (MorphTarget& target : targetSet->targets)
+		{
+			order.clear();
+			for (size_t i = 0; i < target.indices.size(); i++)
+			{
+				if (remap[target.indices[i]] != ~0u) {
+					order.push_back(i);
+				}
+			}
+			std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return remap[target.indices[a]] < remap[target.indices[b]]; });
+			MorphTarget remapped;
+			remapped.name = target.name;
+			for (size_t i : order)
+			{
+				remapped.indices.push_back(remap[target.indices[i]]);
+				remapped.positionDeltas.push_back(target.positionDeltas[i]);
+				if (!target.normalDeltas.empty()) {
+					remapped.normalDeltas.push_back(target.normalDeltas[i]);
+				}
+			}
+			target = std::move(remapped);
+		}
+	}
+
+	void initMorphState(const ew::MorphTargetSet& targetSet, ew::MorphState* state) {
+		state->vertices = targetSet.baseVertices;
+		state->touched.assign(targetSet.baseVertices.size(), 0);
+		state->touchedPerPartition.clear();
+		state->dirtyBegin = 0;
+		state->dirtyEnd = 0; //Matches the vertices the mesh was loaded with
+		state->activeDeltas = 0;
+	}
+
+	//Applies the active targets' deltas to vertices [begin, end). Only this partition writes those vertices.
+	static void accumulatePartition(const ew::MorphTargetSet& targetSet, const std::vector<int>& activeTargets, const float* weights, uint32_t begin, uint32_t end, ew::MorphState* state, std::vector<uint32_t>* touchedList) {
+		for (int t : activeTargets)
+		{
+			const ew::MorphTarget& target = targetSet.targets[t];
+			const float weight = weights[t];
+			const bool hasNormals = !target.normalDeltas.empty();
+			size_t i = std::lower_bound(target.indices.begin(), target.indices.end(), begin) - target.indices.begin();
+			for (; i < target.indices.size() && target.indices[i] < end; i++)
+			{
+				const uint32_t v = target.indices[i];
+				if (!state->touched[v]) {
+					state->touched[v] = 1;
+					touchedList->push_back(v);
+				}
+				ew::Vertex& vertex = state->vertices[v];
+				vertex.pos += target.positionDeltas[i] * weight;
+				if (hasNormals) {
+					vertex.normal += target.normalDeltas[i] * weight;
+				}
+			}
+		}
+		for (uint32_t v : *touchedList)
+		{
+			glm::vec3& normal = state->vertices[v].normal;
+			const float length = glm::length(normal);
+			if (length > 0.0f) {
+				normal /= length;
+			}
+		}
+	}
+
+	void evaluateMorphTargets(const ew::MorphTargetSet& targetSet, const float* weights, ew::MorphState* state, ew::WorkerPool* pool) {
+		const size_t numVertices = targetSet.baseVertices.size();
+		if (state->vertices.size() != numVertices) {
+			initMorphState(targetSet, state);
+		}
+		size_t dirtyBegin = numVertices;
+		size_t dirtyEnd = 0;
+
+		//Restore vertices the last evaluation changed
+		for (std::vector<uint32_t>& touchedList : state->touchedPerPartition)
+		{
+			for (uint32_t v : touchedList)
+			{
+				state->vertices[v].pos = targetSet.baseVertices[v].pos;
+				state->vertices[v].normal = targetSet.baseVertices[v].normal;
+				state->touched[v] = 0;
+				dirtyBegin = glm::min(dirtyBegin, (size_t)v);
+				dirtyEnd = glm::max(dirtyEnd, (size_t)v + 1);
+			}
+			touchedList.clear();
+		}
+
+		std::vector<int> activeTargets;
+		size_t activeDeltas = 0;
+		int largestTarget = -1;
+		for (size_t t = 0; t < targetSet.targets.size(); t++)
+		{
+			const size_t numDeltas = targetSet.targets[t].indices.size();
+			if (weights[t] == 0.0f || numDeltas == 0)
+				continue;
+			activeTargets.push_back((int)t);
+			activeDeltas += numDeltas;
+			if (largestTarget < 0 || numDeltas > targetSet.targets[largestTarget].indices.size()) {
+				largestTarget = (int)t;
+			}
+		}
+		state->activeDeltas = activeDeltas;
+
+		if (!activeTargets.empty()) {
+			if (pool == nullptr) {
+				pool = &ew::getDefaultWorkerPool();
+			}
+			const size_t maxThreads = glm::max(activeDeltas / MIN_MORPH_DELTAS_PER_THREAD, (size_t)1);
+			const size_t numPartitions = glm::min((size_t)pool->getNumThreads(), maxThreads);
+			//Deltas of a face rig cluster in a few regions. Splitting where the largest target's deltas are
+			//evenly divided balances far better than equal vertex ranges.
+			const std::vector<uint32_t>& splitIndices = targetSet.targets[largestTarget].indices;
+			std::vector<uint32_t> bounds(numPartitions + 1);
+			bounds[0] = 0;
+			bounds[numPartitions] = (uint32_t)numVertices;
+			for (size_t p = 1; p < numPartitions; p++)
+			{
+				bounds[p] = splitIndices[splitIndices.size() * p / numPartitions];
+			}
+			state->touchedPerPartition.resize(numPartitions);
+
+			pool->run((int)numPartitions, [&](int p) {
+				accumulatePartition(targetSet, activeTargets, weights, bounds[p], bounds[p + 1], state, &state->touchedPerPartition[p]);
+			});
+			for (const std::vector<uint32_t>& touchedList : state->touchedPerPartition)
+			{
+				//Lists are in first touched order, which is not sorted with several targets
+				for (uint32_t v : touchedList)
+				{
+					dirtyBegin = glm::min(dirtyBegin, (size_t)v);
+					dirtyEnd = glm::max(dirtyEnd, (size_t)v + 1);
+				}
+			}
+		}
+		state->dirtyBegin = dirtyEnd > dirtyBegin ? dirtyBegin : 0;
+		state->dirtyEnd = dirtyEnd > dirtyBegin ? dirtyEnd : 0;
+	}
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include "mesh.h"
+#include "workerPool.h"
+#include <string>
+#include <stdint.h>
+
+namespace ew {
+	//Deltas smaller than this are dropped on import
+	const float MORPH_DELTA_EPSILON = 1e-6f;
+	//Evaluations with fewer active deltas than this are not split across threads
+	const size_t MIN_MORPH_DELTAS_PER_THREAD = 4096;
+
+	//Sparse blend shape. Only vertices the target moves are stored.
+	struct MorphTarget {
+		std::string name;
+		std::vector<uint32_t> indices; //Ascending
+		std::vector<glm::vec3> positionDeltas;
+		std::vector<glm::vec3> normalDeltas; //Empty if the target does not change normals
+	};
+
+	//Morph targets of one mesh, along with the unmorphed vertices they apply to
+	struct MorphTargetSet {
+		std::vector<ew::Vertex> baseVertices;
+		std::vector<ew::MorphTarget> targets;
+		inline bool isEmpty() const { return targets.empty(); }
+	};
+
+	//Builds a sparse target from full morphed positions and normals of a mesh. targetNormals may be null.
+	MorphTarget makeMorphTarget(const std::string& name, const std::vector<ew::Vertex>& baseVertices, const glm::vec3* targetPositions, const glm::vec3* targetNormals);
+
+	//Follows a vertex reorder, such as optimizeMesh. remap holds the new index of each old vertex, or ~0u if it was removed.
+	void remapMorphTargets(ew::MorphTargetSet* targetSet, const std::vector<unsigned int>& remap, const std::vector<ew::Vertex>& newVertices);
+
+	/// <summary>
+	/// Morphed copy of a mesh's vertices, kept between evaluations so only changed vertices are rewritten.
+	/// After each evaluation, [dirtyBegin, dirtyEnd) covers every vertex that differs from the last one,
+	/// to be uploaded with Mesh::updateVertices.
+	/// </summary>
+	struct MorphState {
+		std::vector<ew::Vertex> vertices;
+		std::vector<uint8_t> touched; //Per vertex, set if a delta was applied last evaluation
+		std::vector<std::vector<uint32_t>> touchedPerPartition;
+		size_t dirtyBegin = 0;
+		size_t dirtyEnd = 0;
+		size_t activeDeltas = 0; //Deltas applied by the last evaluation
+	};
+	void initMorphState(const ew::MorphTargetSet& targetSet, ew::MorphState* state);
+
+	/// <summary>
+	/// Applies targets with non zero weight on top of the base vertices, one weight per target.
+	/// Vertices touched by the previous evaluation are restored first, so cost scales with
+	/// the number of active deltas rather than the vertex count.
+	/// Threads own disjoint vertex ranges, split where the largest active target's indices are evenly divided.
+	/// Runs on pool's threads, or getDefaultWorkerPool() if null.
+	/// </summary>
+	void evaluateMorphTargets(const ew::MorphTargetSet& targetSet, const float* weights, ew::MorphState* state, ew::WorkerPool* pool = nullptr);
+}
@@ -0,0 +1,233 @@
+#include "poseBuffer.h"
+#include "simd.h"
+#include <algorithm>
+
+namespace ew {
+	void resizePoseBuffer(ew::PoseBuffer* pose, size_t numBones) {
+		const size_t size = simdPaddedSize(numBones);
+		pose->numBones = numBones;
+		std::vector<float>* zeroArrays[6] = { &pose->px, &pose->py, &pose->pz, &pose->rx, &pose->ry, &pose->rz };
+		for (std::vector<float>* array : zeroArrays)
+		{
+			array->assign(size, 0.0f);
+		}
+		std::vector<float>* oneArrays[4] = { &pose->rw, &pose->sx, &pose->sy, &pose->sz };
+		for (std::vector<float>* array : oneArrays)
+		{
+			array->assign(size, 1.0f);
+		}
+	}
+
+	static inline void setPoseBone(ew::PoseBuffer* pose, size_t i, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale) {
+		pose->px[i] = position.x; pose->py[i] = position.y; pose->pz[i] = position.z;
+		pose->rx[i] = rotation.x; pose->ry[i] = rotation.y; pose->rz[i] = rotation.z; pose->rw[i] = rotation.w;
+		pose->sx[i] = scale.x; pose->sy[i] = scale.y; pose->sz[i] = scale.z;
+	}
+
+	void loadPoseFromSkeleton(const ew::Skeleton& skeleton, ew::PoseBuffer* pose) {
+		const size_t numBones = skeleton.bones.size();
+		resizePoseBuffer(pose, numBones);
+		for (size_t i = 0; i < numBones; i++)
+		{
+			const glm::mat4& m = skeleton.bones[i].localTransform;
+			glm::vec3 scale = glm::vec3(glm::length(glm::vec3(m[0])), glm::length(glm::vec3(m[1])), glm::length(glm::vec3(m[2])));
+			glm::mat3 rotation = glm::mat3(glm::vec3(m[0]) / scale.x, glm::vec3(m[1]) / scale.y, glm::vec3(m[2]) / scale.z);
+			setPoseBone(pose, i, glm::vec3(m[3]), glm::normalize(glm::quat_cast(rotation)), scale);
+		}
+	}
+
+	void applyPose(const ew::PoseBuffer& pose, ew::Skeleton* skeleton) {
+		const size_t numBones = glm::min(pose.numBones, skeleton->bones.size());
+		for (size_t i = 0; i < numBones; i++)
+		{
+			glm::vec3 position = glm::vec3(pose.px[i], pose.py[i], pose.pz[i]);
+			glm::quat rotation = glm::quat(pose.rw[i], pose.rx[i], pose.ry[i], pose.rz[i]);
+			glm::vec3 scale = glm::vec3(pose.sx[i], pose.sy[i], pose.sz[i]);
+			glm::mat4 m = glm::translate(glm::mat4(1), position) * glm::toMat4(rotation);
+			ew::setLocalTransform(skeleton, (int)i, glm::scale(m, scale));
+		}
+	}
+
+	void samplePose(const ew::AnimationClip* animClip, const ew::AnimationBinding& binding, float normalizedTime, ew::PoseBuffer* pose, ew::AnimationCursor* cursor) {
+		const float time = animClip->duration * glm::clamp(normalizedTime, 0.0f, 1.0f);
+		if (cursor != nullptr && cursor->channels.size() != animClip->bones.size()) {
+			cursor->channels.assign(animClip->bones.size(), ChannelCursor());
+		}
+		for (size_t i = 0; i < animClip->bones.size(); i++)
+		{
+			glm::vec3 position, scale;
+			glm::quat rotation;
+			if (animClip->useBakedTrack) {
+				sampleBakedPoseTrack(animClip->bakedTrack, i, time, &position, &rotation, &scale);
+			}
+			else {
+				sampleBoneAnimation(animClip->bones[i], time, cursor ? &cursor->channels[i] : nullptr, &position, &rotation, &scale);
+			}
+			setPoseBone(pose, binding.boneIndices[i], position, rotation, scale);
+		}
+	}
+
+	BoneMask makeBoneMask(const ew::Skeleton& skeleton, int rootBone, float weight) {
+		const size_t numBones = skeleton.bones.size();
+		BoneMask mask(simdPaddedSize(numBones), 0.0f);
+		//Parents come before children, so a bone is in the subtree if its parent is
+		std::vector<bool> inSubtree(numBones);
+		for (size_t i = 0; i < numBones; i++)
+		{
+			int parent = skeleton.bones[i].parentIndex;
+			inSubtree[i] = (int)i == rootBone || (parent != -1 && inSubtree[parent]);
+			mask[i] = inSubtree[i] ? weight : 0.0f;
+		}
+		return mask;
+	}
+
+	//Pointers to the SoA arrays of a pose
+	struct PoseLanes {
+		float* px; float* py; float* pz;
+		float* rx; float* ry; float* rz; float* rw;
+		float* sx; float* sy; float* sz;
+	};
+
+	static PoseLanes getPoseLanes(const ew::PoseBuffer& pose) {
+		ew::PoseBuffer& p = const_cast<ew::PoseBuffer&>(pose);
+		return { p.px.data(), p.py.data(), p.pz.data(), p.rx.data(), p.ry.data(), p.rz.data(), p.rw.data(), p.sx.data(), p.sy.data(), p.sz.data() };
+	}
+
+	//Resizes out to match the inputs. Leaves it alone if it already matches, which keeps in-place blends valid.
+	static PoseLanes getOutputLanes(ew::PoseBuffer* out, size_t numBones) {
+		if (out->numBones != numBones || out->px.size() != simdPaddedSize(numBones)) {
+			resizePoseBuffer(out, numBones);
+		}
+		return getPoseLanes(*out);
+	}
+
+	template<typename V>
+	static inline void storeNormalizedQuat(const PoseLanes& out, size_t i, V x, V y, V z, V w) {
+		V invLength = vdiv(vset(1.0f, V()), vsqrt(dot4(x, y, z, w, x, y, z, w)));
+		vstore(out.rx + i, vmul(x, invLength));
+		vstore(out.ry + i, vmul(y, invLength));
+		vstore(out.rz + i, vmul(z, invLength));
+		vstore(out.rw + i, vmul(w, invLength));
+	}
+
+	//a + (b - a) * t for one component array
+	template<typename V>
+	static inline void lerpComponent(const float* a, const float* b, float* out, size_t i, V t) {
+		V va = vload(a + i, V());
+		vstore(out + i, vadd(va, vmul(vsub(vload(b + i, V()), va), t)));
+	}
+
+	template<typename V>
+	static inline void blendLanes(const PoseLanes& a, const PoseLanes& b, const PoseLanes& out, size_t i, V t) {
+		lerpComponent(a.px, b.px, out.px, i, t);
+		lerpComponent(a.py, b.py, out.py, i, t);
+		lerpComponent(a.pz, b.pz, out.pz, i, t);
+		lerpComponent(a.sx, b.sx, out.sx, i, t);
+		lerpComponent(a.sy, b.sy, out.sy, i, t);
+		lerpComponent(a.sz, b.sz, out.sz, i, t);
+		V ax = vload(a.rx + i, V()), ay = vload(a.ry + i, V()), az = vload(a.rz + i, V()), aw = vload(a.rw + i, V());
+		V bx = vload(b.rx + i, V()), by = vload(b.ry + i, V()), bz = vload(b.rz + i, V()), bw = vload(b.rw + i, V());
+		V wa = vsub(vset(1.0f, V()), t);
+		V wb = vmul(t, vsign(dot4(ax, ay, az, aw, bx, by, bz, bw)));
+		storeNormalizedQuat(out, i,
+			vadd(vmul(ax, wa), vmul(bx, wb)), vadd(vmul(ay, wa), vmul(by, wb)),
+			vadd(vmul(az, wa), vmul(bz, wb)), vadd(vmul(aw, wa), vmul(bw, wb)));
+	}
+
+	template<typename V>
+	static inline void makeAdditiveLanes(const PoseLanes& pose, const PoseLanes& reference, const PoseLanes& out, size_t i) {
+		vstore(out.px + i, vsub(vload(pose.px + i, V()), vload(reference.px + i, V())));
+		vstore(out.py + i, vsub(vload(pose.py + i, V()), vload(reference.py + i, V())));
+		vstore(out.pz + i, vsub(vload(pose.pz + i, V()), vload(reference.pz + i, V())));
+		vstore(out.sx + i, vdiv(vload(pose.sx + i, V()), vload(reference.sx + i, V())));
+		vstore(out.sy + i, vdiv(vload(pose.sy + i, V()), vload(reference.sy + i, V())));
+		vstore(out.sz + i, vdiv(vload(pose.sz + i, V()), vload(reference.sz + i, V())));
+		//pose * conjugate(reference)
+		V zero = vset(0.0f, V());
+		V x, y, z, w;
+		multiplyQuatLanes(vload(pose.rx + i, V()), vload(pose.ry + i, V()), vload(pose.rz + i, V()), vload(pose.rw + i, V()),
+			vsub(zero, vload(reference.rx + i, V())), vsub(zero, vload(reference.ry + i, V())), vsub(zero, vload(reference.rz + i, V())), vload(reference.rw + i, V()),
+			&x, &y, &z, &w);
+		vstore(out.rx + i, x);
+		vstore(out.ry + i, y);
+		vstore(out.rz + i, z);
+		vstore(out.rw + i, w);
+	}
+
+	template<typename V>
+	static inline void addLanes(const PoseLanes& base, const PoseLanes& additive, const PoseLanes& out, size_t i, V weight) {
+		V one = vset(1.0f, V());
+		vstore(out.px + i, vadd(vload(base.px + i, V()), vmul(vload(additive.px + i, V()), weight)));
+		vstore(out.py + i, vadd(vload(base.py + i, V()), vmul(vload(additive.py + i, V()), weight)));
+		vstore(out.pz + i, vadd(vload(base.pz + i, V()), vmul(vload(additive.pz + i, V()), weight)));
+		vstore(out.sx + i, vmul(vload(base.sx + i, V()), vadd(one, vmul(vsub(vload(additive.sx + i, V()), one), weight))));
+		vstore(out.sy + i, vmul(vload(base.sy + i, V()), vadd(one, vmul(vsub(vload(additive.sy + i, V()), one), weight))));
+		vstore(out.sz + i, vmul(vload(base.sz + i, V()), vadd(one, vmul(vsub(vload(additive.sz + i, V()), one), weight))));
+		//Scale the additive rotation by nlerp from identity, then apply it on top of base
+		V dw = vload(additive.rw + i, V());
+		V wb = vmul(weight, vsign(dw));
+		V wa = vsub(one, weight);
+		V dx = vmul(vload(additive.rx + i, V()), wb);
+		V dy = vmul(vload(additive.ry + i, V()), wb);
+		V dz = vmul(vload(additive.rz + i, V()), wb);
+		dw = vadd(wa, vmul(dw, wb));
+		V x, y, z, w;
+		multiplyQuatLanes(dx, dy, dz, dw,
+			vload(base.rx + i, V()), vload(base.ry + i, V()), vload(base.rz + i, V()), vload(base.rw + i, V()),
+			&x, &y, &z, &w);
+		storeNormalizedQuat(out, i, x, y, z, w);
+	}
+
+	void blendPoses(const ew::PoseBuffer& a, const ew::PoseBuffer& b, float weight, ew::PoseBuffer* out) {
+		const PoseLanes la = getPoseLanes(a), lb = getPoseLanes(b), lo = getOutputLanes(out, a.numBones);
+		const size_t count = simdPaddedSize(a.numBones);
+		size_t i = 0;
+#ifdef EW_SIMD_AVX
+		for (; i + 8 <= count; i += 8) blendLanes(la, lb, lo, i, vset(weight, __m256()));
+#endif
+#ifdef EW_SIMD_SSE
+		for (; i + 4 <= count; i += 4) blendLanes(la, lb, lo, i, vset(weight, __m128()));
+#endif
+		for (; i < count; i++) blendLanes(la, lb, lo, i, weight);
+	}
+
+	void blendPosesMasked(const ew::PoseBuffer& a, const ew::PoseBuffer& b, const ew::BoneMask& mask, float weight, ew::PoseBuffer* out) {
+		const PoseLanes la = getPoseLanes(a), lb = getPoseLanes(b), lo = getOutputLanes(out, a.numBones);
+		const size_t count = simdPaddedSize(a.numBones);
+		const float* m = mask.data();
+		size_t i = 0;
+#ifdef EW_SIMD_AVX
+		for (; i + 8 <= count; i += 8) blendLanes(la, lb, lo, i, vmul(vload(m + i, __m256()), vset(weight, __m256())));
+#endif
+#ifdef EW_SIMD_SSE
+		for (; i + 4 <= count; i += 4) blendLanes(la, lb, lo, i, vmul(vload(m + i, __m128()), vset(weight, __m128())));
+#endif
+		for (; i < count; i++) blendLanes(la, lb, lo, i, m[i] * weight);
+	}
+
+	void makeAdditivePose(const ew::PoseBuffer& pose, const ew::PoseBuffer& reference, ew::PoseBuffer* out) {
+		const PoseLanes lp = getPoseLanes(pose), lr = getPoseLanes(reference), lo = getOutputLanes(out, pose.numBones);
+		const size_t count = simdPaddedSize(pose.numBones);
+		size_t i = 0;
+#ifdef EW_SIMD_AVX
+		for (; i + 8 <= count; i += 8) makeAdditiveLanes<__m256>(lp, lr, lo, i);
+#endif
+#ifdef EW_SIMD_SSE
+		for (; i + 4 <= count; i += 4) makeAdditiveLanes<__m128>(lp, lr, lo, i);
+#endif
+		for (; i < count; i++) makeAdditiveLanes<float>(lp, lr, lo, i);
+	}
+
+	void addPose(const ew::PoseBuffer& base, const ew::PoseBuffer& additive, float weight, ew::PoseBuffer* out) {
+		const PoseLanes lb = getPoseLanes(base), la = getPoseLanes(additive), lo = getOutputLanes(out, base.numBones);
+		const size_t count = simdPaddedSize(base.numBones);
+		size_t i = 0;
+#ifdef EW_SIMD_AVX
+		for (; i + 8 <= count; i += 8) addLanes(lb, la, lo, i, vset(weight, __m256()));
+#endif
+#ifdef EW_SIMD_SSE
+		for (; i + 4 <= count; i += 4) addLanes(lb, la, lo, i, vset(weight, __m128()));
+#endif
+		for (; i < count; i++) addLanes(lb, la, lo, i, weight);
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include "animation.h"
+
+namespace ew {
+	/// <summary>
+	/// Local pose of a skeleton as translation, rotation and scale in SoA layout, one lane per bone.
+	/// Arrays are padded to SIMD_WIDTH with identity transforms, so blend kernels run on whole registers with no tail.
+	/// Poses blend per component, which a mat4 local transform can't do cheaply.
+	/// </summary>
+	struct PoseBuffer {
+		size_t numBones = 0;
+		std::vector<float> px, py, pz; //Position
+		std::vector<float> rx, ry, rz, rw; //Rotation
+		std::vector<float> sx, sy, sz; //Scale
+	};
+	//Resizes pose to numBones, resetting every bone to identity
+	void resizePoseBuffer(ew::PoseBuffer* pose, size_t numBones);
+	//Decomposes the local transforms of skeleton into pose. Assumes no shear.
+	void loadPoseFromSkeleton(const ew::Skeleton& skeleton, ew::PoseBuffer* pose);
+	//Composes every bone of pose into the local transforms of skeleton and marks them dirty
+	void applyPose(const ew::PoseBuffer& pose, ew::Skeleton* skeleton);
+
+	//Samples animClip into the bones of pose it is bound to. Other bones keep their values.
+	void samplePose(const ew::AnimationClip* animClip, const ew::AnimationBinding& binding, float normalizedTime, ew::PoseBuffer* pose, ew::AnimationCursor* cursor = nullptr);
+
+	//Per bone blend weights, padded like a PoseBuffer. Multiplied with the weight of a masked blend.
+	typedef std::vector<float> BoneMask;
+	//weight for rootBone and all of its descendants, 0 for every other bone. Use a spine bone for upper body layers.
+	BoneMask makeBoneMask(const ew::Skeleton& skeleton, int rootBone, float weight = 1.0f);
+
+	//Blend nodes. out may be the same buffer as an input. All inputs must have the same number of bones.
+
+	//out = lerp(a, b, weight). Rotations take the shortest path and are normalized.
+	void blendPoses(const ew::PoseBuffer& a, const ew::PoseBuffer& b, float weight, ew::PoseBuffer* out);
+	//Same as blendPoses with weight * mask[bone] per bone
+	void blendPosesMasked(const ew::PoseBuffer& a, const ew::PoseBuffer& b, const ew::BoneMask& mask, float weight, ew::PoseBuffer* out);
+	//Difference between pose and reference: position offset, rotation with pose = delta * reference, and scale ratio
+	void makeAdditivePose(const ew::PoseBuffer& pose, const ew::PoseBuffer& reference, ew::PoseBuffer* out);
+	//Layers an additive pose from makeAdditivePose onto base, scaled by weight
+	void addPose(const ew::PoseBuffer& base, const ew::PoseBuffer& additive, float weight, ew::PoseBuffer* out);
+}
@@ -0,0 +1,109 @@
+#include "poseCache.h"
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+namespace ew {
+	bool PoseCache::Key::operator==(const Key& other) const {
+		return animClip == other.animClip && binding == other.binding && timeBits == other.timeBits;
+	}
+
+	size_t PoseCache::KeyHash::operator()(const Key& key) const {
+		size_t hash = std::hash<const void*>()(key.animClip);
+		hash ^= std::hash<const void*>()(key.binding) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+		return hash ^ (std::hash<uint32_t>()(key.timeBits) + 0x9e3779b9 + (hash << 6) + (hash >> 2));
+	}
+
+	void PoseCache::beginFrame() {
+		//On wrap around, slots from 2^32 frames ago would look current
+		if (++m_frame == 0) {
+			for (Shard& shard : m_shards)
+			{
+				for (Slot& slot : shard.slots)
+					slot.frame = 0;
+			}
+			m_frame = 1;
+		}
+		for (Shard& shard : m_shards)
+		{
+			shard.numUsed = 0;
+		}
+	}
+
+	//Fibonacci hashing. Round times have zero low mantissa bits, so the low bits of KeyHash alone cluster.
+	size_t PoseCache::getSlotIndex(size_t hash, size_t numSlots) {
+		return (size_t)(((uint64_t)hash * 11400714819323198485ull) >> 32) & (numSlots - 1);
+	}
+
+	void PoseCache::growSlots(Shard* shard) {
+		std::vector<Slot> oldSlots(std::max<size_t>(shard->slots.size() * 2, 16));
+		oldSlots.swap(shard->slots);
+		const size_t numSlots = shard->slots.size();
+		for (const Slot& slot : oldSlots)
+		{
+			if (slot.frame != m_frame)
+				continue;
+			size_t index = getSlotIndex(KeyHash()(slot.key), numSlots);
+			while (shard->slots[index].frame == m_frame)
+				index = (index + 1) & (numSlots - 1);
+			shard->slots[index] = slot;
+		}
+	}
+
+	float PoseCache::quantizeTime(const ew::AnimationClip& animClip, float normalizedTime, float timeStep) {
+		const float seconds = animClip.duration / ew::getTicksPerSecond(animClip);
+		if (timeStep <= 0.0f || seconds <= 0.0f)
+			return normalizedTime;
+		const float step = timeStep / seconds;
+		return glm::min(roundf(normalizedTime / step) * step, 1.0f);
+	}
+
+	ew::PoseCacheEntry* PoseCache::findOrCreate(const ew::AnimationClip* animClip, const ew::AnimationBinding* binding, float quantizedTime, bool* created) {
+		Key key;
+		key.animClip = animClip;
+		key.binding = binding;
+		memcpy(&key.timeBits, &quantizedTime, sizeof(key.timeBits));
+		const size_t hash = KeyHash()(key);
+		Shard& shard = m_shards[(hash >> 4) % NUM_SHARDS];
+
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		if ((shard.numUsed + 1) * 2 > shard.slots.size()) {
+			growSlots(&shard);
+		}
+		const size_t mask = shard.slots.size() - 1;
+		size_t index = getSlotIndex(hash, shard.slots.size());
+		while (shard.slots[index].frame == m_frame)
+		{
+			if (shard.slots[index].key == key) {
+				*created = false;
+				return shard.slots[index].entry;
+			}
+			index = (index + 1) & mask;
+		}
+		if (shard.numUsed == shard.entries.size()) {
+			shard.entries.emplace_back(new PoseCacheEntry());
+		}
+		PoseCacheEntry* entry = shard.entries[shard.numUsed++].get();
+		entry->ready.store(false, std::memory_order_relaxed);
+		Slot& slot = shard.slots[index];
+		slot.key = key;
+		slot.frame = m_frame;
+		slot.entry = entry;
+		*created = true;
+		return entry;
+	}
+
+	void PoseCache::publish(ew::PoseCacheEntry* entry) {
+		entry->ready.store(true, std::memory_order_release);
+	}
+
+	int PoseCache::getNumEntries() {
+		int numEntries = 0;
+		for (Shard& shard : m_shards)
+		{
+			std::lock_guard<std::mutex> lock(shard.mutex);
+			numEntries += (int)shard.numUsed;
+		}
+		return numEntries;
+	}
+}
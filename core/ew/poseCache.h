@@ -0,0 +1,82 @@
+#pragma once
+#include "animation.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+namespace ew {
+	struct PoseCacheSettings {
+		bool enabled = false;
+		//Sample times are rounded to multiples of this many seconds, so instances at nearby phases share a pose.
+		//0 only shares between instances at exactly the same time.
+		float timeStep = 0.0f;
+	};
+	struct PoseCacheStats {
+		int lookups = 0;
+		int hits = 0;
+		int entries = 0; //Distinct poses sampled this frame
+		float savedMilliseconds = 0.0f; //Sampling time of every hit's entry, minus the time spent copying it
+		inline float getHitRate() const { return lookups > 0 ? (float)hits / lookups : 0.0f; }
+	};
+
+	//A pose sampled once this frame
+	struct PoseCacheEntry {
+		std::vector<glm::mat4> localTransforms; //Every bone of the skeleton that sampled it
+		std::vector<glm::mat4> worldMatrices;
+		float sampleMicroseconds = 0.0f;
+		std::atomic<bool> ready{ false }; //Set by publish once the entry is filled
+	};
+
+	/// <summary>
+	/// Per-frame cache of sampled poses keyed by clip, binding and quantized time.
+	/// Instances that share a key must share a skeleton, as a hit copies the pose of whichever instance sampled it first.
+	/// Poses that skip optional bones are never cached, since those bones differ between instances.
+	/// Lookups are thread safe. An entry still being filled by another thread counts as a miss rather than a wait.
+	/// beginFrame invalidates every entry by bumping a frame counter instead of clearing, so once the cache
+	/// has grown to a frame's working set, later frames allocate nothing.
+	/// </summary>
+	class PoseCache {
+	public:
+		PoseCache() {};
+		PoseCache(const PoseCache&) = delete;
+		PoseCache& operator=(const PoseCache&) = delete;
+
+		//Not thread safe. Call before any lookups of a frame.
+		void beginFrame();
+		//Rounds normalizedTime to a multiple of timeStep seconds of animClip
+		static float quantizeTime(const ew::AnimationClip& animClip, float normalizedTime, float timeStep);
+		//Returns this frame's entry for the key. If *created is set, the caller must fill it and call publish.
+		ew::PoseCacheEntry* findOrCreate(const ew::AnimationClip* animClip, const ew::AnimationBinding* binding, float quantizedTime, bool* created);
+		static void publish(ew::PoseCacheEntry* entry);
+		int getNumEntries();
+	private:
+		struct Key {
+			const ew::AnimationClip* animClip;
+			const ew::AnimationBinding* binding;
+			uint32_t timeBits;
+			bool operator==(const Key& other) const;
+		};
+		struct KeyHash {
+			size_t operator()(const Key& key) const;
+		};
+		//Open addressing slot. Empty unless frame is the current frame.
+		struct Slot {
+			Key key;
+			uint32_t frame = 0;
+			ew::PoseCacheEntry* entry = nullptr;
+		};
+		static const int NUM_SHARDS = 16;
+		//Lookups from different threads mostly land in different shards
+		struct Shard {
+			std::mutex mutex;
+			std::vector<Slot> slots; //Power of two, at most half full
+			std::vector<std::unique_ptr<ew::PoseCacheEntry>> entries;
+			size_t numUsed = 0;
+		};
+		static size_t getSlotIndex(size_t hash, size_t numSlots);
+		void growSlots(Shard* shard);
+		Shard m_shards[NUM_SHARDS];
+		uint32_t m_frame = 1;
+	};
+}
@@ -28,7 +28,7 @@ namespace ew {
 			vec3 pos = normal * size * 0.5f;
 			pos -= (a + b) * size * 0.5f;
 			pos += (a * (float)col + b * (float)row) * size;
-			Vertex vertex;// = &mesh->vertices[mesh->vertices.size()];
+			Vertex vertex = {};
 			vertex.pos = pos;
 			vertex.normal = normal;
 			vertex.uv = glm::vec2(col, row);
@@ -70,7 +70,7 @@ namespace ew {
 		{
 			for (size_t col = 0; col <= subdivisions; col++)
 			{
-				Vertex v;                                                                                                                                                                                                                                                                                                                                                                                                    
+				Vertex v = {};                                                                                                                                                                                                                                                                                                                                                                                                    
 				v.uv.x = ((float)col / subdivisions);
 				v.uv.y = ((float)row / subdivisions);
 				v.pos.x = width * v.uv.x;
@@ -109,7 +109,7 @@ namespace ew {
 			for (size_t col = 0; col <= subdivisions; col++)
 			{
 				float theta = thetaStep * col;
-				Vertex v;
+				Vertex v = {};
 				v.normal.x = cosf(theta) * sinf(phi);
 				v.normal.y = cosf(phi);
 				v.normal.z = sinf(theta) * sinf(phi);
@@ -164,7 +164,7 @@ namespace ew {
 			float theta = i * thetaStep;
 			float cosA = cosf(theta);
 			float sinA = sinf(theta);
-			Vertex v;
+			Vertex v = {};
 			v.pos = vec3(cosA * radius, y, sinA * radius);
 			if (sideFacing) {
 				v.normal = vec3(cosA, 0, sinA);
@@ -187,7 +187,7 @@ namespace ew {
 			const float topY = height * 0.5;
 			const float bottomY = -topY;
 
-			Vertex topVertex;
+			Vertex topVertex = {};
 			topVertex.pos = vec3(0, topY, 0);
 			topVertex.normal = vec3(0, 1, 0);
 			topVertex.uv = vec2(0.5f);
@@ -198,7 +198,7 @@ namespace ew {
 			createCylinderRing(&mesh, radius, subdivisions, bottomY, true);
 			createCylinderRing(&mesh, radius, subdivisions, bottomY, false);
 
-			Vertex bottomVertex;
+			Vertex bottomVertex = {};
 			bottomVertex.pos = vec3(0, bottomY, 0);
 			bottomVertex.normal = vec3(0, -1, 0);
 			bottomVertex.uv = vec2(0.5f);
@@ -0,0 +1,81 @@
+#pragma once
+#include <stddef.h>
+#include <math.h>
+
+//SIMD support detection for the batch kernels.
+//SSE2 is part of every x64 target. AVX is only used when the compiler is set to target it (/arch:AVX, -mavx).
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define EW_SIMD_SSE 1
+#include <immintrin.h>
+#endif
+#if defined(EW_SIMD_SSE) && defined(__AVX__)
+#define EW_SIMD_AVX 1
+#endif
+
+namespace ew {
+	//Float arrays used by SIMD kernels are padded to a multiple of this many elements
+	const size_t SIMD_WIDTH = 8;
+	inline size_t simdPaddedSize(size_t count) {
+		return (count + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+	}
+
+	//Lane wrappers so each kernel is written once for scalar, SSE and AVX
+	inline float vload(const float* p, float) { return *p; }
+	inline void vstore(float* p, float v) { *p = v; }
+	inline float vset(float v, float) { return v; }
+	inline float vsqrt(float v) { return sqrtf(v); }
+	inline float vsign(float v) { return v < 0 ? -1.0f : 1.0f; }
+	inline float vadd(float a, float b) { return a + b; }
+	inline float vsub(float a, float b) { return a - b; }
+	inline float vmul(float a, float b) { return a * b; }
+	inline float vdiv(float a, float b) { return a / b; }
+	inline float vmin(float a, float b) { return a < b ? a : b; }
+	inline float vmax(float a, float b) { return a > b ? a : b; }
+	//a < b ? x : y per lane
+	inline float vselectLess(float a, float b, float x, float y) { return a < b ? x : y; }
+#ifdef EW_SIMD_SSE
+	inline __m128 vload(const float* p, __m128) { return _mm_loadu_ps(p); }
+	inline void vstore(float* p, __m128 v) { _mm_storeu_ps(p, v); }
+	inline __m128 vset(float v, __m128) { return _mm_set1_ps(v); }
+	inline __m128 vsqrt(__m128 v) { return _mm_sqrt_ps(v); }
+	inline __m128 vsign(__m128 v) { return _mm_or_ps(_mm_and_ps(v, _mm_set1_ps(-0.0f)), _mm_set1_ps(1.0f)); }
+	inline __m128 vadd(__m128 a, __m128 b) { return _mm_add_ps(a, b); }
+	inline __m128 vsub(__m128 a, __m128 b) { return _mm_sub_ps(a, b); }
+	inline __m128 vmul(__m128 a, __m128 b) { return _mm_mul_ps(a, b); }
+	inline __m128 vdiv(__m128 a, __m128 b) { return _mm_div_ps(a, b); }
+	inline __m128 vmin(__m128 a, __m128 b) { return _mm_min_ps(a, b); }
+	inline __m128 vmax(__m128 a, __m128 b) { return _mm_max_ps(a, b); }
+	inline __m128 vselectLess(__m128 a, __m128 b, __m128 x, __m128 y) {
+		__m128 mask = _mm_cmplt_ps(a, b);
+		return _mm_or_ps(_mm_and_ps(mask, x), _mm_andnot_ps(mask, y));
+	}
+#endif
+#ifdef EW_SIMD_AVX
+	inline __m256 vload(const float* p, __m256) { return _mm256_loadu_ps(p); }
+	inline void vstore(float* p, __m256 v) { _mm256_storeu_ps(p, v); }
+	inline __m256 vset(float v, __m256) { return _mm256_set1_ps(v); }
+	inline __m256 vsqrt(__m256 v) { return _mm256_sqrt_ps(v); }
+	inline __m256 vsign(__m256 v) { return _mm256_or_ps(_mm256_and_ps(v, _mm256_set1_ps(-0.0f)), _mm256_set1_ps(1.0f)); }
+	inline __m256 vadd(__m256 a, __m256 b) { return _mm256_add_ps(a, b); }
+	inline __m256 vsub(__m256 a, __m256 b) { return _mm256_sub_ps(a, b); }
+	inline __m256 vmul(__m256 a, __m256 b) { return _mm256_mul_ps(a, b); }
+	inline __m256 vdiv(__m256 a, __m256 b) { return _mm256_div_ps(a, b); }
+	inline __m256 vmin(__m256 a, __m256 b) { return _mm256_min_ps(a, b); }
+	inline __m256 vmax(__m256 a, __m256 b) { return _mm256_max_ps(a, b); }
+	inline __m256 vselectLess(__m256 a, __m256 b, __m256 x, __m256 y) { return _mm256_blendv_ps(y, x, _mm256_cmp_ps(a, b, _CMP_LT_OQ)); }
+#endif
+
+	template<typename V>
+	inline V dot4(V ax, V ay, V az, V aw, V bx, V by, V bz, V bw) {
+		return vadd(vadd(vmul(ax, bx), vmul(ay, by)), vadd(vmul(az, bz), vmul(aw, bw)));
+	}
+
+	//Quaternion product r = a * b, one quaternion per lane
+	template<typename V>
+	inline void multiplyQuatLanes(V ax, V ay, V az, V aw, V bx, V by, V bz, V bw, V* rx, V* ry, V* rz, V* rw) {
+		*rx = vsub(vadd(vadd(vmul(aw, bx), vmul(ax, bw)), vmul(ay, bz)), vmul(az, by));
+		*ry = vadd(vadd(vsub(vmul(aw, by), vmul(ax, bz)), vmul(ay, bw)), vmul(az, bx));
+		*rz = vadd(vsub(vadd(vmul(aw, bz), vmul(ax, by)), vmul(ay, bx)), vmul(az, bw));
+		*rw = vsub(vsub(vsub(vmul(aw, bw), vmul(ax, bx)), vmul(ay, by)), vmul(az, bz));
+	}
+}
@@ -0,0 +1,194 @@
+#include "skinning.h"
+#include "external/glad.h"
+#include <stdio.h>
+#include <math.h>
+#include <unordered_map>
+
+namespace ew {
+	//Bind poses with more scale than this are reported by loadDualQuatPose
+	const float DUAL_QUAT_SCALE_TOLERANCE = 0.001f;
+
+	DualQuat makeDualQuat(const glm::quat& rotation, const glm::vec3& translation) {
+		DualQuat dq;
+		dq.real = rotation;
+		dq.dual = glm::quat(0.0f, translation.x, translation.y, translation.z) * rotation * 0.5f;
+		return dq;
+	}
+
+	DualQuat dualQuatFromMat4(const glm::mat4& m) {
+		glm::mat3 rotation(glm::normalize(glm::vec3(m[0])), glm::normalize(glm::vec3(m[1])), glm::normalize(glm::vec3(m[2])));
+		return makeDualQuat(glm::normalize(glm::quat_cast(rotation)), glm::vec3(m[3]));
+	}
+
+	static bool hasScale(const glm::mat4& m) {
+		for (int i = 0; i < 3; i++)
+		{
+			if (fabsf(glm::length(glm::vec3(m[i])) - 1.0f) > DUAL_QUAT_SCALE_TOLERANCE)
+				return true;
+		}
+		return false;
+	}
+
+	SkinBinding bindSkin(const ew::Model& model, const ew::Skeleton& skeleton) {
+		std::unordered_map<std::string, int> boneIndexMap;
+		boneIndexMap.reserve(skeleton.bones.size());
+		for (size_t i = 0; i < skeleton.bones.size(); i++)
+		{
+			boneIndexMap.emplace(skeleton.bones[i].name, (int)i);
+		}
+		SkinBinding skinBinding;
+		skinBinding.boneIndices.assign(model.getNumBones(), -1);
+		skinBinding.inverseBindPoses.assign(model.getNumBones(), glm::mat4(1.0f));
+		skinBinding.inverseBindDualQuats.resize(model.getNumBones());
+		for (const auto& it : model.getBoneInfoMap())
+		{
+			const BoneInfo& boneInfo = it.second;
+			skinBinding.inverseBindPoses[boneInfo.id] = boneInfo.invBindPose;
+			skinBinding.inverseBindDualQuats[boneInfo.id] = dualQuatFromMat4(boneInfo.invBindPose);
+			auto boneIt = boneIndexMap.find(it.first);
+			if (boneIt == boneIndexMap.end()) {
+				printf("Skinned bone %s not found in skeleton\n", it.first.c_str());
+				continue;
+			}
+			skinBinding.boneIndices[boneInfo.id] = boneIt->second;
+		}
+		return skinBinding;
+	}
+
+	void computeSkinningPalette(const ew::SkinBinding& skinBinding, const std::vector<glm::mat4>& worldMatrices, glm::mat4* palette) {
+		for (size_t i = 0; i < skinBinding.boneIndices.size(); i++)
+		{
+			const int boneIndex = skinBinding.boneIndices[i];
+			//Unbound bones stay in bind pose
+			palette[i] = boneIndex == -1 ? glm::mat4(1.0f) : worldMatrices[boneIndex] * skinBinding.inverseBindPoses[i];
+		}
+	}
+
+	void loadDualQuatPose(const ew::Skeleton& skeleton, ew::DualQuatPose* pose) {
+		const size_t numBones = skeleton.bones.size();
+		pose->parents.resize(numBones);
+		pose->localTransforms.resize(numBones);
+		pose->worldTransforms.resize(numBones);
+		for (size_t i = 0; i < numBones; i++)
+		{
+			const Bone& bone = skeleton.bones[i];
+			pose->parents[i] = bone.parentIndex;
+			pose->localTransforms[i] = dualQuatFromMat4(bone.localTransform);
+			if (hasScale(bone.localTransform)) {
+				printf("Bone %s has scale, dual quaternion skinning will ignore it\n", bone.name.c_str());
+			}
+		}
+	}
+
+	void updateDualQuatPose(ew::DualQuatPose* pose, const ew::AnimationClip* animClip, const ew::AnimationBinding& binding, float normalizedTime, ew::AnimationCursor* cursor) {
+		float time = animClip->duration * glm::clamp(normalizedTime, 0.0f, 1.0f);
+		if (cursor != nullptr && cursor->channels.size() != animClip->bones.size()) {
+			cursor->channels.assign(animClip->bones.size(), ChannelCursor());
+		}
+		for (size_t i = 0; i < animClip->bones.size(); i++)
+		{
+			glm::vec3 position, scale;
+			glm::quat rotation;
+			if (animClip->useBakedTrack) {
+				sampleBakedPoseTrack(animClip->bakedTrack, i, time, &position, &rotation, &scale);
+			}
+			else {
+				sampleBoneAnimation(animClip->bones[i], time, cursor ? &cursor->channels[i] : nullptr, &position, &rotation, &scale);
+			}
+			pose->localTransforms[binding.boneIndices[i]] = makeDualQuat(rotation, position);
+		}
+		//Parents come before children
+		for (size_t i = 0; i < pose->localTransforms.size(); i++)
+		{
+			const int parent = pose->parents[i];
+			pose->worldTransforms[i] = parent == -1 ? pose->localTransforms[i] : multiplyDualQuat(pose->worldTransforms[parent], pose->localTransforms[i]);
+		}
+	}
+
+	void computeDualQuatSkinningPalette(const ew::SkinBinding& skinBinding, const ew::DualQuatPose& pose, ew::DualQuat* palette) {
+		for (size_t i = 0; i < skinBinding.boneIndices.size(); i++)
+		{
+			const int boneIndex = skinBinding.boneIndices[i];
+			palette[i] = boneIndex == -1 ? DualQuat() : multiplyDualQuat(pose.worldTransforms[boneIndex], skinBinding.inverseBindDualQuats[i]);
+		}
+	}
+
+	void skinVertex(const ew::Vertex& vertex, const glm::mat4* palette, glm::vec3* position, glm::vec3* normal) {
+		//Same operation order as skinned.vert
+		glm::mat4 skinMatrix(0.0f);
+		float totalWeight = 0.0f;
+		for (int i = 0; i < MAX_BONE_WEIGHTS; i++)
+		{
+			skinMatrix += palette[vertex.boneIDs[i]] * vertex.boneWeights[i];
+			totalWeight += vertex.boneWeights[i];
+		}
+		if (totalWeight <= 0.0f) {
+			skinMatrix = glm::mat4(1.0f);
+		}
+		*position = glm::vec3(skinMatrix * glm::vec4(vertex.pos, 1.0f));
+		//Palette matrices are rigid plus uniform scale, so the upper 3x3 transforms normals correctly up to length
+		*normal = glm::normalize(glm::mat3(skinMatrix) * vertex.normal);
+	}
+
+	void skinVertexDualQuat(const ew::Vertex& vertex, const ew::DualQuat* palette, glm::vec3* position, glm::vec3* normal) {
+		//Same operation order as skinnedDQ.vert
+		glm::quat real(0, 0, 0, 0), dual(0, 0, 0, 0);
+		const glm::quat& pivot = palette[vertex.boneIDs[0]].real;
+		for (int i = 0; i < MAX_BONE_WEIGHTS; i++)
+		{
+			const DualQuat& dq = palette[vertex.boneIDs[i]];
+			//q and -q are the same rotation. Blend along the shortest arc.
+			float w = glm::dot(dq.real, pivot) < 0.0f ? -vertex.boneWeights[i] : vertex.boneWeights[i];
+			real = real + dq.real * w;
+			dual = dual + dq.dual * w;
+		}
+		float length = glm::length(real);
+		if (length <= 0.0f) {
+			*position = vertex.pos;
+			*normal = vertex.normal;
+			return;
+		}
+		DualQuat blended;
+		blended.real = real * (1.0f / length);
+		blended.dual = dual * (1.0f / length);
+		*position = blended.real * vertex.pos + getDualQuatTranslation(blended);
+		*normal = blended.real * vertex.normal;
+	}
+
+	SkinningPaletteBuffer::~SkinningPaletteBuffer() {
+		if (m_ssbo != 0) {
+			glDeleteBuffers(1, &m_ssbo);
+		}
+	}
+
+	void SkinningPaletteBuffer::upload(const glm::mat4* palettes, int numBones, int numInstances) {
+		m_numBones = numBones;
+		uploadBytes(palettes, sizeof(glm::mat4) * numBones * numInstances);
+	}
+
+	void SkinningPaletteBuffer::upload(const ew::DualQuat* palettes, int numBones, int numInstances) {
+		static_assert(sizeof(DualQuat) == 8 * sizeof(float), "skinnedDQ.vert reads each DualQuat as 2 vec4s");
+		m_numBones = numBones;
+		uploadBytes(palettes, sizeof(DualQuat) * numBones * numInstances);
+	}
+
+	void SkinningPaletteBuffer::uploadBytes(const void* data, size_t size) {
+		if (size == 0)
+			return;
+		if (m_ssbo == 0) {
+			glCreateBuffers(1, &m_ssbo);
+		}
+		if (size > m_capacity) {
+			//Reallocate to grow. Dynamic usage since it is refilled every frame.
+			glNamedBufferData(m_ssbo, size, data, GL_DYNAMIC_DRAW);
+			m_capacity = size;
+		}
+		else {
+			glNamedBufferSubData(m_ssbo, 0, size, data);
+		}
+	}
+
+	void SkinningPaletteBuffer::bind(unsigned int bindingPoint) const {
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, bindingPoint, m_ssbo);
+	}
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include "animation.h"
+#include "model.h"
+
+namespace ew {
+	//Shader storage binding point of the palette, matches skinned.vert and skinnedDQ.vert
+	const unsigned int SKINNING_PALETTE_BINDING = 0;
+
+	//Rigid transform as a unit dual quaternion. 32 bytes, half of a mat4.
+	//real is the rotation, dual is 0.5 * translation * real.
+	struct DualQuat {
+		glm::quat real = glm::quat(1, 0, 0, 0);
+		glm::quat dual = glm::quat(0, 0, 0, 0);
+	};
+	DualQuat makeDualQuat(const glm::quat& rotation, const glm::vec3& translation);
+	//Rigid part of m. Scale and shear are dropped.
+	DualQuat dualQuatFromMat4(const glm::mat4& m);
+	//Applies b, then a. Same order as mat4 a * b.
+	inline DualQuat multiplyDualQuat(const DualQuat& a, const DualQuat& b) {
+		DualQuat r;
+		r.real = a.real * b.real;
+		r.dual = a.real * b.dual + a.dual * b.real;
+		return r;
+	}
+	inline glm::vec3 getDualQuatTranslation(const DualQuat& dq) {
+		glm::quat t = dq.dual * glm::conjugate(dq.real);
+		return 2.0f * glm::vec3(t.x, t.y, t.z);
+	}
+
+	//Maps each palette entry of a Model (BoneInfo::id) to a skeleton bone
+	struct SkinBinding {
+		std::vector<int> boneIndices; //Skeleton bone index per palette entry, -1 if the skeleton lacks the bone
+		std::vector<glm::mat4> inverseBindPoses; //Per palette entry
+		std::vector<ew::DualQuat> inverseBindDualQuats; //Rigid part of inverseBindPoses
+	};
+	//Resolves model bones by name. Unmatched bones are reported and keep their bind pose.
+	SkinBinding bindSkin(const ew::Model& model, const ew::Skeleton& skeleton);
+
+	//palette[i] = worldMatrices[boneIndices[i]] * inverseBindPoses[i]. palette must hold boneIndices.size() matrices.
+	void computeSkinningPalette(const ew::SkinBinding& skinBinding, const std::vector<glm::mat4>& worldMatrices, glm::mat4* palette);
+
+	/// <summary>
+	/// Local and world bone transforms of a skeleton as dual quaternions.
+	/// Updated straight from a clip's rotation and translation keys without building any matrix.
+	/// Scale keys are ignored, so this is only exact for rigs without scale.
+	/// </summary>
+	struct DualQuatPose {
+		std::vector<int> parents;
+		std::vector<ew::DualQuat> localTransforms;
+		std::vector<ew::DualQuat> worldTransforms;
+	};
+	//Copies parents and the bind pose of skeleton. Reports bones whose bind pose has scale.
+	void loadDualQuatPose(const ew::Skeleton& skeleton, ew::DualQuatPose* pose);
+	//Dual quaternion version of updateSkeleton followed by solveFK
+	void updateDualQuatPose(ew::DualQuatPose* pose, const ew::AnimationClip* animClip, const ew::AnimationBinding& binding, float normalizedTime, ew::AnimationCursor* cursor = nullptr);
+	//palette[i] = pose.worldTransforms[boneIndices[i]] * inverseBindDualQuats[i]
+	void computeDualQuatSkinningPalette(const ew::SkinBinding& skinBinding, const ew::DualQuatPose& pose, ew::DualQuat* palette);
+
+	/// <summary>
+	/// CPU reference for skinned.vert. Blends up to MAX_BONE_WEIGHTS palette matrices by weight.
+	/// Vertices with no weights are returned unchanged.
+	/// </summary>
+	void skinVertex(const ew::Vertex& vertex, const glm::mat4* palette, glm::vec3* position, glm::vec3* normal);
+	//CPU reference for skinnedDQ.vert. Weighted sum of dual quaternions, flipped into the hemisphere of the first, then normalized.
+	void skinVertexDualQuat(const ew::Vertex& vertex, const ew::DualQuat* palette, glm::vec3* position, glm::vec3* normal);
+
+	/// <summary>
+	/// Shader storage buffer of skinning palettes, one block of numBones matrices or dual quaternions per instance.
+	/// Instance i of an instanced draw reads palette[i * numBones + boneID].
+	/// </summary>
+	class SkinningPaletteBuffer {
+	public:
+		SkinningPaletteBuffer() {};
+		~SkinningPaletteBuffer();
+		SkinningPaletteBuffer(const SkinningPaletteBuffer&) = delete;
+		SkinningPaletteBuffer& operator=(const SkinningPaletteBuffer&) = delete;
+		//Uploads numInstances palettes of numBones matrices each. Grows the buffer if needed.
+		void upload(const glm::mat4* palettes, int numBones, int numInstances = 1);
+		void upload(const ew::DualQuat* palettes, int numBones, int numInstances = 1);
+		void bind(unsigned int bindingPoint = SKINNING_PALETTE_BINDING) const;
+		inline int getNumBones() const { return m_numBones; }
+	private:
+		void uploadBytes(const void* data, size_t size);
+		unsigned int m_ssbo = 0;
+		size_t m_capacity = 0; //Bytes
+		int m_numBones = 0;
+	};
+}
@@ -8,4 +8,6 @@ namespace ew {
 	unsigned int loadTexture(const char* filePath);
 	unsigned int loadTexture(const char* filePath, bool sRGB);
 	unsigned int loadTexture(const char* filePath, int wrapMode, int magFilter, int minFilter, bool mipmap, bool sRGB);
+	//RGBA32F texture of raw data, for shaders that read it with texelFetch. Nearest filtering, no mipmaps.
+	unsigned int createFloatTexture(int width, int height, const float* rgba);
 }
@@ -0,0 +1,113 @@
+#include "vertexAnimation.h"
+#include "cpuSkinning.h"
+#include <math.h>
+#include <stdio.h>
+
+namespace ew {
+	VATInstance makeVATInstance(const ew::VertexAnimationTexture& vat, int clipIndex, const glm::vec3& position, float yaw, float startPhase, float speed) {
+		const VATClip& clip = vat.clips[clipIndex];
+		VATInstance instance;
+		instance.transform = glm::vec4(position, yaw);
+		instance.playback = glm::vec4((float)clip.firstFrame, (float)clip.numFrames, startPhase, clip.duration > 0 ? speed / clip.duration : 0.0f);
+		return instance;
+	}
+
+	void initVertexAnimationTexture(ew::VertexAnimationTexture* vat, ew::VATType type, int elementsPerFrame, int maxWidth) {
+		vat->type = type;
+		vat->elementsPerFrame = elementsPerFrame;
+		vat->width = glm::min(elementsPerFrame, maxWidth);
+		vat->rowsPerFrame = (elementsPerFrame + vat->width - 1) / vat->width;
+		vat->numFrames = 0;
+		vat->texels.clear();
+		vat->normalTexels.clear();
+		vat->clips.clear();
+	}
+
+	static float getClipSeconds(const ew::AnimationClip& clip) {
+		return clip.duration / ew::getTicksPerSecond(clip);
+	}
+
+	//Adds a clip of numFrames to vat and grows the texel arrays to fit
+	static VATClip addClip(ew::VertexAnimationTexture* vat, const ew::AnimationClip& animClip, float frameRate) {
+		VATClip clip;
+		clip.duration = getClipSeconds(animClip);
+		clip.numFrames = glm::max((int)ceilf(clip.duration * frameRate), 1);
+		clip.firstFrame = vat->numFrames;
+		vat->numFrames += clip.numFrames;
+		const size_t size = (size_t)vat->getHeight() * vat->width * 4;
+		vat->texels.resize(size);
+		if (vat->type == VATType::VERTEX_POSITIONS) {
+			vat->normalTexels.resize(size);
+		}
+		return clip;
+	}
+
+	static inline float* getTexel(std::vector<float>& texels, const ew::VertexAnimationTexture& vat, int frame, int element) {
+		const size_t row = (size_t)frame * vat.rowsPerFrame + element / vat.width;
+		return &texels[(row * vat.width + element % vat.width) * 4];
+	}
+
+	int bakeBoneMatrixClip(const ew::AnimatedSkeletonPackage& package, const ew::SkinBinding& skinBinding, float frameRate, ew::VertexAnimationTexture* vat) {
+		const int numPaletteEntries = (int)skinBinding.boneIndices.size();
+		if (vat->type != VATType::BONE_MATRICES || vat->elementsPerFrame != numPaletteEntries * 3) {
+			printf("Vertex animation texture does not hold palettes of %d bones\n", numPaletteEntries);
+			return -1;
+		}
+		const VATClip clip = addClip(vat, package.animationClip, frameRate);
+		ew::Skeleton skeleton = package.skeleton;
+		std::vector<glm::mat4> worldMatrices;
+		std::vector<glm::mat4> palette(numPaletteEntries);
+		for (int f = 0; f < clip.numFrames; f++)
+		{
+			ew::updateSkeleton(&skeleton, &package.animationClip, package.binding, (float)f / clip.numFrames);
+			ew::solveFK(skeleton, worldMatrices);
+			ew::computeSkinningPalette(skinBinding, worldMatrices, palette.data());
+			for (int p = 0; p < numPaletteEntries; p++)
+			{
+				//Row r of the matrix, glm is column-major
+				for (int r = 0; r < 3; r++)
+				{
+					float* texel = getTexel(vat->texels, *vat, clip.firstFrame + f, p * 3 + r);
+					for (int c = 0; c < 4; c++)
+					{
+						texel[c] = palette[p][c][r];
+					}
+				}
+			}
+		}
+		vat->clips.push_back(clip);
+		return (int)vat->clips.size() - 1;
+	}
+
+	int bakeVertexPositionClip(const ew::MeshData& meshData, const ew::AnimatedSkeletonPackage& package, const ew::SkinBinding& skinBinding, float frameRate, ew::VertexAnimationTexture* vat) {
+		const int numVertices = (int)meshData.vertices.size();
+		if (vat->type != VATType::VERTEX_POSITIONS || vat->elementsPerFrame != numVertices) {
+			printf("Vertex animation texture does not hold meshes of %d vertices\n", numVertices);
+			return -1;
+		}
+		const VATClip clip = addClip(vat, package.animationClip, frameRate);
+		ew::Skeleton skeleton = package.skeleton;
+		std::vector<glm::mat4> worldMatrices;
+		std::vector<glm::mat4> palette(skinBinding.boneIndices.size());
+		std::vector<glm::vec3> positions(numVertices), normals(numVertices);
+		ew::SkinningOutput output;
+		output.positions = positions.data();
+		output.normals = normals.data();
+		for (int f = 0; f < clip.numFrames; f++)
+		{
+			ew::updateSkeleton(&skeleton, &package.animationClip, package.binding, (float)f / clip.numFrames);
+			ew::solveFK(skeleton, worldMatrices);
+			ew::computeSkinningPalette(skinBinding, worldMatrices, palette.data());
+			ew::skinMesh(meshData, palette.data(), output);
+			for (int v = 0; v < numVertices; v++)
+			{
+				float* position = getTexel(vat->texels, *vat, clip.firstFrame + f, v);
+				float* normal = getTexel(vat->normalTexels, *vat, clip.firstFrame + f, v);
+				position[0] = positions[v].x; position[1] = positions[v].y; position[2] = positions[v].z; position[3] = 1.0f;
+				normal[0] = normals[v].x; normal[1] = normals[v].y; normal[2] = normals[v].z; normal[3] = 0.0f;
+			}
+		}
+		vat->clips.push_back(clip);
+		return (int)vat->clips.size() - 1;
+	}
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include "animation.h"
+#include "skinning.h"
+
+namespace ew {
+	enum class VATType {
+		BONE_MATRICES = 0, //Skinning palettes as 3x4 affine rows, 3 texels per bone. Small, still skinned on the GPU.
+		VERTEX_POSITIONS = 1 //Skinned positions and normals, 1 texel per vertex each. No skinning cost, size grows with the mesh.
+	};
+	//A clip baked into a VertexAnimationTexture. Frames are evenly spaced over one loop, the last one just before the end.
+	struct VATClip {
+		int firstFrame;
+		int numFrames;
+		float duration; //Seconds
+	};
+
+	/// <summary>
+	/// Animation baked into RGBA32F texels for playback with no CPU work per instance.
+	/// A frame is elementsPerFrame texels, wrapped into rowsPerFrame rows of width texels, and frames are stacked vertically.
+	/// Element e of frame f is at (e % width, f * rowsPerFrame + e / width).
+	/// Baking only touches CPU memory. Upload texels with createFloatTexture.
+	/// </summary>
+	struct VertexAnimationTexture {
+		VATType type = VATType::BONE_MATRICES;
+		int width = 0;
+		int rowsPerFrame = 0;
+		int elementsPerFrame = 0;
+		int numFrames = 0; //All clips
+		std::vector<float> texels; //Palette rows or positions (w = 1)
+		std::vector<float> normalTexels; //VERTEX_POSITIONS only, w = 0
+		std::vector<ew::VATClip> clips;
+		inline int getHeight() const { return numFrames * rowsPerFrame; }
+	};
+
+	//Per instance attributes of a VAT draw, set with Mesh::setInstanceAttributes at locations 6 and 7. Matches vat.vert.
+	struct VATInstance {
+		glm::vec4 transform; //Position xyz, yaw in radians
+		glm::vec4 playback; //First frame, frame count, phase at time 0, loops per second
+	};
+	VATInstance makeVATInstance(const ew::VertexAnimationTexture& vat, int clipIndex, const glm::vec3& position, float yaw, float startPhase, float speed = 1.0f);
+
+	//Clears vat and sets its layout. elementsPerFrame is 3 per palette entry for BONE_MATRICES, or the vertex count.
+	void initVertexAnimationTexture(ew::VertexAnimationTexture* vat, ew::VATType type, int elementsPerFrame, int maxWidth = 4096);
+	//Appends package's clip sampled at frameRate as skinning palettes. Returns the clip index.
+	int bakeBoneMatrixClip(const ew::AnimatedSkeletonPackage& package, const ew::SkinBinding& skinBinding, float frameRate, ew::VertexAnimationTexture* vat);
+	//Appends package's clip sampled at frameRate as skinned positions and normals of meshData. Returns the clip index.
+	int bakeVertexPositionClip(const ew::MeshData& meshData, const ew::AnimatedSkeletonPackage& package, const ew::SkinBinding& skinBinding, float frameRate, ew::VertexAnimationTexture* vat);
+}
@@ -0,0 +1,203 @@
+#include "vertexPacking.h"
+#include <math.h>
+#include <string.h>
+
+namespace ew {
+	static float signNotZero(float v) {
+		return v >= 0.0f ? 1.0f : -1.0f;
+	}
+
+	glm::vec2 octEncode(const glm::vec3& n) {
+		const float l1 = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+		if (l1 <= 0.0f)
+			return glm::vec2(0.0f);
+		glm::vec2 p = glm::vec2(n.x, n.y) / l1;
+		//Fold the lower hemisphere over the diagonals
+		if (n.z < 0.0f) {
+			p = glm::vec2((1.0f - fabsf(p.y)) * signNotZero(p.x), (1.0f - fabsf(p.x)) * signNotZero(p.y));
+		}
+		return p;
+	}
+
+	glm::vec3 octDecode(const glm::vec2& e) {
+		glm::vec3 n = glm::vec3(e.x, e.y, 1.0f - fabsf(e.x) - fabsf(e.y));
+		const float t = glm::max(-n.z, 0.0f);
+		n.x += n.x >= 0.0f ? -t : t;
+		n.y += n.y >= 0.0f ? -t : t;
+		return glm::normalize(n);
+	}
+
+	uint16_t floatToHalf(float f) {
+		uint32_t bits;
+		memcpy(&bits, &f, sizeof(bits));
+		const uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+		uint32_t absBits = bits & 0x7fffffff;
+		if (absBits >= 0x7f800000) {
+			//Infinity stays infinity, NaN stays NaN
+			return sign | 0x7c00 | (absBits > 0x7f800000 ? 0x200 : 0);
+		}
+		if (absBits >= 0x477ff000) {
+			//65520 and up round past the largest half
+			return sign | 0x7c00;
+		}
+		if (absBits < 0x38800000) {
+			//Below the smallest normal half. Subnormal halves are multiples of 2^-24.
+			float absValue;
+			memcpy(&absValue, &absBits, sizeof(absValue));
+			return sign | (uint16_t)lrintf(absValue * 16777216.0f);
+		}
+		//Rebias the exponent from 127 to 15 and round the 13 dropped mantissa bits to nearest even
+		absBits += 0xc8000fff + ((absBits >> 13) & 1);
+		return sign | (uint16_t)(absBits >> 13);
+	}
+
+	float halfToFloat(uint16_t h) {
+		const uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+		const uint32_t exponent = (h >> 10) & 0x1f;
+		const uint32_t mantissa = h & 0x3ff;
+		uint32_t bits;
+		if (exponent == 0) {
+			const float value = mantissa / 16777216.0f;
+			memcpy(&bits, &value, sizeof(bits));
+			bits |= sign;
+		}
+		else if (exponent == 31) {
+			bits = sign | 0x7f800000 | (mantissa << 13);
+		}
+		else {
+			bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+		}
+		float f;
+		memcpy(&f, &bits, sizeof(f));
+		return f;
+	}
+
+	PositionQuantization makePositionQuantization(const ew::AABB& bounds) {
+		PositionQuantization quantization;
+		if (!bounds.isEmpty()) {
+			quantization.offset = bounds.min;
+			quantization.scale = bounds.max - bounds.min;
+		}
+		return quantization;
+	}
+
+	VertexLayout getVertexLayout(VertexFormat format, bool skinned) {
+		VertexLayout layout;
+		layout.format = format;
+		if (format == VertexFormat::FULL)
+			return layout;
+		//3 floats, or 3 unorm16 padded to 8 bytes
+		const int positionSize = format == VertexFormat::PACKED_QUANTIZED ? 8 : 12;
+		layout.pos = 0;
+		layout.normal = positionSize;
+		layout.tangent = positionSize + 4;
+		layout.uv = positionSize + 8;
+		layout.stride = positionSize + 12;
+		layout.boneIDs = -1;
+		layout.boneWeights = -1;
+		if (skinned) {
+			layout.boneIDs = layout.stride;
+			layout.boneWeights = layout.stride + 4;
+			layout.stride += 8;
+		}
+		return layout;
+	}
+
+	static int16_t encodeSnorm16(float v) {
+		return (int16_t)lrintf(glm::clamp(v, -1.0f, 1.0f) * 32767.0f);
+	}
+	static float decodeSnorm16(int16_t q) {
+		return glm::max(q / 32767.0f, -1.0f);
+	}
+	static uint16_t encodeUnorm16(float v, float offset, float scale) {
+		if (scale <= 0.0f)
+			return 0;
+		return (uint16_t)lrintf(glm::clamp((v - offset) / scale, 0.0f, 1.0f) * 65535.0f);
+	}
+
+	static void writeOct(const glm::vec3& v, uint8_t* out) {
+		const glm::vec2 e = octEncode(v);
+		const int16_t q[2] = { encodeSnorm16(e.x), encodeSnorm16(e.y) };
+		memcpy(out, q, sizeof(q));
+	}
+	static glm::vec3 readOct(const uint8_t* data) {
+		int16_t q[2];
+		memcpy(q, data, sizeof(q));
+		return octDecode(glm::vec2(decodeSnorm16(q[0]), decodeSnorm16(q[1])));
+	}
+
+	void packVertices(const ew::Vertex* vertices, size_t first, size_t count, const ew::VertexLayout& layout, const ew::PositionQuantization& quantization, uint8_t* out) {
+		if (layout.format == VertexFormat::FULL) {
+			memcpy(out, vertices + first, sizeof(Vertex) * count);
+			return;
+		}
+		for (size_t i = 0; i < count; i++)
+		{
+			const Vertex& vertex = vertices[first + i];
+			uint8_t* dst = out + i * layout.stride;
+			if (layout.format == VertexFormat::PACKED_QUANTIZED) {
+				const uint16_t q[4] = {
+					encodeUnorm16(vertex.pos.x, quantization.offset.x, quantization.scale.x),
+					encodeUnorm16(vertex.pos.y, quantization.offset.y, quantization.scale.y),
+					encodeUnorm16(vertex.pos.z, quantization.offset.z, quantization.scale.z),
+					0 };
+				memcpy(dst + layout.pos, q, sizeof(q));
+			}
+			else {
+				memcpy(dst + layout.pos, &vertex.pos, sizeof(glm::vec3));
+			}
+			writeOct(vertex.normal, dst + layout.normal);
+			writeOct(vertex.tangent, dst + layout.tangent);
+			const uint16_t uv[2] = { floatToHalf(vertex.uv.x), floatToHalf(vertex.uv.y) };
+			memcpy(dst + layout.uv, uv, sizeof(uv));
+			if (layout.boneIDs < 0)
+				continue;
+			uint8_t* ids = dst + layout.boneIDs;
+			uint8_t* weights = dst + layout.boneWeights;
+			int total = 0;
+			int largest = 0;
+			for (int j = 0; j < MAX_BONE_WEIGHTS; j++)
+			{
+				ids[j] = (uint8_t)vertex.boneIDs[j];
+				weights[j] = (uint8_t)lrintf(glm::clamp(vertex.boneWeights[j], 0.0f, 1.0f) * 255.0f);
+				total += weights[j];
+				if (vertex.boneWeights[j] > vertex.boneWeights[largest]) {
+					largest = j;
+				}
+			}
+			//Rounding can leave the sum a few steps off 255. Give the difference to the largest weight.
+			if (total > 0) {
+				weights[largest] = (uint8_t)glm::clamp((int)weights[largest] + 255 - total, 0, 255);
+			}
+		}
+	}
+
+	Vertex unpackVertex(const uint8_t* data, const ew::VertexLayout& layout, const ew::PositionQuantization& quantization) {
+		Vertex vertex = {};
+		if (layout.format == VertexFormat::FULL) {
+			memcpy(&vertex, data, sizeof(Vertex));
+			return vertex;
+		}
+		if (layout.format == VertexFormat::PACKED_QUANTIZED) {
+			uint16_t q[3];
+			memcpy(q, data + layout.pos, sizeof(q));
+			vertex.pos = quantization.offset + quantization.scale * (glm::vec3(q[0], q[1], q[2]) / 65535.0f);
+		}
+		else {
+			memcpy(&vertex.pos, data + layout.pos, sizeof(glm::vec3));
+		}
+		vertex.normal = readOct(data + layout.normal);
+		vertex.tangent = readOct(data + layout.tangent);
+		uint16_t uv[2];
+		memcpy(uv, data + layout.uv, sizeof(uv));
+		vertex.uv = glm::vec2(halfToFloat(uv[0]), halfToFloat(uv[1]));
+		if (layout.boneIDs >= 0) {
+			for (int j = 0; j < MAX_BONE_WEIGHTS; j++)
+			{
+				vertex.boneIDs[j] = data[layout.boneIDs + j];
+				vertex.boneWeights[j] = data[layout.boneWeights + j] / 255.0f;
+			}
+		}
+		return vertex;
+	}
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include "mesh.h"
+#include "bounds.h"
+#include <stdint.h>
+
+namespace ew {
+	//Octahedral mapping of a unit vector to [-1, 1]^2. Zero vectors map to (0, 0), which decodes to +Z.
+	glm::vec2 octEncode(const glm::vec3& n);
+	glm::vec3 octDecode(const glm::vec2& e);
+	//IEEE half float, rounded to nearest even. Out of range values become infinity.
+	uint16_t floatToHalf(float f);
+	float halfToFloat(uint16_t h);
+
+	//Fits 16 bit positions to bounds
+	PositionQuantization makePositionQuantization(const ew::AABB& bounds);
+	//Attribute offsets of a format. Bone attributes are only stored if skinned.
+	VertexLayout getVertexLayout(VertexFormat format, bool skinned);
+
+	/// <summary>
+	/// Writes vertices [first, first + count) to out in layout, layout.stride bytes each.
+	/// Bone weights are rounded so the 8 bit weights of a vertex still sum to exactly 1.
+	/// Bone IDs above 255 do not fit packed layouts and are truncated, check them before packing.
+	/// </summary>
+	void packVertices(const ew::Vertex* vertices, size_t first, size_t count, const ew::VertexLayout& layout, const ew::PositionQuantization& quantization, uint8_t* out);
+	//Decodes one packed vertex the way the GPU would, for measuring quantization error
+	Vertex unpackVertex(const uint8_t* data, const ew::VertexLayout& layout, const ew::PositionQuantization& quantization);
+}
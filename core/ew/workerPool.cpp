@@ -0,0 +1,85 @@
+#include "workerPool.h"
+#include <algorithm>
+
+namespace ew {
+	WorkerPool::WorkerPool(int numThreads) {
+		if (numThreads <= 0) {
+			numThreads = std::max((int)std::thread::hardware_concurrency(), 1);
+		}
+		m_workers.reserve(numThreads - 1);
+		for (int i = 1; i < numThreads; i++)
+		{
+			//Job 0 belongs to the calling thread
+			m_workers.emplace_back(&WorkerPool::workerLoop, this, i);
+		}
+	}
+
+	WorkerPool::~WorkerPool() {
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_shutdown = true;
+		}
+		m_startCondition.notify_all();
+		for (std::thread& worker : m_workers)
+		{
+			worker.join();
+		}
+	}
+
+	void WorkerPool::runJobs(int numJobs, JobFunction function, const void* context) {
+		numJobs = std::min(numJobs, getNumThreads());
+		if (numJobs <= 0)
+			return;
+		if (numJobs == 1) {
+			function(context, 0);
+			return;
+		}
+		std::lock_guard<std::mutex> runLock(m_runMutex);
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_function = function;
+			m_context = context;
+			m_numJobs = numJobs;
+			m_pendingWorkers = numJobs - 1;
+			m_generation++;
+		}
+		m_startCondition.notify_all();
+
+		function(context, 0);
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_doneCondition.wait(lock, [this] { return m_pendingWorkers == 0; });
+	}
+
+	void WorkerPool::workerLoop(int workerIndex) {
+		uint64_t lastGeneration = 0;
+		while (true) {
+			JobFunction function;
+			const void* context;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_startCondition.wait(lock, [&] { return m_shutdown || m_generation != lastGeneration; });
+				if (m_shutdown)
+					return;
+				lastGeneration = m_generation;
+				//Workers past the job count sit this run out
+				if (workerIndex >= m_numJobs)
+					continue;
+				function = m_function;
+				context = m_context;
+			}
+			function(context, workerIndex);
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				if (--m_pendingWorkers == 0) {
+					m_doneCondition.notify_one();
+				}
+			}
+		}
+	}
+
+	WorkerPool& getDefaultWorkerPool() {
+		static WorkerPool pool;
+		return pool;
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <stdint.h>
+
+namespace ew {
+	/// <summary>
+	/// Threads started once and reused for fork-join work, so per-call parallel loops don't pay for thread creation.
+	/// run hands job indices 1 and up to the workers and runs job 0 on the calling thread.
+	/// Calls from several threads take turns. Do not call run from inside one of the pool's own jobs.
+	/// </summary>
+	class WorkerPool {
+	public:
+		//numThreads includes the calling thread. 0 = one per hardware thread.
+		WorkerPool(int numThreads = 0);
+		~WorkerPool();
+		WorkerPool(const WorkerPool&) = delete;
+		WorkerPool& operator=(const WorkerPool&) = delete;
+
+		inline int getNumThreads() const { return (int)m_workers.size() + 1; }
+
+		//Calls job(i) for i in [0, numJobs) and returns once all have finished. numJobs is clamped to getNumThreads().
+		template <typename Job>
+		void run(int numJobs, const Job& job) {
+			runJobs(numJobs, [](const void* context, int jobIndex) { (*(const Job*)context)(jobIndex); }, &job);
+		}
+	private:
+		typedef void (*JobFunction)(const void* context, int jobIndex);
+		void runJobs(int numJobs, JobFunction function, const void* context);
+		void workerLoop(int workerIndex);
+
+		std::vector<std::thread> m_workers;
+		std::mutex m_runMutex; //Held for a whole run, so concurrent callers don't mix their jobs
+		std::mutex m_mutex;
+		std::condition_variable m_startCondition;
+		std::condition_variable m_doneCondition;
+		JobFunction m_function = nullptr;
+		const void* m_context = nullptr;
+		int m_numJobs = 0;
+		int m_pendingWorkers = 0;
+		uint64_t m_generation = 0;
+		bool m_shutdown = false;
+	};
+
+	//Pool with one thread per hardware thread, created on first use. Used when callers don't pass their own.
+	WorkerPool& getDefaultWorkerPool();
+}